@@ -19,36 +19,58 @@
  */
 
 #include "Automaton.hpp"
+#include "Instrument.hpp"
 
 // Constructor.
 Automaton::Automaton()
 {
     chemistry.init(&physics);
+    profiler = NULL;
 }
 
 
 // Step system.
 void Automaton::step()
 {
+    INSTRUMENT_TIMER(TIMER_AUTOMATON_STEP);
+
+    if (profiler != NULL) profiler->beginEvent("step");
+
     // Perform physics.
     physics.step(DTIME);
 
     // Perform chemistry.
     chemistry.step();
+
+    if (profiler != NULL) profiler->endEvent("step");
+}
+
+
+// Set phase profiler.
+void Automaton::setProfiler(Profiler *profiler)
+{
+    this->profiler = profiler;
+    physics.profiler = profiler;
+    chemistry.profiler = profiler;
 }
 
 
 // Load system.
+// Files saved without random state keep the current seeding.
 void Automaton::load(FILE *fp)
 {
     physics.load(fp);
     chemistry.load(fp);
+    physics.random.load(fp);
 }
 
 
 // Save system.
+// The random seed and state are saved so that a resumed run
+// continues the same random sequence.
 void Automaton::save(FILE *fp)
 {
     physics.save(fp);
     chemistry.save(fp);
+    physics.random.save(fp);
 }
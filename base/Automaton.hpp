@@ -34,12 +34,18 @@ class Automaton
         // Physics.
         Physics physics;
 
+        // Phase profiler.
+        Profiler *profiler;
+
         // Constructor.
         Automaton();
 
         // Step system.
         void step();
 
+        // Set phase profiler (NULL to disable).
+        void setProfiler(Profiler *profiler);
+
         // Load and save system.
         void load(FILE *fp);
         void save(FILE *fp);
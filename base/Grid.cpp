@@ -0,0 +1,172 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Sparse spatial grid.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "Grid.hpp"
+
+// Constructor.
+Grid::Grid()
+{
+}
+
+
+// Destructor.
+Grid::~Grid()
+{
+    std::unordered_map<long long, Tile *>::iterator itr;
+
+    for (itr = tiles.begin(); itr != tiles.end(); itr++)
+    {
+        delete itr->second;
+    }
+    tiles.clear();
+}
+
+
+// Remove all particles, keeping tiles for reuse.
+void Grid::clear()
+{
+    std::unordered_map<long long, Tile *>::iterator itr;
+    Tile *tile;
+
+    for (itr = tiles.begin(); itr != tiles.end(); itr++)
+    {
+        tile = itr->second;
+        if (tile->count == 0) continue;
+        memset(tile->cells, 0, sizeof(tile->cells));
+        tile->count = 0;
+    }
+}
+
+
+// Release empty tiles.
+void Grid::prune()
+{
+    std::unordered_map<long long, Tile *>::iterator itr;
+
+    for (itr = tiles.begin(); itr != tiles.end(); )
+    {
+        if (itr->second->count == 0)
+        {
+            delete itr->second;
+            itr = tiles.erase(itr);
+        }
+        else
+        {
+            itr++;
+        }
+    }
+}
+
+
+// Get tile.
+Grid::Tile *Grid::getTile(int tileX, int tileY, bool create)
+{
+    std::unordered_map<long long, Tile *>::iterator itr;
+    Tile *tile;
+    long long key = getKey(tileX, tileY);
+
+    if ((itr = tiles.find(key)) != tiles.end()) return itr->second;
+    if (!create) return NULL;
+    tile = new Tile();
+    assert(tile != NULL);
+    memset(tile->cells, 0, sizeof(tile->cells));
+    tile->count = 0;
+    tiles[key] = tile;
+    return tile;
+}
+
+
+// Insert particle at its current position.
+void Grid::insert(Particle *particle)
+{
+    int x,y;
+    Tile *tile;
+    Particle **cell;
+
+    x = particle->cellX = getCell(particle->vPosition.x);
+    y = particle->cellY = getCell(particle->vPosition.y);
+    tile = getTile(x >> TILE_SHIFT, y >> TILE_SHIFT, true);
+    cell = &tile->cells[((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1))];
+    particle->cellNext = *cell;
+    *cell = particle;
+    particle->inGrid = true;
+    tile->count++;
+}
+
+
+// Remove particle.
+void Grid::remove(Particle *particle)
+{
+    int x,y;
+    Tile *tile;
+    Particle **cell;
+
+    if (!particle->inGrid) return;
+    x = particle->cellX;
+    y = particle->cellY;
+    if ((tile = getTile(x >> TILE_SHIFT, y >> TILE_SHIFT, false)) == NULL) return;
+    for (cell = &tile->cells[((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1))];
+        *cell != NULL; cell = &(*cell)->cellNext)
+    {
+        if (*cell == particle)
+        {
+            *cell = particle->cellNext;
+            particle->cellNext = NULL;
+            particle->inGrid = false;
+            tile->count--;
+            return;
+        }
+    }
+}
+
+
+// Append particles in cells x1..x2, y1..y2 to result.
+void Grid::query(int x1, int y1, int x2, int y2,
+std::vector<Particle *> &result)
+{
+    int tx,ty,x,y,xa,xb,ya,yb;
+    Tile *tile;
+    Particle *particle;
+
+    for (ty = y1 >> TILE_SHIFT; ty <= (y2 >> TILE_SHIFT); ty++)
+    {
+        for (tx = x1 >> TILE_SHIFT; tx <= (x2 >> TILE_SHIFT); tx++)
+        {
+            if ((tile = getTile(tx, ty, false)) == NULL || tile->count == 0) continue;
+            xa = (tx << TILE_SHIFT) > x1 ? (tx << TILE_SHIFT) : x1;
+            xb = ((tx + 1) << TILE_SHIFT) - 1 < x2 ? ((tx + 1) << TILE_SHIFT) - 1 : x2;
+            ya = (ty << TILE_SHIFT) > y1 ? (ty << TILE_SHIFT) : y1;
+            yb = ((ty + 1) << TILE_SHIFT) - 1 < y2 ? ((ty + 1) << TILE_SHIFT) - 1 : y2;
+            for (y = ya; y <= yb; y++)
+            {
+                for (x = xa; x <= xb; x++)
+                {
+                    for (particle = tile->cells[((y & (TILE_SIZE - 1)) << TILE_SHIFT) + (x & (TILE_SIZE - 1))];
+                        particle != NULL; particle = particle->cellNext)
+                    {
+                        result.push_back(particle);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Sparse spatial grid.
+ * Particles are binned into unit cells by position. Cells are grouped
+ * into square tiles that are allocated only where there are particles,
+ * so a large, mostly empty world pays only for its occupied tiles.
+ * Each cell is an intrusive list threaded through its particles.
+ */
+
+#ifndef __GRID__
+#define __GRID__
+
+#include <math.h>
+#include <vector>
+#include <unordered_map>
+#include "Particle.hpp"
+
+// Tile size (cells per side, a power of 2).
+#define TILE_SHIFT 4
+#define TILE_SIZE (1 << TILE_SHIFT)
+
+class Grid
+{
+    public:
+
+        // Constructor.
+        Grid();
+
+        // Destructor.
+        ~Grid();
+
+        // Remove all particles, keeping tiles for reuse.
+        void clear();
+
+        // Release empty tiles.
+        void prune();
+
+        // Insert particle at its current position.
+        void insert(Particle *particle);
+
+        // Remove particle.
+        void remove(Particle *particle);
+
+        // Append particles in cells x1..x2, y1..y2 (inclusive) to result.
+        void query(int x1, int y1, int x2, int y2,
+            std::vector<Particle *> &result);
+
+        // Number of allocated tiles.
+        int getNumTiles() { return (int)tiles.size(); }
+
+        // Cell containing position.
+        static int getCell(float position) { return (int)floorf(position); }
+
+    private:
+
+        // Tile of cells.
+        struct Tile
+        {
+            Particle *cells[TILE_SIZE * TILE_SIZE];
+            int count;
+        };
+        std::unordered_map<long long, Tile *> tiles;
+
+        // Get tile, optionally creating it.
+        Tile *getTile(int tileX, int tileY, bool create);
+
+        // Tile key.
+        static long long getKey(int tileX, int tileY)
+        {
+            return ((long long)tileX << 32) | (long long)(unsigned int)tileY;
+        }
+};
+#endif
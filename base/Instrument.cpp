@@ -0,0 +1,191 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Hot path instrumentation.
+ */
+
+#include "Instrument.hpp"
+
+#if ( INSTRUMENT == 1 )
+#include <assert.h>
+#include <mutex>
+#include "../util/Log.hpp"
+
+// Calling thread's block.
+thread_local InstrumentBlock *Instrument::block = NULL;
+
+// All blocks; retained after their threads exit so totals survive.
+static std::vector<InstrumentBlock *> Blocks;
+static std::mutex BlocksLock;
+
+// Counter names.
+static const char *CountNames[NUM_COUNTS] =
+{
+    "collision pairs tested",
+    "collisions found",
+    "bonds broken by stretch",
+    "particles created",
+    "particles destroyed",
+    "neighborhoods gathered",
+    "neighbors gathered"
+};
+
+// Timer names.
+static const char *TimerNames[NUM_TIMERS] =
+{
+    "Automaton::step",
+    "Physics::step",
+    "Chemistry::react"
+};
+
+// Constructor.
+InstrumentBlock::InstrumentBlock()
+{
+    clear();
+}
+
+
+// Clear.
+void InstrumentBlock::clear()
+{
+    int i;
+
+    for (i = 0; i < NUM_COUNTS; i++) counts[i] = 0;
+    for (i = 0; i < NEIGHBORHOOD_BUCKETS; i++) neighborhoodSizes[i] = 0;
+    for (i = 0; i < NUM_TIMERS; i++)
+    {
+        timerCalls[i] = 0;
+        timerNanoseconds[i] = 0;
+    }
+    matchAttempts.clear();
+    matchFires.clear();
+}
+
+
+// Create and register a block for the calling thread.
+InstrumentBlock *Instrument::create()
+{
+    InstrumentBlock *block = new InstrumentBlock();
+    assert(block != NULL);
+    std::lock_guard<std::mutex> guard(BlocksLock);
+    Blocks.push_back(block);
+    return block;
+}
+
+
+// Log totals over all threads.
+// Blocks are read without stopping their threads, so an on-demand
+// dump taken while other threads are stepping is approximate.
+void Instrument::dump()
+{
+    int i,j;
+    InstrumentBlock total;
+
+    {
+        std::lock_guard<std::mutex> guard(BlocksLock);
+        for (i = 0; i < (int)Blocks.size(); i++)
+        {
+            InstrumentBlock *block = Blocks[i];
+            for (j = 0; j < NUM_COUNTS; j++) total.counts[j] += block->counts[j];
+            for (j = 0; j < NEIGHBORHOOD_BUCKETS; j++)
+            {
+                total.neighborhoodSizes[j] += block->neighborhoodSizes[j];
+            }
+            for (j = 0; j < NUM_TIMERS; j++)
+            {
+                total.timerCalls[j] += block->timerCalls[j];
+                total.timerNanoseconds[j] += block->timerNanoseconds[j];
+            }
+            if (block->matchAttempts.size() > total.matchAttempts.size())
+            {
+                total.matchAttempts.resize(block->matchAttempts.size(), 0);
+                total.matchFires.resize(block->matchAttempts.size(), 0);
+            }
+            for (j = 0; j < (int)block->matchAttempts.size(); j++)
+            {
+                total.matchAttempts[j] += block->matchAttempts[j];
+                total.matchFires[j] += block->matchFires[j];
+            }
+        }
+        sprintf(Log::messageBuf, "Instrumentation (%d threads):", (int)Blocks.size());
+    }
+    Log::logInformation();
+
+    for (i = 0; i < NUM_COUNTS; i++)
+    {
+        sprintf(Log::messageBuf, "  %-24s %lld", CountNames[i], total.counts[i]);
+        Log::logInformation();
+    }
+    if (total.counts[COUNT_COLLISION_TESTS] > 0)
+    {
+        sprintf(Log::messageBuf, "  %-24s %.6f", "collision hit rate",
+            (double)total.counts[COUNT_COLLISIONS] /
+            (double)total.counts[COUNT_COLLISION_TESTS]);
+        Log::logInformation();
+    }
+    if (total.counts[COUNT_NEIGHBORHOODS] > 0)
+    {
+        sprintf(Log::messageBuf, "  %-24s %.3f", "mean neighborhood size",
+            (double)total.counts[COUNT_NEIGHBORS] /
+            (double)total.counts[COUNT_NEIGHBORHOODS]);
+        Log::logInformation();
+        Log::logInformation("  neighborhood size histogram:");
+        for (i = 0; i < NEIGHBORHOOD_BUCKETS; i++)
+        {
+            if (total.neighborhoodSizes[i] == 0) continue;
+            sprintf(Log::messageBuf, "    %2d%s %lld", i,
+                i == NEIGHBORHOOD_BUCKETS - 1 ? "+" : " ",
+                total.neighborhoodSizes[i]);
+            Log::logInformation();
+        }
+    }
+
+    for (i = 0; i < NUM_TIMERS; i++)
+    {
+        if (total.timerCalls[i] == 0) continue;
+        sprintf(Log::messageBuf, "  %-24s calls=%lld total=%.3fs mean=%.3fus",
+            TimerNames[i], total.timerCalls[i],
+            (double)total.timerNanoseconds[i] * 1.0e-9,
+            (double)total.timerNanoseconds[i] * 1.0e-3 /
+            (double)total.timerCalls[i]);
+        Log::logInformation();
+    }
+
+    if (total.matchAttempts.size() > 0)
+    {
+        Log::logInformation("  reaction matches (index: attempts fires):");
+        for (i = 0; i < (int)total.matchAttempts.size(); i++)
+        {
+            if (total.matchAttempts[i] == 0) continue;
+            sprintf(Log::messageBuf, "    %4d: %lld %lld", i,
+                total.matchAttempts[i], total.matchFires[i]);
+            Log::logInformation();
+        }
+    }
+}
+
+
+// Reset all threads' blocks.
+void Instrument::reset()
+{
+    std::lock_guard<std::mutex> guard(BlocksLock);
+    for (int i = 0; i < (int)Blocks.size(); i++)
+    {
+        Blocks[i]->clear();
+    }
+}
+#endif
@@ -0,0 +1,161 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Hot path instrumentation.
+ * Counters and scoped timers for the automaton, physics and chemistry
+ * steps. Enabled by building with INSTRUMENT = 1 (see Parameters.h);
+ * otherwise the INSTRUMENT_* macros compile to nothing.
+ * Each thread accumulates into its own block, so counting does not
+ * contend; blocks are summed when dumped to the log.
+ */
+
+#ifndef __INSTRUMENT__
+#define __INSTRUMENT__
+
+#include "Parameters.h"
+
+#if ( INSTRUMENT == 1 )
+#include <vector>
+#include <chrono>
+
+// Counters.
+#define COUNT_COLLISION_TESTS 0
+#define COUNT_COLLISIONS 1
+#define COUNT_BOND_BREAKS 2
+#define COUNT_PARTICLES_CREATED 3
+#define COUNT_PARTICLES_DESTROYED 4
+#define COUNT_NEIGHBORHOODS 5
+#define COUNT_NEIGHBORS 6
+#define NUM_COUNTS 7
+
+// Timers.
+#define TIMER_AUTOMATON_STEP 0
+#define TIMER_PHYSICS_STEP 1
+#define TIMER_CHEMISTRY_REACT 2
+#define NUM_TIMERS 3
+
+// Neighborhood size histogram buckets (last is overflow).
+#define NEIGHBORHOOD_BUCKETS 16
+
+// Per-thread accumulator.
+class InstrumentBlock
+{
+    public:
+
+        long long counts[NUM_COUNTS];
+        long long neighborhoodSizes[NEIGHBORHOOD_BUCKETS];
+        long long timerCalls[NUM_TIMERS];
+        long long timerNanoseconds[NUM_TIMERS];
+
+        // Per reaction index.
+        std::vector<long long> matchAttempts;
+        std::vector<long long> matchFires;
+
+        // Constructor.
+        InstrumentBlock();
+
+        // Clear.
+        void clear();
+
+        // Record neighborhood size.
+        void neighborhood(int size)
+        {
+            counts[COUNT_NEIGHBORHOODS]++;
+            counts[COUNT_NEIGHBORS] += size;
+            if (size >= NEIGHBORHOOD_BUCKETS) size = NEIGHBORHOOD_BUCKETS - 1;
+            neighborhoodSizes[size]++;
+        }
+
+        // Record reaction match attempt.
+        void match(int reactionIndex, bool fired)
+        {
+            if (reactionIndex >= (int)matchAttempts.size())
+            {
+                matchAttempts.resize(reactionIndex + 1, 0);
+                matchFires.resize(reactionIndex + 1, 0);
+            }
+            matchAttempts[reactionIndex]++;
+            if (fired) matchFires[reactionIndex]++;
+        }
+};
+
+class Instrument
+{
+    public:
+
+        // Calling thread's block.
+        static InstrumentBlock *get()
+        {
+            if (block == NULL) block = create();
+            return block;
+        }
+
+        // Log totals over all threads.
+        static void dump();
+
+        // Reset all threads' blocks.
+        static void reset();
+
+    private:
+
+        static thread_local InstrumentBlock *block;
+
+        // Create and register a block for the calling thread.
+        static InstrumentBlock *create();
+};
+
+// Scoped timer.
+class InstrumentTimer
+{
+    public:
+
+        InstrumentTimer(int timer)
+        {
+            this->timer = timer;
+            start = std::chrono::steady_clock::now();
+        }
+
+        ~InstrumentTimer()
+        {
+            InstrumentBlock *block = Instrument::get();
+            block->timerCalls[timer]++;
+            block->timerNanoseconds[timer] +=
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+    private:
+
+        int timer;
+        std::chrono::steady_clock::time_point start;
+};
+
+#define INSTRUMENT_COUNT(counter) (Instrument::get()->counts[counter]++)
+#define INSTRUMENT_ADD(counter, n) (Instrument::get()->counts[counter] += (n))
+#define INSTRUMENT_MATCH(reactionIndex, fired) (Instrument::get()->match(reactionIndex, fired))
+#define INSTRUMENT_NEIGHBORHOOD(size) (Instrument::get()->neighborhood(size))
+#define INSTRUMENT_TIMER(timer) InstrumentTimer instrumentTimer(timer)
+#define INSTRUMENT_DUMP() Instrument::dump()
+#else
+#define INSTRUMENT_COUNT(counter)
+#define INSTRUMENT_ADD(counter, n)
+#define INSTRUMENT_MATCH(reactionIndex, fired)
+#define INSTRUMENT_NEIGHBORHOOD(size)
+#define INSTRUMENT_TIMER(timer)
+#define INSTRUMENT_DUMP()
+#endif
+#endif
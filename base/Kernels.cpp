@@ -0,0 +1,350 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Vectorized particle kernels.
+ */
+
+#include <math.h>
+#include "Kernels.hpp"
+#include "../util/Math_etc.h"
+
+#if ( KERNELS_AVX2 == 1 )
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+int Kernels::vectorize = -1;
+
+// Set count, growing the arrays to whole vectors.
+void MotionArrays::resize(int count)
+{
+    int size = ((count + KERNEL_LANES - 1) / KERNEL_LANES) * KERNEL_LANES;
+
+    this->count = count;
+    if ((int)x.size() >= size) return;
+    x.resize(size);
+    y.resize(size);
+    vx.resize(size);
+    vy.resize(size);
+    fx.resize(size);
+    fy.resize(size);
+    mass.resize(size);
+}
+
+
+// Set count, growing the arrays to whole vectors.
+void BondArrays::resize(int count)
+{
+    int size = ((count + KERNEL_LANES - 1) / KERNEL_LANES) * KERNEL_LANES;
+
+    this->count = count;
+    if ((int)x1.size() >= size) return;
+    x1.resize(size);
+    y1.resize(size);
+    ox.resize(size);
+    oy.resize(size);
+    x2.resize(size);
+    y2.resize(size);
+    strength.resize(size);
+    fx.resize(size);
+    fy.resize(size);
+    apply.resize(size);
+    stretched.resize(size);
+}
+
+
+// Integrate motion.
+void Kernels::integrate(MotionArrays &motion, const MotionParameters &parameters)
+{
+    #if ( KERNELS_AVX2 == 1 )
+    if (isVectorized())
+    {
+        integrateAVX2(motion, parameters);
+        return;
+    }
+    #endif
+    integrateScalar(motion, parameters, 0, motion.count);
+}
+
+
+// Integrate motion of particles start..end-1.
+// This is the reference for the vector version.
+void Kernels::integrateScalar(MotionArrays &motion,
+const MotionParameters &parameters, int start, int end)
+{
+    int i;
+    float x,y,vx,vy,m;
+
+    for (i = start; i < end; i++)
+    {
+        // Update velocity due to force.
+        vx = motion.vx[i] + (motion.fx[i] / motion.mass[i]) * parameters.dtime;
+        vy = motion.vy[i] + (motion.fy[i] / motion.mass[i]) * parameters.dtime;
+
+        // Limit speed.
+        m = sqrtf(vx * vx + vy * vy);
+        if (m > parameters.maxVelocity)
+        {
+            if (m <= tol) m = 1;
+            m = parameters.maxVelocity / m;
+            vx *= m;
+            vy *= m;
+            if (fabsf(vx) < tol) vx = 0.0f;
+            if (fabsf(vy) < tol) vy = 0.0f;
+        }
+
+        // Apply viscosity friction.
+        vx *= parameters.friction;
+        vy *= parameters.friction;
+
+        // Update position.
+        x = motion.x[i] + vx * parameters.dtime;
+        y = motion.y[i] + vy * parameters.dtime;
+        if (parameters.periodic)
+        {
+            while (x < 0.0f) x += parameters.width;
+            while (x >= parameters.width) x -= parameters.width;
+            while (y < 0.0f) y += parameters.height;
+            while (y >= parameters.height) y -= parameters.height;
+        }
+        else
+        {
+            if (x < parameters.lowX) x = parameters.lowX;
+            if (x > parameters.highX) x = parameters.highX;
+            if (y < parameters.lowY) y = parameters.lowY;
+            if (y > parameters.highY) y = parameters.highY;
+        }
+        motion.x[i] = x;
+        motion.y[i] = y;
+        motion.vx[i] = vx;
+        motion.vy[i] = vy;
+        motion.fx[i] = motion.fy[i] = 0.0f;
+    }
+}
+
+
+// Bond forces.
+void Kernels::bondForces(BondArrays &bonds)
+{
+    #if ( KERNELS_AVX2 == 1 )
+    if (isVectorized())
+    {
+        bondForcesAVX2(bonds);
+        return;
+    }
+    #endif
+    bondForcesScalar(bonds, 0, bonds.count);
+}
+
+
+// Bond forces of bonds start..end-1: the force on the partner is
+// proportional to its distance from the position the bond direction
+// expects. This is the reference for the vector version.
+void Kernels::bondForcesScalar(BondArrays &bonds, int start, int end)
+{
+    int i;
+    float dx,dy;
+
+    for (i = start; i < end; i++)
+    {
+        dx = bonds.x1[i] - bonds.x2[i];
+        dy = bonds.y1[i] - bonds.y2[i];
+        bonds.stretched[i] = (sqrtf(dx * dx + dy * dy) > bonds.maxLength);
+        dx = (bonds.x1[i] + bonds.ox[i]) - bonds.x2[i];
+        dy = (bonds.y1[i] + bonds.oy[i]) - bonds.y2[i];
+        bonds.apply[i] = (sqrtf(dx * dx + dy * dy) > 0.0f);
+        bonds.fx[i] = dx * bonds.strength[i];
+        bonds.fy[i] = dy * bonds.strength[i];
+    }
+}
+
+
+#if ( KERNELS_AVX2 == 1 )
+// Integrate motion, 8 particles at a time.
+AVX2_TARGET void Kernels::integrateAVX2(MotionArrays &motion,
+const MotionParameters &parameters)
+{
+    int i,j,n,outside;
+    __m256 x,y,vx,vy,m,s,nvx,nvy,over;
+    __m256 dtime,maxVelocity,friction,tolerance,one,zero,sign;
+    __m256 width,height,lowX,highX,lowY,highY;
+    float *px,*py;
+
+    dtime = _mm256_set1_ps(parameters.dtime);
+    maxVelocity = _mm256_set1_ps(parameters.maxVelocity);
+    friction = _mm256_set1_ps(parameters.friction);
+    tolerance = _mm256_set1_ps(tol);
+    one = _mm256_set1_ps(1.0f);
+    zero = _mm256_setzero_ps();
+    sign = _mm256_set1_ps(-0.0f);
+    width = _mm256_set1_ps(parameters.width);
+    height = _mm256_set1_ps(parameters.height);
+    lowX = _mm256_set1_ps(parameters.lowX);
+    highX = _mm256_set1_ps(parameters.highX);
+    lowY = _mm256_set1_ps(parameters.lowY);
+    highY = _mm256_set1_ps(parameters.highY);
+    n = motion.count - (motion.count % KERNEL_LANES);
+    for (i = 0; i < n; i += KERNEL_LANES)
+    {
+        // Update velocity due to force.
+        m = _mm256_loadu_ps(&motion.mass[i]);
+        vx = _mm256_add_ps(_mm256_loadu_ps(&motion.vx[i]),
+            _mm256_mul_ps(_mm256_div_ps(_mm256_loadu_ps(&motion.fx[i]), m), dtime));
+        vy = _mm256_add_ps(_mm256_loadu_ps(&motion.vy[i]),
+            _mm256_mul_ps(_mm256_div_ps(_mm256_loadu_ps(&motion.fy[i]), m), dtime));
+
+        // Limit speed.
+        m = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)));
+        over = _mm256_cmp_ps(m, maxVelocity, _CMP_GT_OQ);
+        if (_mm256_movemask_ps(over) != 0)
+        {
+            m = _mm256_blendv_ps(m, one, _mm256_cmp_ps(m, tolerance, _CMP_LE_OQ));
+            s = _mm256_div_ps(maxVelocity, m);
+            nvx = _mm256_mul_ps(vx, s);
+            nvy = _mm256_mul_ps(vy, s);
+            nvx = _mm256_blendv_ps(nvx, zero,
+                _mm256_cmp_ps(_mm256_andnot_ps(sign, nvx), tolerance, _CMP_LT_OQ));
+            nvy = _mm256_blendv_ps(nvy, zero,
+                _mm256_cmp_ps(_mm256_andnot_ps(sign, nvy), tolerance, _CMP_LT_OQ));
+            vx = _mm256_blendv_ps(vx, nvx, over);
+            vy = _mm256_blendv_ps(vy, nvy, over);
+        }
+
+        // Apply viscosity friction.
+        vx = _mm256_mul_ps(vx, friction);
+        vy = _mm256_mul_ps(vy, friction);
+
+        // Update position.
+        x = _mm256_add_ps(_mm256_loadu_ps(&motion.x[i]), _mm256_mul_ps(vx, dtime));
+        y = _mm256_add_ps(_mm256_loadu_ps(&motion.y[i]), _mm256_mul_ps(vy, dtime));
+        if (parameters.periodic)
+        {
+            x = _mm256_blendv_ps(x, _mm256_add_ps(x, width), _mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+            x = _mm256_blendv_ps(x, _mm256_sub_ps(x, width), _mm256_cmp_ps(x, width, _CMP_GE_OQ));
+            y = _mm256_blendv_ps(y, _mm256_add_ps(y, height), _mm256_cmp_ps(y, zero, _CMP_LT_OQ));
+            y = _mm256_blendv_ps(y, _mm256_sub_ps(y, height), _mm256_cmp_ps(y, height, _CMP_GE_OQ));
+            outside = _mm256_movemask_ps(_mm256_or_ps(
+                _mm256_or_ps(_mm256_cmp_ps(x, zero, _CMP_LT_OQ), _mm256_cmp_ps(x, width, _CMP_GE_OQ)),
+                _mm256_or_ps(_mm256_cmp_ps(y, zero, _CMP_LT_OQ), _mm256_cmp_ps(y, height, _CMP_GE_OQ))));
+        }
+        else
+        {
+            x = _mm256_blendv_ps(x, lowX, _mm256_cmp_ps(x, lowX, _CMP_LT_OQ));
+            x = _mm256_blendv_ps(x, highX, _mm256_cmp_ps(x, highX, _CMP_GT_OQ));
+            y = _mm256_blendv_ps(y, lowY, _mm256_cmp_ps(y, lowY, _CMP_LT_OQ));
+            y = _mm256_blendv_ps(y, highY, _mm256_cmp_ps(y, highY, _CMP_GT_OQ));
+            outside = 0;
+        }
+        _mm256_storeu_ps(&motion.x[i], x);
+        _mm256_storeu_ps(&motion.y[i], y);
+        _mm256_storeu_ps(&motion.vx[i], vx);
+        _mm256_storeu_ps(&motion.vy[i], vy);
+        _mm256_storeu_ps(&motion.fx[i], zero);
+        _mm256_storeu_ps(&motion.fy[i], zero);
+
+        // Finish wrapping positions more than a world away.
+        if (outside != 0)
+        {
+            for (j = 0; j < KERNEL_LANES; j++)
+            {
+                px = &motion.x[i + j];
+                py = &motion.y[i + j];
+                while (*px < 0.0f) *px += parameters.width;
+                while (*px >= parameters.width) *px -= parameters.width;
+                while (*py < 0.0f) *py += parameters.height;
+                while (*py >= parameters.height) *py -= parameters.height;
+            }
+        }
+    }
+    integrateScalar(motion, parameters, n, motion.count);
+}
+
+
+// Bond forces, 8 bonds at a time.
+AVX2_TARGET void Kernels::bondForcesAVX2(BondArrays &bonds)
+{
+    int i,n;
+    __m256 x1,y1,x2,y2,dx,dy,s,apply,maxLength;
+
+    maxLength = _mm256_set1_ps(bonds.maxLength);
+    n = bonds.count - (bonds.count % KERNEL_LANES);
+    for (i = 0; i < n; i += KERNEL_LANES)
+    {
+        x1 = _mm256_loadu_ps(&bonds.x1[i]);
+        y1 = _mm256_loadu_ps(&bonds.y1[i]);
+        x2 = _mm256_loadu_ps(&bonds.x2[i]);
+        y2 = _mm256_loadu_ps(&bonds.y2[i]);
+        dx = _mm256_sub_ps(x1, x2);
+        dy = _mm256_sub_ps(y1, y2);
+        apply = _mm256_cmp_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+            _mm256_mul_ps(dy, dy))), maxLength, _CMP_GT_OQ);
+        _mm256_storeu_si256((__m256i *)&bonds.stretched[i],
+            _mm256_srli_epi32(_mm256_castps_si256(apply), 31));
+        dx = _mm256_sub_ps(_mm256_add_ps(x1, _mm256_loadu_ps(&bonds.ox[i])), x2);
+        dy = _mm256_sub_ps(_mm256_add_ps(y1, _mm256_loadu_ps(&bonds.oy[i])), y2);
+        apply = _mm256_cmp_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+            _mm256_mul_ps(dy, dy))), _mm256_setzero_ps(), _CMP_GT_OQ);
+        s = _mm256_loadu_ps(&bonds.strength[i]);
+        _mm256_storeu_ps(&bonds.fx[i], _mm256_mul_ps(dx, s));
+        _mm256_storeu_ps(&bonds.fy[i], _mm256_mul_ps(dy, s));
+        _mm256_storeu_si256((__m256i *)&bonds.apply[i],
+            _mm256_srli_epi32(_mm256_castps_si256(apply), 31));
+    }
+    bondForcesScalar(bonds, n, bonds.count);
+}
+#endif
+
+
+// Processor supports AVX2?
+bool Kernels::hasAVX2()
+{
+    #if ( KERNELS_AVX2 == 1 )
+    #ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0) return false;  // OSXSAVE
+    if ((_xgetbv(0) & 6) != 6) return false;       // OS saves AVX state
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+    #else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+    #endif
+    #else
+    return false;
+    #endif
+}
+
+
+// Use vector kernels when supported.
+void Kernels::setVectorize(bool enable)
+{
+    vectorize = (enable && hasAVX2()) ? 1 : 0;
+}
+
+
+bool Kernels::isVectorized()
+{
+    if (vectorize == -1) setVectorize(true);
+    return vectorize == 1;
+}
@@ -0,0 +1,128 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Vectorized particle kernels.
+ * Kernels run over particles gathered into structure of arrays form.
+ * Each has a scalar version and, on x86 processors that support it,
+ * an AVX2 version that processes 8 particles per instruction. The
+ * version is chosen at run time. The AVX2 versions perform the same
+ * floating point operations in the same order as the scalar ones, so
+ * the results are identical.
+ */
+
+#ifndef __KERNELS__
+#define __KERNELS__
+
+#include <vector>
+
+// AVX2 kernels: x86 with GCC or Visual C++.
+#if ( defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) ) || \
+    ( defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) )
+#define KERNELS_AVX2 1
+#else
+#define KERNELS_AVX2 0
+#endif
+
+// Lanes per AVX2 vector.
+#define KERNEL_LANES 8
+
+// Particles gathered per kernel call: small enough to stay in cache.
+#define KERNEL_BLOCK 256
+
+// Particle motion: integrated in place.
+class MotionArrays
+{
+    public:
+
+        int count;
+        std::vector<float> x,y;                   // position
+        std::vector<float> vx,vy;                 // velocity
+        std::vector<float> fx,fy;                 // force
+        std::vector<float> mass;
+
+        // Constructor.
+        MotionArrays() { count = 0; }
+
+        // Set count, growing the arrays.
+        void resize(int count);
+};
+
+// Motion constants.
+struct MotionParameters
+{
+    float dtime;
+    float maxVelocity;
+    float friction;                               // velocity retained per step
+    bool periodic;
+    float width,height;                           // periodic world size
+    float lowX,highX,lowY,highY;                  // bounded world limits
+};
+
+// Bond forces: force of each bond on its partner, and whether the
+// bond is stretched beyond the maximum length.
+class BondArrays
+{
+    public:
+
+        int count;
+        std::vector<float> x1,y1;                 // bonding particle position
+        std::vector<float> ox,oy;                 // offset of bond direction
+        std::vector<float> x2,y2;                 // partner position
+        std::vector<float> strength;
+        float maxLength;
+        std::vector<float> fx,fy;                 // output force
+        std::vector<int> apply;                   // output: force is nonzero
+        std::vector<int> stretched;               // output: length > maxLength
+
+        // Constructor.
+        BondArrays() { count = 0; maxLength = 0.0f; }
+
+        // Set count, growing the arrays.
+        void resize(int count);
+};
+
+class Kernels
+{
+    public:
+
+        // Integrate motion: update velocity by force, limit speed, apply
+        // friction, update position and keep it in the world.
+        static void integrate(MotionArrays &motion, const MotionParameters &parameters);
+        static void integrateScalar(MotionArrays &motion,
+            const MotionParameters &parameters, int start, int end);
+
+        // Bond forces.
+        static void bondForces(BondArrays &bonds);
+        static void bondForcesScalar(BondArrays &bonds, int start, int end);
+
+        #if ( KERNELS_AVX2 == 1 )
+        static void integrateAVX2(MotionArrays &motion, const MotionParameters &parameters);
+        static void bondForcesAVX2(BondArrays &bonds);
+        #endif
+
+        // Processor supports AVX2?
+        static bool hasAVX2();
+
+        // Use vector kernels when supported (default true).
+        static void setVectorize(bool enable);
+        static bool isVectorized();
+
+    private:
+
+        static int vectorize;                     // -1 = not determined
+};
+#endif
@@ -31,10 +31,22 @@
 void appTrap(int);
 #endif
 
+// Hot path instrumentation (see Instrument.hpp).
+// Build with -DINSTRUMENT=1 to enable.
+#ifndef INSTRUMENT
+#define INSTRUMENT 0
+#endif
+
 // Space dimensions.
 #define WIDTH 20
 #define HEIGHT 20
 
+// Dimensions of particle vectors: 2 for the planar simulation, or 3.
+// Build with -DDIMENSIONS=3 for 3D vectors.
+#ifndef DIMENSIONS
+#define DIMENSIONS 2
+#endif
+
 // Directions.
 #define NORTH 0
 #define NORTHEAST 1
@@ -45,4 +57,8 @@ void appTrap(int);
 #define WEST 6
 #define NORTHWEST 7
 #define CENTER 8
+
+// Cell offset of each direction.
+static const float DirectionOffsetX[8] = { 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, -1.0f, -1.0f, -1.0f };
+static const float DirectionOffsetY[8] = { 1.0f, 1.0f, 0.0f, -1.0f, -1.0f, -1.0f, 0.0f, 1.0f };
 #endif
@@ -24,19 +24,16 @@
 #include "Particle.hpp"
 #include "Physics.hpp"
 
-// ID factory.
-int Particle::idFactory = 0;
-
 // Constructor.
 Particle::Particle(int type, float radius,
 float mass, float charge)
 {
-    id = idFactory;
-    idFactory++;
+    id = -1;
     this->type = type;
     state = 0;
     fRadius = radius;
     fMass = mass;
+    mInertiaInverse = NULL;
     calcInertia();
     fCharge = charge;
     coefficientOfRestitution = COEFFICIENT_OF_RESTITUTION;
@@ -46,17 +43,29 @@ float mass, float charge)
         bondProperties[i] = NULL;
     }
     next = NULL;
+    cellNext = NULL;
+    cellX = cellY = 0;
+    inGrid = false;
+    order = 0;
+    tile = NULL;
+    tileIndex = activeIndex = -1;
+    asleep = false;
+    restCycles = 0;
+    verletIndex = -1;
+    molecule = -1;
+    moleculeMark = 0;
+    ghost = false;
 }
 
 
 Particle::Particle(int type)
 {
-    id = idFactory;
-    idFactory++;
+    id = -1;
     this->type = type;
     state = 0;
     fRadius = DEFAULT_RADIUS;
     fMass = DEFAULT_MASS;
+    mInertiaInverse = NULL;
     calcInertia();
     fCharge = DEFAULT_CHARGE;
     coefficientOfRestitution = COEFFICIENT_OF_RESTITUTION;
@@ -66,6 +75,18 @@ Particle::Particle(int type)
         bondProperties[i] = NULL;
     }
     next = NULL;
+    cellNext = NULL;
+    cellX = cellY = 0;
+    inGrid = false;
+    order = 0;
+    tile = NULL;
+    tileIndex = activeIndex = -1;
+    asleep = false;
+    restCycles = 0;
+    verletIndex = -1;
+    molecule = -1;
+    moleculeMark = 0;
+    ghost = false;
 }
 
 
@@ -88,6 +109,7 @@ Particle::~Particle()
             }
         }
     }
+    if (mInertiaInverse != NULL) delete mInertiaInverse;
 }
 
 
@@ -99,6 +121,12 @@ Particle *Particle::duplicate()
     assert(particle != NULL);
     particle->state = state;
     particle->coefficientOfRestitution = coefficientOfRestitution;
+    particle->fInertiaInverse = fInertiaInverse;
+    if (mInertiaInverse != NULL)
+    {
+        particle->mInertiaInverse = new Matrix3x3(*mInertiaInverse);
+        assert(particle->mInertiaInverse != NULL);
+    }
     particle->orientation.direction = orientation.direction;
     particle->orientation.mirrored = orientation.mirrored;
     for (int i = 0; i < 8; i++)
@@ -118,10 +146,27 @@ void Particle::calcInertia()
 {
     float d = 2.0f * ((fRadius * 2.0f) * (fRadius * 2.0f));
     d = fMass/12.0f * d;
-    mInertia.e11 = d; mInertia.e12 = 0; mInertia.e13 = 0;
-    mInertia.e21 = 0; mInertia.e22 = d; mInertia.e23 = 0;
-    mInertia.e31 = 0; mInertia.e32 = 0; mInertia.e33 = d;
-    mInertiaInverse = mInertia.Inverse();
+
+    // Diagonal element of the inverse of the diagonal tensor,
+    // computed as Matrix3x3::Inverse does.
+    fInertiaInverse = (d * d) / (d * d * d);
+    if (mInertiaInverse != NULL)
+    {
+        delete mInertiaInverse;
+        mInertiaInverse = NULL;
+    }
+}
+
+
+// Set anisotropic inertia tensor.
+void Particle::setInertia(Matrix3x3 &inertia)
+{
+    if (mInertiaInverse == NULL)
+    {
+        mInertiaInverse = new Matrix3x3();
+        assert(mInertiaInverse != NULL);
+    }
+    *mInertiaInverse = inertia.Inverse();
 }
 
 
@@ -133,10 +178,6 @@ Particle *Particle::read(FILE *fp)
     Particle *particle = new Particle(0);
     assert(particle != NULL);
     fscanf(fp, "%d", &particle->id);
-    if (idFactory <= particle->id)
-    {
-        idFactory = particle->id + 1;
-    }
     fscanf(fp, "%d", &particle->type);
     fscanf(fp, "%d", &particle->state);
     fscanf(fp, "%s", buf);
@@ -162,30 +203,37 @@ Particle *Particle::read(FILE *fp)
     fscanf(fp, "%s", buf);
     particle->vPosition.y = (float)atof(buf);
     fscanf(fp, "%s", buf);
+    #if ( DIMENSIONS == 3 )
     particle->vPosition.z = (float)atof(buf);
+    #endif
     fscanf(fp, "%s", buf);
     particle->vVelocity.x = (float)atof(buf);
     fscanf(fp, "%s", buf);
     particle->vVelocity.y = (float)atof(buf);
     fscanf(fp, "%s", buf);
+    #if ( DIMENSIONS == 3 )
     particle->vVelocity.z = (float)atof(buf);
+    #endif
     fscanf(fp, "%s", buf);
     particle->vForces.x = (float)atof(buf);
     fscanf(fp, "%s", buf);
     particle->vForces.y = (float)atof(buf);
     fscanf(fp, "%s", buf);
+    #if ( DIMENSIONS == 3 )
     particle->vForces.z = (float)atof(buf);
+    #endif
     return(particle);
 }
 
 
 // Write particle.
+// Floats are written with 9 significant digits, which read back exactly.
 void Particle::write(FILE *fp, Particle *particle)
 {
     fprintf(fp, "%d ", particle->id);
     fprintf(fp, "%d ", particle->type);
     fprintf(fp, "%d ", particle->state);
-    fprintf(fp, "%f %f %f %f ", particle->fRadius,
+    fprintf(fp, "%.9g %.9g %.9g %.9g ", particle->fRadius,
         particle->fMass, particle->fCharge,
         particle->coefficientOfRestitution);
     if (particle->orientation.mirrored)
@@ -196,11 +244,11 @@ void Particle::write(FILE *fp, Particle *particle)
     {
         fprintf(fp, "%d 0 ", particle->orientation.direction);
     }
-    fprintf(fp, "%f %f %f ", particle->vPosition.x,
-        particle->vPosition.y, particle->vPosition.z);
-    fprintf(fp, "%f %f %f ", particle->vVelocity.x,
-        particle->vVelocity.y, particle->vVelocity.z);
-    fprintf(fp, "%f %f %f ", particle->vForces.x,
-        particle->vForces.y, particle->vForces.z);
+    fprintf(fp, "%.9g %.9g %.9g ", particle->vPosition.x,
+        particle->vPosition.y, GetZ(particle->vPosition));
+    fprintf(fp, "%.9g %.9g %.9g ", particle->vVelocity.x,
+        particle->vVelocity.y, GetZ(particle->vVelocity));
+    fprintf(fp, "%.9g %.9g %.9g ", particle->vForces.x,
+        particle->vForces.y, GetZ(particle->vForces));
     fflush(fp);
 }
@@ -24,31 +24,68 @@
 
 #include <stdio.h>
 #include "../util/Math_etc.h"
+#include "Parameters.h"
 #include "Orientation.hpp"
 #include "Bond.hpp"
 
+// Particle vector: positions, velocities and forces.
+#if ( DIMENSIONS == 3 )
+typedef Vector3D Vector;
+#else
+typedef Vector2D Vector;
+#endif
+
+class ActivityTile;
+
 class Particle
 {
     public:
 
-        int id;                                   // id
+        int id;                                   // id (-1 until added to physics)
         int type;                                 // type
         int state;                                // state
         float fRadius;                            // radius
         float fMass;                              // mass
-        Matrix3x3 mInertia;                       // mass moment of inertia
-        Matrix3x3 mInertiaInverse;                // inverse of mass moment of inertia
+        float fInertiaInverse;                    // inverse of isotropic moment of inertia
+        Matrix3x3 *mInertiaInverse;               // inverse of anisotropic inertia (NULL = isotropic)
         float fCharge;                            // charge
         float coefficientOfRestitution;
         Orientation orientation;                  // orientation
         Particle *bonds[8];                       // bonds to particles
         Bond *bondProperties[8];                  // bond properties
-        Vector3D vPosition;                       // position
-        Vector3D vVelocity;                       // velocity
-        Vector3D vForces;                         // force
+        Vector vPosition;                         // position
+        Vector vVelocity;                         // velocity
+        Vector vForces;                           // force
         Particle *collide;
         Particle *next;
 
+        // Spatial grid membership (see Grid.hpp).
+        Particle *cellNext;                       // next particle in cell
+        int cellX,cellY;                          // cell
+        bool inGrid;
+        int order;                                // particle list order
+
+        // Activity tile membership (see Physics.hpp).
+        ActivityTile *tile;
+        int tileIndex;                            // index in tile
+        int activeIndex;                          // index in stepped particles
+
+        // Particle sleeping (see Physics.hpp).
+        bool asleep;
+        int restCycles;                           // consecutive cycles at rest
+
+        // Verlet neighbor list membership (see Physics.hpp).
+        int verletIndex;                          // list index (-1 = none)
+        Vector verletPosition;                    // position at list build
+
+        // Molecule membership (see Physics.hpp).
+        int molecule;                             // molecule id (-1 = none)
+        int moleculeMark;                         // traversal mark
+
+        // Ghost: read-only copy of a particle owned by another
+        // process of a decomposed run (see Domain.hpp).
+        bool ghost;
+
         // Constructor.
         Particle(int type, float radius, float mass, float charge);
         Particle(int type);
@@ -59,14 +96,14 @@ class Particle
         // Duplicate particle.
         Particle *duplicate();
 
-        // Calculate inertia.
+        // Calculate isotropic inertia from mass and radius.
         void calcInertia();
 
+        // Set anisotropic inertia tensor.
+        void setInertia(Matrix3x3 &inertia);
+
         // Read and write particle.
         static Particle *read(FILE *fp);
         static void write(FILE *fp, Particle *particle);
-
-        // ID factory.
-        static int idFactory;
 };
 #endif
@@ -20,15 +20,150 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <algorithm>
 #include "Physics.hpp"
-#include "../util/Random.hpp"
+#include "Instrument.hpp"
+
+// Parameter names and members.
+static const char *ParameterNames[] =
+{
+    "brownianProbability",
+    "maxBrownianForce",
+    "viscosityFriction",
+    "maxVelocity",
+    "maxBondLength",
+    "defaultBondStrength",
+    "chargeConstant"
+};
+static float PhysicsParameters::*ParameterMembers[] =
+{
+    &PhysicsParameters::brownianProbability,
+    &PhysicsParameters::maxBrownianForce,
+    &PhysicsParameters::viscosityFriction,
+    &PhysicsParameters::maxVelocity,
+    &PhysicsParameters::maxBondLength,
+    &PhysicsParameters::defaultBondStrength,
+    &PhysicsParameters::chargeConstant
+};
+#define NUM_PARAMETERS 7
+
+// Compile-time default parameters.
+struct DefaultParameters
+{
+    float brownianProbability() const { return BROWNIAN_PROBABILITY; }
+    float maxBrownianForce() const { return MAX_BROWNIAN_FORCE; }
+    float viscosityFriction() const { return VISCOSITY_FRICTION; }
+    float maxVelocity() const { return MAX_VELOCITY; }
+    float maxBondLength() const { return MAX_BOND_LENGTH; }
+    float chargeConstant() const { return CHARGE_CONSTANT; }
+};
+
+// Runtime parameters.
+struct RuntimeParameters
+{
+    const PhysicsParameters *parameters;
+    RuntimeParameters(const PhysicsParameters *parameters) { this->parameters = parameters; }
+    float brownianProbability() const { return parameters->brownianProbability; }
+    float maxBrownianForce() const { return parameters->maxBrownianForce; }
+    float viscosityFriction() const { return parameters->viscosityFriction; }
+    float maxVelocity() const { return parameters->maxVelocity; }
+    float maxBondLength() const { return parameters->maxBondLength; }
+    float chargeConstant() const { return parameters->chargeConstant; }
+};
+
+// Parameters constructor.
+PhysicsParameters::PhysicsParameters()
+{
+    brownianProbability = BROWNIAN_PROBABILITY;
+    maxBrownianForce = MAX_BROWNIAN_FORCE;
+    viscosityFriction = VISCOSITY_FRICTION;
+    maxVelocity = MAX_VELOCITY;
+    maxBondLength = MAX_BOND_LENGTH;
+    defaultBondStrength = DEFAULT_BOND_STRENGTH;
+    chargeConstant = CHARGE_CONSTANT;
+}
+
+
+// All default values?
+bool PhysicsParameters::isDefault()
+{
+    PhysicsParameters defaults;
+
+    for (int i = 0; i < NUM_PARAMETERS; i++)
+    {
+        if (this->*ParameterMembers[i] != defaults.*ParameterMembers[i]) return false;
+    }
+    return true;
+}
+
+
+// Set parameter by name.
+bool PhysicsParameters::set(const char *name, float value)
+{
+    for (int i = 0; i < NUM_PARAMETERS; i++)
+    {
+        if (strcmp(name, ParameterNames[i]) == 0)
+        {
+            this->*ParameterMembers[i] = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Parameters by index.
+int PhysicsParameters::getCount()
+{
+    return NUM_PARAMETERS;
+}
+
+
+const char *PhysicsParameters::getName(int index)
+{
+    return ParameterNames[index];
+}
+
+
+float PhysicsParameters::get(int index)
+{
+    return this->*ParameterMembers[index];
+}
+
 
 // Constructor.
 Physics::Physics()
 {
     particles = NULL;
     numParticles = 0;
+    profiler = NULL;
+    idFactory = 0;
+    idStride = 1;
+    width = WIDTH;
+    height = HEIGHT;
+    periodic = false;
+    verletSkin = 0.0f;
+    chargeCutoff = 0.0f;
+    verletValid = false;
+    verletMoved = false;
+    verletBuilds = 0;
+    bondEdgesValid = false;
+    vectorKernels = false;
+    maxParticles = MAX_PARTICLES;
     collisions = NULL;
+    gridValid = false;
+    headOrder = 0;
+    maxRadius = 0.0f;
+    sleepEnabled = false;
+    quiescentState = 0;
+    particleSleep = false;
+    brownianSkip = -1;
+    kickNext = 0;
+    numMolecules = 0;
+    moleculeMark = 0;
 }
 
 
@@ -43,6 +178,35 @@ Physics::~Physics()
         delete particles;
         particles = particle;
     }
+    clearTiles();
+}
+
+
+// Set world size.
+void Physics::setSize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    gridValid = false;
+    verletValid = false;
+}
+
+
+// Enable or disable periodic boundaries.
+void Physics::setPeriodic(bool enable)
+{
+    periodic = enable;
+    gridValid = false;
+    verletValid = false;
+}
+
+
+// Wrap coordinate into 0..size.
+float Physics::wrap(float position, int size)
+{
+    while (position < 0.0f) position += (float)size;
+    while (position >= (float)size) position -= (float)size;
+    return position;
 }
 
 
@@ -50,10 +214,11 @@ Physics::~Physics()
 Particle *Physics::createParticle(int type, float radius,
 float mass, float charge)
 {
-    if (numParticles >= MAX_PARTICLES) return NULL;
+    if (numParticles >= maxParticles) return NULL;
     Particle *particle = new Particle(type, radius,
         mass, charge);
     assert(particle != NULL);
+    INSTRUMENT_COUNT(COUNT_PARTICLES_CREATED);
     addParticle(particle);
     return(particle);
 }
@@ -61,9 +226,10 @@ float mass, float charge)
 
 Particle *Physics::createParticle(int type)
 {
-    if (numParticles >= MAX_PARTICLES) return NULL;
+    if (numParticles >= maxParticles) return NULL;
     Particle *particle = new Particle(type);
     assert(particle != NULL);
+    INSTRUMENT_COUNT(COUNT_PARTICLES_CREATED);
     addParticle(particle);
     return(particle);
 }
@@ -72,17 +238,37 @@ Particle *Physics::createParticle(int type)
 // Add particle to system.
 void Physics::addParticle(Particle *particle)
 {
-    Vector3D velocity;
+    Vector velocity;
     addParticle(particle, velocity);
 }
 
 
-void Physics::addParticle(Particle *particle, Vector3D &velocity)
+void Physics::addParticle(Particle *particle, Vector &velocity)
 {
+    if (particle->id == -1)
+    {
+        particle->id = idFactory;
+        idFactory += idStride;
+    }
+    else if (idFactory <= particle->id)
+    {
+        idFactory += ((particle->id - idFactory) / idStride + 1) * idStride;
+    }
     particle->vVelocity = velocity;
     particle->next = particles;
     particles = particle;
     numParticles++;
+    particle->order = --headOrder;
+    particle->molecule = newMolecule(1);
+    countSpecies(particle, 1);
+    particle->inGrid = false;
+    particle->verletIndex = -1;
+    verletValid = false;
+    bondEdgesValid = false;
+    if (gridValid) gridPending.push_back(particle);
+    particle->tile = NULL;
+    particle->activeIndex = -1;
+    if (sleepEnabled) tilePending.push_back(particle);
 }
 
 
@@ -95,6 +281,17 @@ void Physics::removeParticle(Particle *particle)
         particle2 != NULL && particle2 != particle;
         particle3 = particle2, particle2 = particle2->next) {}
     if (particle2 == NULL) return;
+    verletValid = false;
+    bondEdgesValid = false;
+
+    // Unbind, splitting the molecule, and release the particle's own.
+    for (int i = 0; i < 8; i++)
+    {
+        if (particle->bonds[i] != NULL) removeBond(particle, particle->bonds[i]);
+    }
+    freeMolecule(particle->molecule);
+    countSpecies(particle, -1);
+
     if (particle3 == NULL)
     {
         particles = particle2->next;
@@ -103,8 +300,34 @@ void Physics::removeParticle(Particle *particle)
     {
         particle3->next = particle2->next;
     }
+    if (particle->inGrid)
+    {
+        grid.remove(particle);
+    }
+    else
+    {
+        std::vector<Particle *>::iterator itr =
+            std::find(gridPending.begin(), gridPending.end(), particle);
+        if (itr != gridPending.end()) gridPending.erase(itr);
+    }
+    if (sleepEnabled)
+    {
+        if (particle->activeIndex >= 0) active[particle->activeIndex] = NULL;
+        if (particle->tile != NULL)
+        {
+            wakeTile(particle->tile);
+            unplaceParticle(particle);
+        }
+        else
+        {
+            std::vector<Particle *>::iterator itr =
+                std::find(tilePending.begin(), tilePending.end(), particle);
+            if (itr != tilePending.end()) tilePending.erase(itr);
+        }
+    }
     delete particle;
     numParticles--;
+    INSTRUMENT_COUNT(COUNT_PARTICLES_DESTROYED);
 }
 
 
@@ -127,7 +350,7 @@ bool Physics::createBond(Particle *particle1, int direction1,
 Particle *particle2, int direction2)
 {
     return createBond(particle1, direction1,
-        particle2, direction2, DEFAULT_BOND_STRENGTH);
+        particle2, direction2, parameters.defaultBondStrength);
 }
 
 
@@ -151,6 +374,13 @@ Particle *particle2, int direction2, float strength)
     assert(particle1->bondProperties[direction1] != NULL);
     particle2->bondProperties[direction2] =
         particle1->bondProperties[direction1];
+    bondEdgesValid = false;
+    joinMolecules(particle1, particle2);
+    if (sleepEnabled || particleSleep)
+    {
+        wake(particle1);
+        wake(particle2);
+    }
     return true;
 }
 
@@ -174,12 +404,17 @@ void Physics::removeBond(Particle *particle1, int direction1)
         particle1->bonds[direction1] = NULL;
         delete particle1->bondProperties[direction1];
         particle1->bondProperties[direction1] = NULL;
+        bondEdgesValid = false;
+        splitMolecule(particle1, particle2);
     }
 }
 
 
 void Physics::removeBond(Particle *particle1, Particle *particle2)
 {
+    bool removed = false;
+
+    bondEdgesValid = false;
     for (int i = 0; i < 8; i++)
     {
         if (particle1->bonds[i] == particle2)
@@ -187,6 +422,7 @@ void Physics::removeBond(Particle *particle1, Particle *particle2)
             particle1->bonds[i] = NULL;
             delete particle1->bondProperties[i];
             particle1->bondProperties[i] = NULL;
+            removed = true;
         }
         if (particle2->bonds[i] == particle1)
         {
@@ -194,314 +430,1514 @@ void Physics::removeBond(Particle *particle1, Particle *particle2)
             particle2->bondProperties[i] = NULL;
         }
     }
+    if (removed) splitMolecule(particle1, particle2);
 }
 
 
-// Step system by given time increment.
-void Physics::step(float dtime)
+// Set particle type.
+void Physics::setType(Particle *particle, int type)
 {
-    Particle *particle,*particle2;
-    Collision *collision;
-    float dist;
-    int i,j;
-
-    // Integrate.
-    for (particle = particles; particle != NULL; particle = particle->next)
-    {
-        // Add Brownian motion force.
-        if (Random::nextDouble() < BROWNIAN_PROBABILITY)
-        {
-            if (Random::nextBoolean())
-            {
-                particle->vForces.x += Random::nextFloat() * MAX_BROWNIAN_FORCE;
-            }
-            else
-            {
-                particle->vForces.x -= Random::nextFloat() * MAX_BROWNIAN_FORCE;
-            }
-            if (Random::nextBoolean())
-            {
-                particle->vForces.y += Random::nextFloat() * MAX_BROWNIAN_FORCE;
-            }
-            else
-            {
-                particle->vForces.y -= Random::nextFloat() * MAX_BROWNIAN_FORCE;
-            }
-        }
+    countSpecies(particle, -1);
+    particle->type = type;
+    countSpecies(particle, 1);
+}
 
-        // Update the velocity of the particle due to forces.
-        particle->vVelocity += (particle->vForces / particle->fMass) * dtime;
-        if (particle->vVelocity.Magnitude() > MAX_VELOCITY)
-        {
-            particle->vVelocity.Normalize(MAX_VELOCITY);
-        }
 
-        // Apply viscosity friction.
-        particle->vVelocity *= (1.0f - VISCOSITY_FRICTION);
+// Set particle state.
+void Physics::setState(Particle *particle, int state)
+{
+    countSpecies(particle, -1);
+    particle->state = state;
+    countSpecies(particle, 1);
+}
 
-        // Update the position of the particle.
-        particle->vPosition += particle->vVelocity * dtime;
-        if (particle->vPosition.x < POSITION(0.0f))
-        {
-            particle->vPosition.x = POSITION(0.0f);
-        }
-        if (particle->vPosition.x > POSITION(WIDTH - 1))
-        {
-            particle->vPosition.x = POSITION(WIDTH - 1);
-        }
-        if (particle->vPosition.y < POSITION(0.0f))
-        {
-            particle->vPosition.y = POSITION(0.0f);
-        }
-        if (particle->vPosition.y > POSITION(HEIGHT - 1))
-        {
-            particle->vPosition.y = POSITION(HEIGHT - 1);
-        }
 
-        // Reset forces.
-        particle->vForces.Zero();
-    }
+// Add count to the species of particle.
+void Physics::countSpecies(Particle *particle, int count)
+{
+    int type = particle->type;
+    int state = particle->state;
 
-    // Break overstretched bonds.
-    for (particle = particles; particle != NULL;
-        particle = particle->next)
+    if (type < 0 || state < 0) return;
+    if (type >= (int)speciesCounts.size()) speciesCounts.resize(type + 1);
+    if (state >= (int)speciesCounts[type].size())
     {
-        for (i = 0; i < 8; i++)
-        {
-            if ((particle2 = particle->bonds[i]) == NULL) continue;
-            dist = (particle->vPosition - particle2->vPosition).Magnitude();
-            if (dist > MAX_BOND_LENGTH)
-            {
-                particle->bonds[i] = NULL;
-                for (j = 0; j < 8; j++)
-                {
-                    if (particle2->bonds[j] == particle)
-                    {
-                        particle2->bonds[j] = NULL;
-                    }
-                }
-            }
-        }
+        speciesCounts[type].resize(state + 1, 0);
     }
+    speciesCounts[type][state] += count;
+}
 
-    // Update charge forces.
-    updateChargeForces();
 
-    // Update bond forces.
-    updateBondForces();
+// New molecule of given size.
+int Physics::newMolecule(int size)
+{
+    int molecule;
 
-    // Detect collisions.
-    for (particle = particles; particle != NULL;
-        particle = particle->next)
+    if (freeMolecules.size() > 0)
     {
-        particle->collide = NULL;
+        molecule = freeMolecules.back();
+        freeMolecules.pop_back();
     }
-    for (particle = particles; particle != NULL;
-        particle = particle->next)
+    else
     {
-        checkCollisions(particle);
+        molecule = (int)moleculeSizes.size();
+        moleculeSizes.push_back(0);
     }
+    setMoleculeSize(molecule, size);
+    numMolecules++;
+    return molecule;
+}
 
-    // Resolve collisions.
-    resolveCollisions();
 
-    // Release collisions.
-    while (collisions != NULL)
+// Release molecule.
+void Physics::freeMolecule(int molecule)
+{
+    if (molecule < 0 || moleculeSizes[molecule] == 0) return;
+    setMoleculeSize(molecule, 0);
+    freeMolecules.push_back(molecule);
+    numMolecules--;
+}
+
+
+// Set molecule size, keeping the number of molecules by size.
+void Physics::setMoleculeSize(int molecule, int size)
+{
+    if (moleculeSizes[molecule] > 0) moleculeCounts[moleculeSizes[molecule]]--;
+    moleculeSizes[molecule] = size;
+    if (size > 0)
     {
-        collision = collisions;
-        collisions = collision->next;
-        delete collision;
+        if (size >= (int)moleculeCounts.size()) moleculeCounts.resize(size + 1, 0);
+        moleculeCounts[size]++;
     }
 }
 
 
-// Update charge forces.
-void Physics::updateChargeForces()
+// Join molecules of newly bonded particles: the smaller takes the
+// id of the larger.
+void Physics::joinMolecules(Particle *particle1, Particle *particle2)
 {
-    Particle *particle1,*particle2;
-    Vector3D vForce;
-    float dist;
-    float s;
+    int molecule1,molecule2;
 
-    for (particle1 = particles; particle1 != NULL;
-        particle1 = particle1->next)
+    molecule1 = particle1->molecule;
+    molecule2 = particle2->molecule;
+    if (molecule1 == molecule2 || molecule1 < 0 || molecule2 < 0) return;
+    if (moleculeSizes[molecule1] < moleculeSizes[molecule2])
     {
-        for (particle2 = particles; particle2 != NULL;
-            particle2 = particle2->next)
-        {
-            if (particle1 == particle2) continue;
-            vForce = particle1->vPosition - particle2->vPosition;
-            dist = vForce.Magnitude();
-            if (dist > 0.0f)
-            {
-                // Force is proportional to inverse square of distance.
-                vForce.Normalize();
-                s = (CHARGE_CONSTANT *
-                    particle1->fCharge * particle2->fCharge) /
-                    (dist * dist);
-                vForce *= s;
-                particle1->vForces += vForce;
-            }
-        }
+        molecule1 = particle2->molecule;
+        molecule2 = particle1->molecule;
+        particle2 = particle1;
     }
+    setMoleculeSize(molecule1, moleculeSizes[molecule1] + moleculeSizes[molecule2]);
+    freeMolecule(molecule2);
+    labelMolecule(particle2, molecule2, molecule1);
 }
 
 
-// Update bond forces on other particles.
-// Bond force acts to move bonded particles to
-// their proper relative positions according to their
-// bonding orientations.
-void Physics::updateBondForces()
+// Split molecule of particles whose bond was removed.
+// Each side is traversed a particle at a time in turn. If a side
+// reaches a particle of the other, the molecule is whole; if a side
+// runs out, it is the smaller part and becomes a new molecule.
+void Physics::splitMolecule(Particle *particle1, Particle *particle2)
 {
-    int i;
-    Particle *particle1,*particle2;
-    Vector3D vPosition,vForce;
-
-    for (particle1 = particles; particle1 != NULL;
-        particle1 = particle1->next)
+    int i,side,marks[2],head[2],molecule;
+    Particle *particle,*partner;
+    std::vector<Particle *> *queue;
+
+    if (particle1 == particle2 || particle1->molecule < 0 ||
+        particle1->molecule != particle2->molecule) return;
+    marks[0] = nextMoleculeMark();
+    marks[1] = nextMoleculeMark();
+    moleculeQueues[0].clear();
+    moleculeQueues[1].clear();
+    moleculeQueues[0].push_back(particle1);
+    moleculeQueues[1].push_back(particle2);
+    particle1->moleculeMark = marks[0];
+    particle2->moleculeMark = marks[1];
+    head[0] = head[1] = 0;
+    for (;;)
     {
-        for (i = 0; i < 8; i++)
+        for (side = 0; side < 2; side++)
         {
-            if ((particle2 = particle1->bonds[i]) == NULL) continue;
-
-            // Force on particle is proportional to distance
-            // of particle from expected position.
-            vPosition = particle1->vPosition;
-            switch(i)
+            queue = &moleculeQueues[side];
+            if (head[side] == (int)queue->size())
             {
-                case NORTH:
-                    vPosition.y += 1.0f;
-                    break;
-                case NORTHEAST:
-                    vPosition.x += 1.0f;
-                    vPosition.y += 1.0f;
-                    break;
-                case EAST:
-                    vPosition.x += 1.0f;
-                    break;
-                case SOUTHEAST:
-                    vPosition.x += 1.0f;
-                    vPosition.y -= 1.0f;
-                    break;
-                case SOUTH:
-                    vPosition.y -= 1.0f;
-                    break;
-                case SOUTHWEST:
-                    vPosition.x -= 1.0f;
-                    vPosition.y -= 1.0f;
-                    break;
-                case WEST:
-                    vPosition.x -= 1.0f;
-                    break;
-                case NORTHWEST:
-                    vPosition.x -= 1.0f;
-                    vPosition.y += 1.0f;
-                    break;
+                molecule = particle1->molecule;
+                setMoleculeSize(molecule, moleculeSizes[molecule] - (int)queue->size());
+                molecule = newMolecule((int)queue->size());
+                for (i = 0; i < (int)queue->size(); i++)
+                {
+                    (*queue)[i]->molecule = molecule;
+                }
+                return;
             }
-            vForce = vPosition - particle2->vPosition;
-            if (vForce.Magnitude() > 0.0f)
+            particle = (*queue)[head[side]++];
+            for (i = 0; i < 8; i++)
             {
-                vForce *= particle1->bondProperties[i]->getStrength();
-                particle2->vForces += vForce;
+                if ((partner = particle->bonds[i]) == NULL) continue;
+                if (partner->moleculeMark == marks[1 - side]) return;
+                if (partner->moleculeMark == marks[side]) continue;
+                partner->moleculeMark = marks[side];
+                queue->push_back(partner);
             }
         }
     }
 }
 
 
-// Check for collisions with body's particles.
-void Physics::checkCollisions(Particle *particle1)
+// Relabel particles of a molecule reachable from particle.
+void Physics::labelMolecule(Particle *particle, int from, int to)
 {
-    Particle *particle2;
-    Vector3D vnormal,vrelative;
-    Collision *collision;
-
-    if (particle1->collide != NULL) return;
-
-    for (particle2 = particles;
-        particle2 != NULL; particle2 = particle2->next)
+    int i,head;
+    Particle *partner;
+    std::vector<Particle *> &queue = moleculeQueues[0];
+
+    queue.clear();
+    particle->molecule = to;
+    queue.push_back(particle);
+    for (head = 0; head < (int)queue.size(); head++)
     {
-        if (particle1 == particle2) continue;
-        if (particle2->collide != NULL) continue;
-
-        // Particles intersect?
-        vnormal = particle1->vPosition - particle2->vPosition;
-        if (vnormal.Magnitude() < (particle1->fRadius + particle2->fRadius))
+        particle = queue[head];
+        for (i = 0; i < 8; i++)
         {
-            // Particles moving toward each other?
-            vnormal.Normalize();
-            vrelative = particle1->vVelocity - particle2->vVelocity;
-            if ((vrelative * vnormal) < 0.0)
-            {
-                collision = new Collision();
-                assert(collision != NULL);
-                collision->particle1 = particle1;
-                collision->particle2 = particle2;
-                particle1->collide = particle2;
-                particle2->collide = particle1;
-                collision->vCollisionNormal = vnormal;
-                collision->vCollisionPoint = (vnormal * particle1->fRadius) +
-                    particle1->vPosition;
-                collision->vRelativeVelocity = vrelative;
-                collision->next = collisions;
-                collisions = collision;
-                return;
-            }
+            if ((partner = particle->bonds[i]) == NULL) continue;
+            if (partner->molecule != from) continue;
+            partner->molecule = to;
+            queue.push_back(partner);
         }
     }
 }
 
 
-// Resolve collisions.
-void Physics::resolveCollisions()
+// Build molecules from bonds.
+void Physics::buildMolecules()
 {
-    Collision *collision;
-    Particle *particle1,*particle2;
-    Vector3D pt1,pt2;
-    float impulse;
-    float coefficientOfRestitution;
+    Particle *particle;
+    int molecule;
 
-    for (collision = collisions; collision != NULL; collision = collision->next)
+    moleculeSizes.clear();
+    moleculeCounts.clear();
+    freeMolecules.clear();
+    numMolecules = 0;
+    for (particle = particles; particle != NULL; particle = particle->next)
     {
-        particle1 = collision->particle1;
-        particle2 = collision->particle2;
-
-        // Calculate impulse force.
-        pt1 = collision->vCollisionPoint - particle1->vPosition;
-        pt2 = collision->vCollisionPoint - particle2->vPosition;
-        coefficientOfRestitution = (particle1->coefficientOfRestitution +
-            particle2->coefficientOfRestitution) / 2.0f;
-        impulse =
-            (-(1.0f + coefficientOfRestitution) *
-            (collision->vRelativeVelocity * collision->vCollisionNormal)) /
-            ((1.0f / particle1->fMass + 1.0f / particle2->fMass) +
-            (collision->vCollisionNormal *
-            (((pt1 ^ collision->vCollisionNormal) * particle1->mInertiaInverse) ^ pt1)) +
-            (collision->vCollisionNormal *
-            (((pt2 ^ collision->vCollisionNormal) * particle2->mInertiaInverse) ^ pt2))
-            );
-
-        // Accumulate forces.
-        particle1->vForces += impulse * collision->vCollisionNormal;
-        particle2->vForces -= impulse * collision->vCollisionNormal;
+        particle->molecule = -1;
+    }
+    for (particle = particles; particle != NULL; particle = particle->next)
+    {
+        if (particle->molecule != -1) continue;
+        molecule = newMolecule(0);
+        labelMolecule(particle, -1, molecule);
+        setMoleculeSize(molecule, (int)moleculeQueues[0].size());
     }
 }
 
 
-// Load particles.
-void Physics::load(FILE *fp)
+// Next traversal mark: marks restart from 0 before they overflow.
+int Physics::nextMoleculeMark()
 {
-    int i,j,id1,id2,num;
-    Particle *particle1,*particle2;
-    char buf[50];
+    Particle *particle;
+
+    if (moleculeMark == INT_MAX)
+    {
+        for (particle = particles; particle != NULL; particle = particle->next)
+        {
+            particle->moleculeMark = 0;
+        }
+        moleculeMark = 0;
+    }
+    return ++moleculeMark;
+}
+
+
+// Step system by given time increment.
+void Physics::step(float dtime)
+{
+    INSTRUMENT_TIMER(TIMER_PHYSICS_STEP);
+
+    if (parameters.isDefault())
+    {
+        step(dtime, DefaultParameters());
+    }
+    else
+    {
+        step(dtime, RuntimeParameters(&parameters));
+    }
+}
+
+
+template <class P> void Physics::step(float dtime, const P &p)
+{
+    Particle *particle;
+    int i;
+
+    // Gather particles of awake tiles.
+    if (sleepEnabled) gatherActive();
+
+    // Draw the Brownian kick tests.
+    if (!particleSleep)
+    {
+        kickDraws.resize(sleepEnabled ? active.size() : (size_t)numParticles);
+        random.fill(kickDraws.data(), (int)kickDraws.size());
+        kickNext = 0;
+    }
+
+    // Integrate.
+    if (profiler != NULL) profiler->beginPhase(PHASE_INTEGRATE);
+    if (vectorKernels)
+    {
+        integrateKernel(dtime, p);
+    }
+    else if (sleepEnabled)
+    {
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            integrate(active[i], dtime, p);
+        }
+    }
+    else
+    {
+        for (particle = particles; particle != NULL; particle = particle->next)
+        {
+            integrate(particle, dtime, p);
+        }
+    }
+    if (sleepEnabled)
+    {
+        updateTiles();
+    }
+    else
+    {
+        gridValid = false;
+    }
+    verletMoved = true;
+    if (profiler != NULL) profiler->endPhase(PHASE_INTEGRATE);
+
+    // Update charge forces.
+    if (profiler != NULL) profiler->beginPhase(PHASE_CHARGE_FORCES);
+    updateChargeForces(p);
+    if (profiler != NULL) profiler->endPhase(PHASE_CHARGE_FORCES);
+
+    // Break overstretched bonds and update bond forces.
+    if (profiler != NULL) profiler->beginPhase(PHASE_BOND_FORCES);
+    updateBonds(p);
+    if (profiler != NULL) profiler->endPhase(PHASE_BOND_FORCES);
+
+    // Detect collisions.
+    if (profiler != NULL) profiler->beginPhase(PHASE_COLLISIONS);
+    detectCollisions();
+
+    // Resolve collisions.
+    resolveCollisions();
+
+    // Release collisions.
+    releaseCollisions();
+    if (profiler != NULL) profiler->endPhase(PHASE_COLLISIONS);
+
+    // Sleep quiet tiles.
+    if (sleepEnabled) updateSleep();
+}
+
+
+// Begin integrating particle: apply Brownian force.
+// Returns false if the particle does not move.
+template <class P> bool Physics::beginIntegrate(Particle *particle, const P &p)
+{
+    bool kick;
+
+    // Ghosts are integrated by their owners.
+    if (particle->ghost) return false;
+
+    // Sleeping particles wake on a Brownian kick or a force.
+    kick = brownianKick(p);
+    if (particle->asleep)
+    {
+        if (!kick && particle->vForces.x == 0.0f &&
+            particle->vForces.y == 0.0f) return false;
+        particle->asleep = false;
+        particle->restCycles = 0;
+    }
+
+    // Add Brownian motion force.
+    if (kick)
+    {
+        if (random.nextBoolean())
+        {
+            particle->vForces.x += random.nextFloat() * p.maxBrownianForce();
+        }
+        else
+        {
+            particle->vForces.x -= random.nextFloat() * p.maxBrownianForce();
+        }
+        if (random.nextBoolean())
+        {
+            particle->vForces.y += random.nextFloat() * p.maxBrownianForce();
+        }
+        else
+        {
+            particle->vForces.y -= random.nextFloat() * p.maxBrownianForce();
+        }
+    }
+    return true;
+}
+
+
+// Integrate particle.
+template <class P> void Physics::integrate(Particle *particle,
+float dtime, const P &p)
+{
+    if (!beginIntegrate(particle, p)) return;
+
+    // Update the velocity of the particle due to forces.
+    particle->vVelocity += (particle->vForces / particle->fMass) * dtime;
+    if (particle->vVelocity.Magnitude() > p.maxVelocity())
+    {
+        particle->vVelocity.Normalize(p.maxVelocity());
+    }
+
+    // Apply viscosity friction.
+    particle->vVelocity *= (1.0f - p.viscosityFriction());
+
+    // Update the position of the particle.
+    particle->vPosition += particle->vVelocity * dtime;
+    if (periodic)
+    {
+        particle->vPosition.x = wrap(particle->vPosition.x, width);
+        particle->vPosition.y = wrap(particle->vPosition.y, height);
+    }
+    else
+    {
+        if (particle->vPosition.x < POSITION(0.0f))
+        {
+            particle->vPosition.x = POSITION(0.0f);
+        }
+        if (particle->vPosition.x > POSITION(width - 1))
+        {
+            particle->vPosition.x = POSITION(width - 1);
+        }
+        if (particle->vPosition.y < POSITION(0.0f))
+        {
+            particle->vPosition.y = POSITION(0.0f);
+        }
+        if (particle->vPosition.y > POSITION(height - 1))
+        {
+            particle->vPosition.y = POSITION(height - 1);
+        }
+    }
+
+    endIntegrate(particle);
+}
+
+
+// Finish integrating particle: reset forces and sleep it if at rest.
+void Physics::endIntegrate(Particle *particle)
+{
+    int i;
+
+    // Reset forces.
+    particle->vForces.Zero();
+
+    // Sleep particle at rest.
+    if (particleSleep)
+    {
+        for (i = 0; i < 8 && particle->bonds[i] == NULL; i++) {}
+        if (i == 8 && particle->collide == NULL &&
+            particle->vVelocity.Magnitude() < PARTICLE_SLEEP_VELOCITY)
+        {
+            particle->restCycles++;
+            if (particle->restCycles >= PARTICLE_SLEEP_CYCLES)
+            {
+                particle->asleep = true;
+                particle->vVelocity.Zero();
+            }
+        }
+        else
+        {
+            particle->restCycles = 0;
+        }
+    }
+}
+
+
+// Integrate particles through the motion kernel.
+// Particles are integrated in blocks so that they are scattered back
+// while still in cache.
+template <class P> void Physics::integrateKernel(float dtime, const P &p)
+{
+    Particle *particle;
+    MotionParameters parameters;
+    int i,n;
+
+    parameters.dtime = dtime;
+    parameters.maxVelocity = p.maxVelocity();
+    parameters.friction = 1.0f - p.viscosityFriction();
+    parameters.periodic = periodic;
+    parameters.width = (float)width;
+    parameters.height = (float)height;
+    parameters.lowX = parameters.lowY = POSITION(0.0f);
+    parameters.highX = POSITION(width - 1);
+    parameters.highY = POSITION(height - 1);
+    moving.resize(KERNEL_BLOCK);
+    motion.resize(KERNEL_BLOCK);
+    n = 0;
+    if (sleepEnabled)
+    {
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            if (!beginIntegrate(active[i], p)) continue;
+            gatherMotion(active[i], n);
+            if (n == KERNEL_BLOCK) integrateBlock(parameters, n);
+        }
+    }
+    else
+    {
+        for (particle = particles; particle != NULL; particle = particle->next)
+        {
+            if (!beginIntegrate(particle, p)) continue;
+            gatherMotion(particle, n);
+            if (n == KERNEL_BLOCK) integrateBlock(parameters, n);
+        }
+    }
+    integrateBlock(parameters, n);
+}
+
+
+// Gather particle into the motion arrays.
+void Physics::gatherMotion(Particle *particle, int &n)
+{
+    moving[n] = particle;
+    motion.x[n] = particle->vPosition.x;
+    motion.y[n] = particle->vPosition.y;
+    motion.vx[n] = particle->vVelocity.x;
+    motion.vy[n] = particle->vVelocity.y;
+    motion.fx[n] = particle->vForces.x;
+    motion.fy[n] = particle->vForces.y;
+    motion.mass[n] = particle->fMass;
+    n++;
+}
+
+
+// Integrate the gathered block and scatter it back.
+void Physics::integrateBlock(MotionParameters &parameters, int &n)
+{
+    Particle *particle;
+    int i;
+
+    motion.count = n;
+    Kernels::integrate(motion, parameters);
+    for (i = 0; i < n; i++)
+    {
+        particle = moving[i];
+        particle->vPosition.x = motion.x[i];
+        particle->vPosition.y = motion.y[i];
+        particle->vVelocity.x = motion.vx[i];
+        particle->vVelocity.y = motion.vy[i];
+        endIntegrate(particle);
+    }
+    n = 0;
+}
+
+
+// Brownian kick for the next particle?
+// The tests are drawn in one batch at the start of the step.
+// With particle sleeping the kicked particles are found by geometric
+// skip-ahead instead of a random number per particle.
+template <class P> bool Physics::brownianKick(const P &p)
+{
+    if (!particleSleep)
+    {
+        if (kickNext < (int)kickDraws.size())
+        {
+            return kickDraws[kickNext++] < p.brownianProbability();
+        }
+        return random.nextFloat() < p.brownianProbability();
+    }
+    if (brownianSkip < 0)
+    {
+        brownianSkip = sampleBrownianSkip(p.brownianProbability());
+    }
+    if (brownianSkip > 0)
+    {
+        brownianSkip--;
+        return false;
+    }
+    brownianSkip = sampleBrownianSkip(p.brownianProbability());
+    return true;
+}
+
+
+// Sample the number of particles before the next Brownian kick:
+// geometric distribution of failures before a success.
+int Physics::sampleBrownianSkip(float probability)
+{
+    double skip;
+
+    if (probability <= 0.0f) return INT_MAX;
+    if (probability >= 1.0f) return 0;
+    skip = floor(log(1.0 - random.nextDouble()) / log(1.0 - (double)probability));
+    if (skip >= (double)INT_MAX) return INT_MAX;
+    return (int)skip;
+}
+
+
+// Update charge forces.
+void Physics::updateChargeForces()
+{
+    if (parameters.isDefault())
+    {
+        updateChargeForces(DefaultParameters());
+    }
+    else
+    {
+        updateChargeForces(RuntimeParameters(&parameters));
+    }
+}
+
+
+// Only charged particles exert and feel charge forces.
+template <class P> void Physics::updateChargeForces(const P &p)
+{
+    Particle *particle,*particle1,*particle2,**partners;
+    Vector vForce;
+    float dist;
+    float s;
+    int i,j,n,count;
+
+    charged.clear();
+    if (sleepEnabled)
+    {
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            if ((particle = active[i]) != NULL && particle->fCharge != 0.0f)
+            {
+                charged.push_back(particle);
+            }
+        }
+    }
+    else
+    {
+        for (particle = particles; particle != NULL; particle = particle->next)
+        {
+            if (particle->fCharge != 0.0f) charged.push_back(particle);
+        }
+    }
+    n = (int)charged.size();
+    if (chargeCutoff > 0.0f) updateVerlet();
+    for (i = 0; i < n; i++)
+    {
+        particle1 = charged[i];
+
+        // Partners within the cutoff, or all charged particles.
+        if (chargeCutoff > 0.0f)
+        {
+            partners = chargeList.data() + chargeStart[particle1->verletIndex];
+            count = chargeStart[particle1->verletIndex + 1] -
+                chargeStart[particle1->verletIndex];
+        }
+        else
+        {
+            partners = charged.data();
+            count = n;
+        }
+        for (j = 0; j < count; j++)
+        {
+            particle2 = partners[j];
+            if (particle1 == particle2) continue;
+            vForce = particle1->vPosition -
+                getImage(particle2->vPosition, particle1->vPosition);
+            dist = vForce.Magnitude();
+            if (chargeCutoff > 0.0f && dist > chargeCutoff) continue;
+            if (dist > 0.0f)
+            {
+                // Force is proportional to inverse square of distance.
+                vForce.Normalize();
+                s = (p.chargeConstant() *
+                    particle1->fCharge * particle2->fCharge) /
+                    (dist * dist);
+                vForce *= s;
+                particle1->vForces += vForce;
+            }
+        }
+    }
+}
+
+
+// Break overstretched bonds and update bond forces.
+void Physics::updateBonds()
+{
+    if (parameters.isDefault())
+    {
+        updateBonds(DefaultParameters());
+    }
+    else
+    {
+        updateBonds(RuntimeParameters(&parameters));
+    }
+}
+
+
+// Bond force acts to move bonded particles to
+// their proper relative positions according to their
+// bonding orientations.
+template <class P> void Physics::updateBonds(const P &p)
+{
+    int i;
+    BondEdge *edge;
+    Particle *particle1,*particle2;
+    Vector vPosition,vForce;
+
+    if (!bondEdgesValid || sleepEnabled) buildBondEdges();
+    if (vectorKernels)
+    {
+        updateBondsKernel(p.maxBondLength());
+        return;
+    }
+    for (i = 0; i < (int)bondEdges.size(); i++)
+    {
+        edge = &bondEdges[i];
+        particle1 = edge->particle1;
+        particle2 = edge->particle2;
+
+        // Bond broken from its other end?
+        if (particle1->bonds[edge->direction] != particle2) continue;
+
+        // Break overstretched bond.
+        // Bonds between ghosts are left to their owners.
+        vPosition = getImage(particle2->vPosition, particle1->vPosition);
+        if ((particle1->vPosition - vPosition).Magnitude() > p.maxBondLength() &&
+            (!particle1->ghost || !particle2->ghost))
+        {
+            INSTRUMENT_COUNT(COUNT_BOND_BREAKS);
+            removeBond(particle1, edge->direction);
+            continue;
+        }
+
+        // Force on partner is proportional to distance
+        // of partner from expected position.
+        vForce = particle1->vPosition;
+        vForce.x += DirectionOffsetX[edge->direction];
+        vForce.y += DirectionOffsetY[edge->direction];
+        vForce -= vPosition;
+        if (vForce.Magnitude() > 0.0f)
+        {
+            vForce *= edge->bond->getStrength();
+            particle2->vForces += vForce;
+        }
+    }
+}
+
+
+// Build bond edge list.
+void Physics::buildBondEdges()
+{
+    Particle *particle;
+    int i;
+
+    bondEdges.clear();
+    if (sleepEnabled)
+    {
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            if (active[i] != NULL) addBondEdges(active[i]);
+        }
+    }
+    else
+    {
+        for (particle = particles; particle != NULL;
+            particle = particle->next)
+        {
+            addBondEdges(particle);
+        }
+    }
+    bondEdgesValid = true;
+}
+
+
+void Physics::addBondEdges(Particle *particle)
+{
+    BondEdge edge;
+
+    edge.particle1 = particle;
+    for (edge.direction = 0; edge.direction < 8; edge.direction++)
+    {
+        if ((edge.particle2 = particle->bonds[edge.direction]) == NULL) continue;
+        edge.bond = particle->bondProperties[edge.direction];
+        bondEdges.push_back(edge);
+    }
+}
+
+
+// Bonds through the bond kernel: edges are gathered in blocks
+// and applied in list order.
+void Physics::updateBondsKernel(float maxBondLength)
+{
+    int i,n;
+    BondEdge *edge;
+    Vector vPosition;
+
+    bondArrays.resize(KERNEL_BLOCK);
+    bondArrays.maxLength = maxBondLength;
+    for (i = 0; i < (int)bondEdges.size(); i += KERNEL_BLOCK)
+    {
+        bondArrays.count = (int)bondEdges.size() - i;
+        if (bondArrays.count > KERNEL_BLOCK) bondArrays.count = KERNEL_BLOCK;
+        for (n = 0; n < bondArrays.count; n++)
+        {
+            edge = &bondEdges[i + n];
+            vPosition = getImage(edge->particle2->vPosition, edge->particle1->vPosition);
+            bondArrays.x1[n] = edge->particle1->vPosition.x;
+            bondArrays.y1[n] = edge->particle1->vPosition.y;
+            bondArrays.ox[n] = DirectionOffsetX[edge->direction];
+            bondArrays.oy[n] = DirectionOffsetY[edge->direction];
+            bondArrays.x2[n] = vPosition.x;
+            bondArrays.y2[n] = vPosition.y;
+            bondArrays.strength[n] = edge->bond->getStrength();
+        }
+        Kernels::bondForces(bondArrays);
+        applyBondBlock(i, bondArrays.count);
+    }
+}
+
+
+// Break the stretched bonds of a block and add the forces of the rest.
+// Edges whose bond was broken earlier are skipped without reading the bond.
+void Physics::applyBondBlock(int start, int n)
+{
+    int i;
+    BondEdge *edge;
+
+    for (i = 0; i < n; i++)
+    {
+        edge = &bondEdges[start + i];
+        if (edge->particle1->bonds[edge->direction] != edge->particle2) continue;
+        if (bondArrays.stretched[i] &&
+            (!edge->particle1->ghost || !edge->particle2->ghost))
+        {
+            INSTRUMENT_COUNT(COUNT_BOND_BREAKS);
+            removeBond(edge->particle1, edge->direction);
+            continue;
+        }
+        if (bondArrays.apply[i])
+        {
+            edge->particle2->vForces.x += bondArrays.fx[i];
+            edge->particle2->vForces.y += bondArrays.fy[i];
+        }
+    }
+}
+
+
+// Detect collisions between particles.
+void Physics::detectCollisions()
+{
+    Particle *particle;
+
+    int i;
+
+    if (sleepEnabled)
+    {
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            if (active[i] != NULL) active[i]->collide = NULL;
+        }
+        for (i = 0; i < (int)active.size(); i++)
+        {
+            if (active[i] != NULL) checkCollisions(active[i]);
+        }
+        return;
+    }
+    for (particle = particles; particle != NULL;
+        particle = particle->next)
+    {
+        particle->collide = NULL;
+    }
+    for (particle = particles; particle != NULL;
+        particle = particle->next)
+    {
+        checkCollisions(particle);
+    }
+}
+
+
+// Check for collisions with body's particles.
+void Physics::checkCollisions(Particle *particle1)
+{
+    Particle *particle2,**neighbors;
+    Vector vnormal,vrelative;
+    Collision *collision;
+    int i,x,y,reach,count;
+
+    if (particle1->collide != NULL) return;
+
+    // Sleeping particles are at rest: an awake particle finds the collision.
+    // A ghost's collisions are found by its owner.
+    if (particle1->asleep || particle1->ghost) return;
+
+    // Candidates are within reach of the largest radius.
+    if (verletSkin > 0.0f)
+    {
+        updateVerlet();
+        neighbors = verletList.data() + verletStart[particle1->verletIndex];
+        count = verletStart[particle1->verletIndex + 1] -
+            verletStart[particle1->verletIndex];
+    }
+    else
+    {
+        updateGrid();
+        x = Grid::getCell(particle1->vPosition.x);
+        y = Grid::getCell(particle1->vPosition.y);
+        reach = (int)ceilf(particle1->fRadius + maxRadius);
+        getGridParticles(x - reach, y - reach, x + reach, y + reach, candidates);
+        neighbors = candidates.data();
+        count = (int)candidates.size();
+    }
+    for (i = 0; i < count; i++)
+    {
+        particle2 = neighbors[i];
+        if (particle1 == particle2) continue;
+        if (particle2->collide != NULL) continue;
+        INSTRUMENT_COUNT(COUNT_COLLISION_TESTS);
+
+        // Particles intersect?
+        vnormal = particle1->vPosition -
+            getImage(particle2->vPosition, particle1->vPosition);
+        if (vnormal.Magnitude() < (particle1->fRadius + particle2->fRadius))
+        {
+            // Particles moving toward each other?
+            vnormal.Normalize();
+            vrelative = particle1->vVelocity - particle2->vVelocity;
+            if ((vrelative * vnormal) < 0.0)
+            {
+                collision = new Collision();
+                assert(collision != NULL);
+                INSTRUMENT_COUNT(COUNT_COLLISIONS);
+                collision->particle1 = particle1;
+                collision->particle2 = particle2;
+                particle1->collide = particle2;
+                particle2->collide = particle1;
+                if (sleepEnabled || particleSleep)
+                {
+                    wake(particle1);
+                    wake(particle2);
+                }
+                collision->vCollisionNormal = vnormal;
+                collision->vCollisionPoint = (vnormal * particle1->fRadius) +
+                    particle1->vPosition;
+                collision->vRelativeVelocity = vrelative;
+                collision->next = collisions;
+                collisions = collision;
+                return;
+            }
+        }
+    }
+}
+
+
+// Resolve collisions.
+void Physics::resolveCollisions()
+{
+    Collision *collision;
+    Particle *particle1,*particle2;
+    Vector pt1,pt2;
+    float impulse;
+    float coefficientOfRestitution;
+
+    for (collision = collisions; collision != NULL; collision = collision->next)
+    {
+        particle1 = collision->particle1;
+        particle2 = collision->particle2;
+
+        // Calculate impulse force.
+        pt1 = collision->vCollisionPoint - particle1->vPosition;
+        pt2 = collision->vCollisionPoint -
+            getImage(particle2->vPosition, particle1->vPosition);
+        coefficientOfRestitution = (particle1->coefficientOfRestitution +
+            particle2->coefficientOfRestitution) / 2.0f;
+        impulse =
+            (-(1.0f + coefficientOfRestitution) *
+            (collision->vRelativeVelocity * collision->vCollisionNormal)) /
+            ((1.0f / particle1->fMass + 1.0f / particle2->fMass) +
+            getRotationalTerm(particle1, pt1, collision->vCollisionNormal) +
+            getRotationalTerm(particle2, pt2, collision->vCollisionNormal)
+            );
+
+        // Accumulate forces.
+        particle1->vForces += impulse * collision->vCollisionNormal;
+        particle2->vForces -= impulse * collision->vCollisionNormal;
+    }
+}
+
+
+// Rotational term of the collision impulse.
+// An isotropic inertia is a scalar: in the plane, point x normal is along
+// z, and the term reduces to the scalar products below. Particles with an
+// anisotropic inertia use the full tensor in 3D.
+float Physics::getRotationalTerm(Particle *particle, Vector &point,
+Vector &normal)
+{
+    Vector3D vNormal,vPoint;
+    float w;
+
+    if (particle->mInertiaInverse == NULL)
+    {
+        #if ( DIMENSIONS == 3 )
+        return normal * (((point ^ normal) * particle->fInertiaInverse) ^ point);
+        #else
+        w = (point ^ normal) * particle->fInertiaInverse;
+        return normal.x * -(w * point.y) + normal.y * (w * point.x);
+        #endif
+    }
+    vNormal = ToVector3D(normal);
+    vPoint = ToVector3D(point);
+    return vNormal * (((vPoint ^ vNormal) * *particle->mInertiaInverse) ^ vPoint);
+}
+
+
+// Release collisions.
+void Physics::releaseCollisions()
+{
+    Collision *collision;
+
+    while (collisions != NULL)
+    {
+        collision = collisions;
+        collisions = collision->next;
+        delete collision;
+    }
+}
+
+
+// Update grid.
+void Physics::updateGrid()
+{
+    Particle *particle;
+    int i;
+
+    if (!gridValid)
+    {
+        // Rebuild.
+        grid.clear();
+        gridPending.clear();
+        headOrder = 0;
+        maxRadius = 0.0f;
+        for (particle = particles, i = 0; particle != NULL;
+            particle = particle->next, i++)
+        {
+            particle->order = i;
+            grid.insert(particle);
+            if (particle->fRadius > maxRadius) maxRadius = particle->fRadius;
+        }
+        grid.prune();
+        gridValid = true;
+    }
+    else
+    {
+        // Insert added particles.
+        for (i = 0; i < (int)gridPending.size(); i++)
+        {
+            particle = gridPending[i];
+            grid.insert(particle);
+            if (particle->fRadius > maxRadius) maxRadius = particle->fRadius;
+        }
+        gridPending.clear();
+    }
+}
+
+
+// Order particles by list position.
+static bool listOrder(Particle *particle1, Particle *particle2)
+{
+    return particle1->order < particle2->order;
+}
+
+
+// Split cell range into at most two ranges inside a periodic world.
+static int wrapRange(int c1, int c2, int size, int *ranges)
+{
+    int length = c2 - c1;
+
+    if (length + 1 >= size)
+    {
+        ranges[0] = 0;
+        ranges[1] = size - 1;
+        return 1;
+    }
+    c1 = ((c1 % size) + size) % size;
+    c2 = c1 + length;
+    ranges[0] = c1;
+    if (c2 < size)
+    {
+        ranges[1] = c2;
+        return 1;
+    }
+    ranges[1] = size - 1;
+    ranges[2] = 0;
+    ranges[3] = c2 - size;
+    return 2;
+}
+
+
+// Particles in cells, in particle list order.
+// With periodic boundaries the cell range wraps around the world.
+void Physics::getGridParticles(int x1, int y1, int x2, int y2,
+std::vector<Particle *> &result)
+{
+    int i,j,nx,ny,xr[4],yr[4];
+
+    updateGrid();
+    result.clear();
+    if (periodic)
+    {
+        nx = wrapRange(x1, x2, width, xr);
+        ny = wrapRange(y1, y2, height, yr);
+        for (i = 0; i < nx; i++)
+        {
+            for (j = 0; j < ny; j++)
+            {
+                grid.query(xr[i * 2], yr[j * 2], xr[i * 2 + 1],
+                    yr[j * 2 + 1], result);
+            }
+        }
+    }
+    else
+    {
+        grid.query(x1, y1, x2, y2, result);
+    }
+    std::sort(result.begin(), result.end(), listOrder);
+}
+
+
+// Set Verlet list skin and charge cutoff.
+void Physics::setVerlet(float skin, float chargeCutoff)
+{
+    verletSkin = skin;
+    this->chargeCutoff = (skin > 0.0f ? chargeCutoff : 0.0f);
+    verletValid = false;
+    verletParticles.clear();
+    verletStart.clear();
+    verletList.clear();
+    chargeStart.clear();
+    chargeList.clear();
+}
+
+
+// Rebuild Verlet lists if a particle was added or removed, or has
+// moved more than half the skin since the last build.
+void Physics::updateVerlet()
+{
+    Particle *particle;
+    Vector vDisplacement;
+    float limit;
+    int i,n;
+
+    if (verletValid && verletMoved)
+    {
+        limit = 0.25f * verletSkin * verletSkin;
+        n = (sleepEnabled ? (int)active.size() : (int)verletParticles.size());
+        for (i = 0; i < n && verletValid; i++)
+        {
+            particle = (sleepEnabled ? active[i] : verletParticles[i]);
+            if (particle == NULL) continue;
+            vDisplacement = particle->vPosition -
+                getImage(particle->verletPosition, particle->vPosition);
+            if (vDisplacement * vDisplacement > limit) verletValid = false;
+        }
+    }
+    verletMoved = false;
+    if (!verletValid) buildVerlet();
+}
+
+
+// Build Verlet lists from the grid.
+void Physics::buildVerlet()
+{
+    Particle *particle,*particle2;
+    Vector vDistance;
+    float reach,cutoff;
+    int i,j,x,y,range;
+
+    updateGrid();
+    verletParticles.clear();
+    verletStart.clear();
+    verletList.clear();
+    chargeStart.clear();
+    chargeList.clear();
+    for (particle = particles, i = 0; particle != NULL;
+        particle = particle->next, i++)
+    {
+        particle->verletIndex = i;
+        particle->verletPosition = particle->vPosition;
+        verletParticles.push_back(particle);
+        x = Grid::getCell(particle->vPosition.x);
+        y = Grid::getCell(particle->vPosition.y);
+
+        // Collision partners.
+        verletStart.push_back((int)verletList.size());
+        reach = particle->fRadius + maxRadius + verletSkin;
+        range = (int)ceilf(reach);
+        getGridParticles(x - range, y - range, x + range, y + range, candidates);
+        for (j = 0; j < (int)candidates.size(); j++)
+        {
+            particle2 = candidates[j];
+            if (particle2 == particle) continue;
+            vDistance = particle->vPosition -
+                getImage(particle2->vPosition, particle->vPosition);
+            cutoff = particle->fRadius + particle2->fRadius + verletSkin;
+            if (vDistance * vDistance < cutoff * cutoff)
+            {
+                verletList.push_back(particle2);
+            }
+        }
+
+        // Charge partners.
+        chargeStart.push_back((int)chargeList.size());
+        if (chargeCutoff > 0.0f && particle->fCharge != 0.0f)
+        {
+            cutoff = chargeCutoff + verletSkin;
+            range = (int)ceilf(cutoff);
+            getGridParticles(x - range, y - range, x + range, y + range, candidates);
+            for (j = 0; j < (int)candidates.size(); j++)
+            {
+                particle2 = candidates[j];
+                if (particle2 == particle || particle2->fCharge == 0.0f) continue;
+                vDistance = particle->vPosition -
+                    getImage(particle2->vPosition, particle->vPosition);
+                if (vDistance * vDistance < cutoff * cutoff)
+                {
+                    chargeList.push_back(particle2);
+                }
+            }
+        }
+    }
+    verletStart.push_back((int)verletList.size());
+    chargeStart.push_back((int)chargeList.size());
+    verletValid = true;
+    verletBuilds++;
+}
+
+
+// Enable or disable the vector kernels.
+void Physics::setVectorKernels(bool enable)
+{
+    vectorKernels = (enable && DIMENSIONS == 2);
+}
+
+
+// Enable or disable tile sleeping.
+void Physics::setSleep(bool enable, int quiescentState)
+{
+    Particle *particle;
+
+    this->quiescentState = quiescentState;
+    if (enable == sleepEnabled) return;
+    clearTiles();
+    sleepEnabled = enable;
+    if (sleepEnabled)
+    {
+        for (particle = particles; particle != NULL; particle = particle->next)
+        {
+            tilePending.push_back(particle);
+        }
+    }
+}
+
+
+// Wake particle and its tile.
+void Physics::wake(Particle *particle)
+{
+    particle->asleep = false;
+    particle->restCycles = 0;
+    if (particle->tile != NULL) wakeTile(particle->tile);
+}
+
+
+// Enable or disable particle sleeping.
+void Physics::setParticleSleep(bool enable)
+{
+    Particle *particle;
+
+    particleSleep = enable;
+    brownianSkip = -1;
+    for (particle = particles; particle != NULL; particle = particle->next)
+    {
+        particle->asleep = false;
+        particle->restCycles = 0;
+    }
+}
+
+
+// Gather particles of awake tiles.
+void Physics::gatherActive()
+{
+    int i,j;
+    ActivityTile *tile;
+
+    for (i = 0; i < (int)active.size(); i++)
+    {
+        if (active[i] != NULL) active[i]->activeIndex = -1;
+    }
+    active.clear();
+    for (i = 0; i < (int)tilePending.size(); i++)
+    {
+        placeParticle(tilePending[i]);
+    }
+    tilePending.clear();
+    for (i = 0; i < (int)awakeTiles.size(); i++)
+    {
+        tile = awakeTiles[i];
+        for (j = 0; j < (int)tile->particles.size(); j++)
+        {
+            active.push_back(tile->particles[j]);
+        }
+    }
+
+    // Step in particle list order, so that random draws are handed
+    // out as in the reference step while no tile is asleep.
+    std::sort(active.begin(), active.end(), listOrder);
+    for (i = 0; i < (int)active.size(); i++)
+    {
+        active[i]->activeIndex = i;
+    }
+}
+
+
+// Move stepped particles to their new cells and tiles.
+// Sleeping particles do not move, so the grid is updated in place.
+void Physics::updateTiles()
+{
+    int i,x,y;
+    Particle *particle;
+
+    for (i = 0; i < (int)active.size(); i++)
+    {
+        particle = active[i];
+        x = Grid::getCell(particle->vPosition.x);
+        y = Grid::getCell(particle->vPosition.y);
+        if (gridValid && particle->inGrid &&
+            (x != particle->cellX || y != particle->cellY))
+        {
+            grid.remove(particle);
+            grid.insert(particle);
+        }
+        if ((x >> SLEEP_TILE_SHIFT) != particle->tile->x ||
+            (y >> SLEEP_TILE_SHIFT) != particle->tile->y)
+        {
+            unplaceParticle(particle);
+            placeParticle(particle);
+        }
+    }
+}
+
+
+// Put quiet tiles to sleep and wake neighbors of busy tiles.
+void Physics::updateSleep()
+{
+    int i,j,x,y,x2,y2,tilesX,tilesY;
+    bool quiet;
+    float restSpeed;
+    ActivityTile *tile,*tile2;
+    std::vector<ActivityTile *> tiles;
+
+    // Speed of a particle kicked by Brownian motion at rest.
+    restSpeed = SLEEP_BROWNIAN_SPEED * parameters.maxBrownianForce;
+
+    // Tiles across the world, for neighbors across a periodic edge.
+    tilesX = ((width - 1) >> SLEEP_TILE_SHIFT) + 1;
+    tilesY = ((height - 1) >> SLEEP_TILE_SHIFT) + 1;
+
+    // Tiles woken here are appended to the awake tiles.
+    tiles = awakeTiles;
+    for (i = 0; i < (int)tiles.size(); i++)
+    {
+        tile = tiles[i];
+        quiet = true;
+        for (j = 0; j < (int)tile->particles.size() && quiet; j++)
+        {
+            quiet = isQuiescent(tile->particles[j], restSpeed);
+        }
+        if (quiet)
+        {
+            tile->quietCycles++;
+            continue;
+        }
+        tile->quietCycles = 0;
+        for (x = tile->x - 1; x <= tile->x + 1; x++)
+        {
+            for (y = tile->y - 1; y <= tile->y + 1; y++)
+            {
+                x2 = x;
+                y2 = y;
+                if (periodic)
+                {
+                    x2 = (x + tilesX) % tilesX;
+                    y2 = (y + tilesY) % tilesY;
+                }
+                if ((tile2 = getActivityTile(x2, y2, false)) != NULL)
+                {
+                    wakeTile(tile2);
+                }
+            }
+        }
+    }
+
+    // Release empty tiles and sleep quiet ones.
+    tiles.clear();
+    for (i = 0; i < (int)awakeTiles.size(); i++)
+    {
+        tile = awakeTiles[i];
+        if (tile->particles.size() == 0)
+        {
+            activityTiles.erase(((long long)tile->x << 32) |
+                (long long)(unsigned int)tile->y);
+            delete tile;
+        }
+        else if (tile->quietCycles >= SLEEP_CYCLES)
+        {
+            tile->asleep = true;
+        }
+        else
+        {
+            tiles.push_back(tile);
+        }
+    }
+    awakeTiles.swap(tiles);
+}
+
+
+// Is particle quiescent: in the quiescent state, at rest,
+// uncharged, unbonded and not colliding?
+bool Physics::isQuiescent(Particle *particle, float restSpeed)
+{
+    if (particle->state != quiescentState) return false;
+    if (particle->fCharge != 0.0f) return false;
+    if (particle->collide != NULL) return false;
+    for (int i = 0; i < 8; i++)
+    {
+        if (particle->bonds[i] != NULL) return false;
+    }
+    if (particle->vVelocity.Magnitude() > restSpeed) return false;
+    return true;
+}
+
+
+// Add particle to the tile at its position, waking the tile.
+void Physics::placeParticle(Particle *particle)
+{
+    ActivityTile *tile;
+
+    tile = getActivityTile(Grid::getCell(particle->vPosition.x) >> SLEEP_TILE_SHIFT,
+        Grid::getCell(particle->vPosition.y) >> SLEEP_TILE_SHIFT, true);
+    particle->tile = tile;
+    particle->tileIndex = (int)tile->particles.size();
+    tile->particles.push_back(particle);
+    wakeTile(tile);
+}
+
+
+// Remove particle from its tile.
+void Physics::unplaceParticle(Particle *particle)
+{
+    ActivityTile *tile = particle->tile;
+    Particle *last;
+
+    last = tile->particles.back();
+    tile->particles[particle->tileIndex] = last;
+    last->tileIndex = particle->tileIndex;
+    tile->particles.pop_back();
+    particle->tile = NULL;
+    particle->tileIndex = -1;
+}
+
+
+// Get tile.
+ActivityTile *Physics::getActivityTile(int x, int y, bool create)
+{
+    std::unordered_map<long long, ActivityTile *>::iterator itr;
+    ActivityTile *tile;
+    long long key = ((long long)x << 32) | (long long)(unsigned int)y;
+
+    if ((itr = activityTiles.find(key)) != activityTiles.end()) return itr->second;
+    if (!create) return NULL;
+    tile = new ActivityTile();
+    assert(tile != NULL);
+    tile->x = x;
+    tile->y = y;
+    tile->asleep = false;
+    tile->quietCycles = 0;
+    activityTiles[key] = tile;
+    awakeTiles.push_back(tile);
+    return tile;
+}
+
+
+// Wake tile.
+void Physics::wakeTile(ActivityTile *tile)
+{
+    tile->quietCycles = 0;
+    if (tile->asleep)
+    {
+        tile->asleep = false;
+        awakeTiles.push_back(tile);
+    }
+}
+
+
+// Release tiles.
+void Physics::clearTiles()
+{
+    std::unordered_map<long long, ActivityTile *>::iterator itr;
+    Particle *particle;
+
+    for (itr = activityTiles.begin(); itr != activityTiles.end(); itr++)
+    {
+        delete itr->second;
+    }
+    activityTiles.clear();
+    awakeTiles.clear();
+    tilePending.clear();
+    active.clear();
+    for (particle = particles; particle != NULL; particle = particle->next)
+    {
+        particle->tile = NULL;
+        particle->tileIndex = particle->activeIndex = -1;
+    }
+}
+
+
+// Load particles.
+void Physics::load(FILE *fp)
+{
+    int i,j,id1,id2,num;
+    Particle *particle1,*particle2,*tail;
+    Vector velocity;
+    char buf[50];
 
     // Read particles.
     fscanf(fp, "%d", &num);
     for (i = 0; i < num; i++)
     {
         particle1 = Particle::read(fp);
-        addParticle(particle1);
+        velocity = particle1->vVelocity;
+        addParticle(particle1, velocity);
+    }
+
+    // Restore the saved list order: particles are added at the head.
+    for (i = 0, particle1 = particles, particle2 = NULL; i < num; i++)
+    {
+        tail = particle1->next;
+        particle1->next = particle2;
+        particle2 = particle1;
+        particle1 = tail;
+    }
+    if (num > 0)
+    {
+        particles->next = particle1;
+        particles = particle2;
+    }
+    for (particle1 = particles, i = 0; particle1 != NULL;
+        particle1 = particle1->next, i++)
+    {
+        particle1->order = i;
     }
+    headOrder = 0;
 
     // Read bonds.
     for (i = 0; i < num; i++)
@@ -548,6 +1984,8 @@ void Physics::load(FILE *fp)
             }
         }
     }
+    bondEdgesValid = false;
+    buildMolecules();
 }
 
 
@@ -581,7 +2019,7 @@ void Physics::save(FILE *fp)
             }
             else
             {
-                fprintf(fp, "%d %f ", particle->bonds[i]->id,
+                fprintf(fp, "%d %.9g ", particle->bonds[i]->id,
                     particle->bondProperties[i]->getStrength());
             }
         }
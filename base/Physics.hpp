@@ -24,27 +24,82 @@
 
 #include <stdio.h>
 #include <assert.h>
+#include <vector>
+#include <unordered_map>
 #include "Parameters.h"
 #include "Particle.hpp"
+#include "Grid.hpp"
+#include "Profiler.hpp"
+#include "Kernels.hpp"
 #include "../util/Math_etc.h"
+#include "../util/Random.hpp"
 
 // Constants.
+// Those marked as parameters are the defaults of PhysicsParameters.
 #define DEFAULT_RADIUS 0.5f
 #define DEFAULT_MASS 1.0f
 #define DEFAULT_CHARGE 0.0f
-#define CHARGE_CONSTANT 1.0f
-#define DEFAULT_BOND_STRENGTH 0.1f
-#define MAX_BOND_LENGTH 5.0f
+#define CHARGE_CONSTANT 1.0f                     // parameter
+#define DEFAULT_BOND_STRENGTH 0.1f                // parameter
+#define MAX_BOND_LENGTH 5.0f                      // parameter
 #define COEFFICIENT_OF_RESTITUTION 1.0f
-#define MAX_VELOCITY 0.5f
-#define VISCOSITY_FRICTION 0.1f
-#define BROWNIAN_PROBABILITY 0.02f
-#define MAX_BROWNIAN_FORCE 0.05f
+#define MAX_VELOCITY 0.5f                         // parameter
+#define VISCOSITY_FRICTION 0.1f                   // parameter
+#define BROWNIAN_PROBABILITY 0.02f                // parameter
+#define MAX_BROWNIAN_FORCE 0.05f                  // parameter
 #define MAX_PARTICLES 5000
 
 // Quantized positioning.
 #define POSITION(x) ((float)((int)(x)) + 0.5f)
 
+// Tile sleeping.
+#define SLEEP_TILE_SHIFT 6                        // 64x64 cell tiles
+#define SLEEP_BROWNIAN_SPEED 1.5f                 // at rest below this many Brownian kicks
+#define SLEEP_CYCLES 10                           // quiet cycles before sleeping
+
+// Particle sleeping.
+#define PARTICLE_SLEEP_VELOCITY 0.005f            // at rest below this speed
+#define PARTICLE_SLEEP_CYCLES 3                   // cycles at rest before sleeping
+
+// Runtime physics parameters.
+class PhysicsParameters
+{
+    public:
+
+        float brownianProbability;
+        float maxBrownianForce;
+        float viscosityFriction;
+        float maxVelocity;
+        float maxBondLength;
+        float defaultBondStrength;
+        float chargeConstant;
+
+        // Constructor: default values.
+        PhysicsParameters();
+
+        // All default values?
+        bool isDefault();
+
+        // Set parameter by name: returns false if unknown.
+        bool set(const char *name, float value);
+
+        // Parameters by index.
+        static int getCount();
+        static const char *getName(int index);
+        float get(int index);
+};
+
+// World tile for sleeping.
+class ActivityTile
+{
+    public:
+
+        int x,y;                                  // tile coordinates
+        std::vector<Particle *> particles;
+        bool asleep;
+        int quietCycles;                          // consecutive quiet cycles
+};
+
 class Physics
 {
     public:
@@ -53,20 +108,128 @@ class Physics
         Particle *particles;
         int numParticles;
 
+        // Phase profiler (optional).
+        Profiler *profiler;
+
+        // Parameters.
+        PhysicsParameters parameters;
+
+        // Random numbers.
+        Random random;
+
+        // Next particle id and id increment: processes of a decomposed
+        // run draw ids from disjoint residue classes.
+        int idFactory;
+        int idStride;
+
+        // World size (cells) and particle limit.
+        int width;
+        int height;
+        int maxParticles;
+
+        // Spatial grid of particles.
+        Grid grid;
+
+        // Particles stepped this cycle when sleeping (NULL = removed).
+        std::vector<Particle *> active;
+
         // Constructor.
         Physics();
 
         // Destructor.
         ~Physics();
 
+        // Set world size.
+        void setSize(int width, int height);
+
+        // Periodic boundaries: the world wraps around at its edges and
+        // particles interact with the nearest image of each other.
+        // Disabled by default: particles are held inside the edges.
+        void setPeriodic(bool enable);
+        bool isPeriodic() { return periodic; }
+
+        // Image of position nearest to reference: the position itself
+        // unless boundaries are periodic.
+        Vector getImage(Vector &position, Vector &reference)
+        {
+            Vector image = position;
+
+            if (periodic)
+            {
+                if (image.x - reference.x > 0.5f * (float)width)
+                {
+                    image.x -= (float)width;
+                }
+                else if (reference.x - image.x > 0.5f * (float)width)
+                {
+                    image.x += (float)width;
+                }
+                if (image.y - reference.y > 0.5f * (float)height)
+                {
+                    image.y -= (float)height;
+                }
+                else if (reference.y - image.y > 0.5f * (float)height)
+                {
+                    image.y += (float)height;
+                }
+            }
+            return image;
+        }
+
+        // Wrap coordinate into 0..size.
+        static float wrap(float position, int size);
+
+        // Tile sleeping: tiles where all particles are in the quiescent
+        // state, at rest, uncharged and unbonded go to sleep and are not
+        // stepped until activity wakes them. At rest means moving no
+        // faster than Brownian motion alone would. Disabled by default.
+        void setSleep(bool enable, int quiescentState);
+        bool isSleepEnabled() { return sleepEnabled; }
+        int getQuiescentState() { return quiescentState; }
+
+        // Particle sleeping: unbonded particles at rest with no force
+        // and no recent collision are not integrated until a Brownian
+        // kick, collision, bond or reaction wakes them. Brownian kicks
+        // are sampled by geometric skip-ahead. Disabled by default.
+        void setParticleSleep(bool enable);
+        bool isParticleSleepEnabled() { return particleSleep; }
+
+        // Verlet neighbor lists: each particle lists the particles
+        // within its collision reach plus the skin distance, and each
+        // charged particle the charged particles within the charge
+        // cutoff plus the skin. Lists are rebuilt when particles are
+        // added or removed, or when one has moved more than half the
+        // skin since the last build; otherwise collisions and charge
+        // forces use the lists without querying the grid. A charge
+        // cutoff of zero keeps charge forces between all charged pairs.
+        // A skin of zero disables the lists (the default).
+        void setVerlet(float skin, float chargeCutoff);
+        float getVerletSkin() { return verletSkin; }
+        float getChargeCutoff() { return chargeCutoff; }
+        int getVerletBuilds() { return verletBuilds; }
+
+        // Vector kernels: particle motion and bond forces are gathered
+        // into arrays and computed by the kernels in Kernels.hpp, which
+        // use AVX2 when the processor supports it. Results are identical
+        // to the per particle code. Planar builds only; disabled by default.
+        void setVectorKernels(bool enable);
+        bool isVectorKernels() { return vectorKernels; }
+
+        // Wake particle and its tile.
+        void wake(Particle *particle);
+
+        // Tile counts.
+        int getNumTiles() { return (int)activityTiles.size(); }
+        int getNumAwakeTiles() { return (int)awakeTiles.size(); }
+
         // Create particle.
         Particle *createParticle(int type, float radius,
             float mass, float charge);
         Particle *createParticle(int type);
 
-        // Add particle.
+        // Add particle: assigns an id to a new particle.
         void addParticle(Particle *particle);
-        void addParticle(Particle *particle, Vector3D &velocity);
+        void addParticle(Particle *particle, Vector &velocity);
 
         // Remove particle.
         void removeParticle(Particle *particle);
@@ -84,6 +247,33 @@ class Physics
         void removeBond(Particle *particle1, int direction);
         void removeBond(Particle *particle1, Particle *particle2);
 
+        // Set type and state of particle in system, keeping the
+        // species counts.
+        void setType(Particle *particle, int type);
+        void setState(Particle *particle, int state);
+
+        // Number of particles of a type in a state.
+        int getSpeciesCount(int type, int state)
+        {
+            if (type < 0 || type >= (int)speciesCounts.size()) return 0;
+            if (state < 0 || state >= (int)speciesCounts[type].size()) return 0;
+            return speciesCounts[type][state];
+        }
+
+        // Molecules: sets of particles connected by bonds. Molecule ids
+        // are reused once a molecule is gone.
+        int getMolecule(Particle *particle) { return particle->molecule; }
+        int getMoleculeSize(int molecule) { return moleculeSizes[molecule]; }
+        int getMoleculeSize(Particle *particle) { return moleculeSizes[particle->molecule]; }
+        int getNumMolecules() { return numMolecules; }
+
+        // Number of molecules of a size.
+        int getMoleculeCount(int size)
+        {
+            if (size < 0 || size >= (int)moleculeCounts.size()) return 0;
+            return moleculeCounts[size];
+        }
+
         // Step system by given time increment.
         void step(float dtime);
 
@@ -91,8 +281,76 @@ class Physics
         void load(FILE *fp);
         void save(FILE *fp);
 
+        // Step phases, public for benchmarking.
+
+        // Update charge forces.
+        void updateChargeForces();
+
+        // Break overstretched bonds and update bond forces.
+        void updateBonds();
+
+        // Detect collisions between particles.
+        void detectCollisions();
+
+        // Check for particle collisions.
+        void checkCollisions(Particle *particle);
+
+        // Resolve collisions.
+        void resolveCollisions();
+
+        // Release collisions.
+        void releaseCollisions();
+
+        // Bring grid up to date with particle positions.
+        void updateGrid();
+
+        // Force a grid and neighbor list rebuild: call after moving
+        // particles outside of step.
+        void invalidateGrid() { gridValid = false; verletValid = false; }
+
+        // Rebuild Verlet lists if out of date.
+        void updateVerlet();
+
+        // Particles in cells x1..x2, y1..y2, in particle list order.
+        void getGridParticles(int x1, int y1, int x2, int y2,
+            std::vector<Particle *> &result);
+
     private:
 
+        // Step and charge forces with parameter policy: default
+        // parameters are compile-time constants, others are read at run time.
+        template <class P> void step(float dtime, const P &p);
+        template <class P> void updateChargeForces(const P &p);
+
+        // Per particle step phases.
+        template <class P> void integrate(Particle *particle,
+            float dtime, const P &p);
+        template <class P> bool beginIntegrate(Particle *particle, const P &p);
+        void endIntegrate(Particle *particle);
+        template <class P> bool brownianKick(const P &p);
+        template <class P> void updateBonds(const P &p);
+
+        // Bond edge list: an entry for each bond direction of each particle,
+        // in step order. Forces are applied and stretched bonds broken in
+        // one pass over the list. The list is rebuilt when bonds or
+        // particles change, and every step with tile sleeping, which
+        // steps only the particles of awake tiles.
+        class BondEdge
+        {
+            public:
+
+                Particle *particle1;              // bonding particle
+                Particle *particle2;              // partner
+                int direction;                    // bond direction of particle1
+                Bond *bond;
+        };
+        std::vector<BondEdge> bondEdges;
+        bool bondEdgesValid;
+
+        // Build bond edge list.
+        void buildBondEdges();
+        void addBondEdges(Particle *particle);
+
         // Particle collisions.
         class Collision
         {
@@ -100,9 +358,9 @@ class Physics
 
                 Particle *particle1;
                 Particle *particle2;
-                Vector3D vCollisionNormal;
-                Vector3D vCollisionPoint;
-                Vector3D vRelativeVelocity;
+                Vector vCollisionNormal;
+                Vector vCollisionPoint;
+                Vector vRelativeVelocity;
                 Collision *next;
 
                 Collision()
@@ -113,16 +371,139 @@ class Physics
         };
         Collision *collisions;
 
-        // Check for particle collisions.
-        void checkCollisions(Particle *particle);
+        // Vector kernel state: planar motion and bond forces are gathered
+        // into arrays in blocks and scattered back.
+        bool vectorKernels;
+        MotionArrays motion;
+        std::vector<Particle *> moving;
+        BondArrays bondArrays;
 
-        // Resolve collisions.
-        void resolveCollisions();
+        // Integrate particles through the motion kernel.
+        template <class P> void integrateKernel(float dtime, const P &p);
+        void gatherMotion(Particle *particle, int &n);
+        void integrateBlock(MotionParameters &parameters, int &n);
 
-        // Update charge forces.
-        void updateChargeForces();
+        // Bonds through the bond kernel.
+        void updateBondsKernel(float maxBondLength);
+        void applyBondBlock(int start, int n);
+
+        // Rotational term of the collision impulse:
+        // normal . ((inverse inertia * (point x normal)) x point).
+        float getRotationalTerm(Particle *particle, Vector &point, Vector &normal);
+
+        // Periodic boundaries.
+        bool periodic;
+
+        // Verlet list state: lists are spans of a shared array, indexed
+        // by each particle's list index.
+        float verletSkin;
+        float chargeCutoff;
+        bool verletValid;
+        bool verletMoved;                         // particles stepped since check
+        int verletBuilds;
+        std::vector<Particle *> verletParticles;
+        std::vector<int> verletStart;
+        std::vector<Particle *> verletList;
+        std::vector<int> chargeStart;
+        std::vector<Particle *> chargeList;
+
+        // Build Verlet lists.
+        void buildVerlet();
+
+        // Grid state: particles added since the last rebuild are
+        // pending until the next query. List order of new particles
+        // precedes all others.
+        bool gridValid;
+        std::vector<Particle *> gridPending;
+        int headOrder;
+        float maxRadius;
+        std::vector<Particle *> candidates;
+        std::vector<Particle *> charged;
+
+        // Tile sleeping state.
+        bool sleepEnabled;
+        int quiescentState;
+        std::unordered_map<long long, ActivityTile *> activityTiles;
+        std::vector<ActivityTile *> awakeTiles;
+        std::vector<Particle *> tilePending;
+
+        // Gather particles of awake tiles.
+        void gatherActive();
+
+        // Move stepped particles to their new cells and tiles.
+        void updateTiles();
+
+        // Put quiet tiles to sleep and wake neighbors of busy tiles.
+        void updateSleep();
+
+        // Is particle quiescent?
+        bool isQuiescent(Particle *particle, float restSpeed);
+
+        // Add and remove particle from its tile.
+        void placeParticle(Particle *particle);
+        void unplaceParticle(Particle *particle);
+
+        // Get tile, optionally creating it.
+        ActivityTile *getActivityTile(int x, int y, bool create);
+
+        // Wake tile.
+        void wakeTile(ActivityTile *tile);
+
+        // Release tiles.
+        void clearTiles();
+
+        // Particle sleeping state: particles to pass before the next
+        // Brownian kick (-1 = not sampled).
+        bool particleSleep;
+        int brownianSkip;
+
+        // Sample the number of particles before the next Brownian kick.
+        int sampleBrownianSkip(float probability);
+
+        // Molecule tracking: union by size when a bond joins two
+        // molecules, relabeling the smaller; when a bond is removed, a
+        // traversal from both ends, one particle at a time from each,
+        // stops when the ends meet or when the smaller side is found
+        // whole, which then becomes a new molecule.
+        std::vector<int> moleculeSizes;           // size by id (0 = unused)
+        std::vector<int> moleculeCounts;          // number by size
+        std::vector<int> freeMolecules;
+        int numMolecules;
+        int moleculeMark;
+        std::vector<Particle *> moleculeQueues[2];
+
+        // New molecule of given size.
+        int newMolecule(int size);
+
+        // Release molecule.
+        void freeMolecule(int molecule);
+
+        // Set molecule size.
+        void setMoleculeSize(int molecule, int size);
+
+        // Join molecules of newly bonded particles.
+        void joinMolecules(Particle *particle1, Particle *particle2);
+
+        // Split molecule of particles whose bond was removed.
+        void splitMolecule(Particle *particle1, Particle *particle2);
+
+        // Relabel particles of a molecule reachable from particle.
+        void labelMolecule(Particle *particle, int from, int to);
+
+        // Build molecules from bonds.
+        void buildMolecules();
+
+        // Next traversal mark.
+        int nextMoleculeMark();
+
+        // Particle counts by type and state.
+        std::vector<std::vector<int> > speciesCounts;
+
+        // Add count to the species of particle.
+        void countSpecies(Particle *particle, int count);
 
-        // Update bond forces.
-        void updateBondForces();
+        // Brownian kick tests of the step, drawn in one batch.
+        std::vector<float> kickDraws;
+        int kickNext;
 };
 #endif
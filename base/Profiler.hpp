@@ -0,0 +1,66 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Simulation phase profiling interface.
+ * Physics and chemistry bracket each phase of a step with
+ * beginPhase/endPhase calls on an optional profiler.
+ * Phases may nest: apply occurs within match.
+ * Named events mark other spans of interest, such as whole steps,
+ * checkpoints and display frames; profilers may ignore them.
+ */
+
+#ifndef __PROFILER__
+#define __PROFILER__
+
+// Phases.
+#define PHASE_INTEGRATE 0
+#define PHASE_CHARGE_FORCES 1
+#define PHASE_BOND_FORCES 2
+#define PHASE_COLLISIONS 3
+#define PHASE_NEIGHBORHOOD 4
+#define PHASE_MATCH 5
+#define PHASE_APPLY 6
+#define NUM_PHASES 7
+
+// Phase names.
+static const char *PhaseNames[NUM_PHASES] =
+{
+    "integrate",
+    "charge_forces",
+    "bond_forces",
+    "collisions",
+    "neighborhood",
+    "match",
+    "apply"
+};
+
+class Profiler
+{
+    public:
+
+        // Destructor.
+        virtual ~Profiler() {}
+
+        // Begin and end phase.
+        virtual void beginPhase(int phase) = 0;
+        virtual void endPhase(int phase) = 0;
+
+        // Begin and end named event.
+        virtual void beginEvent(const char *name) {}
+        virtual void endEvent(const char *name) {}
+};
+#endif
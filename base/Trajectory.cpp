@@ -0,0 +1,679 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Trajectory stream.
+ */
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "Trajectory.hpp"
+
+// File identification.
+#define TRAJECTORY_MAGIC "RTRJ"
+#define TRAJECTORY_INDEX_MAGIC "RIDX"
+#define TRAJECTORY_VERSION 1
+#define TRAJECTORY_FOOTER_SIZE 16
+
+// Compression parameters.
+#define HASH_BITS 12
+#define MIN_MATCH 4
+#define MAX_MATCH (MIN_MATCH + 127)
+#define MAX_LITERALS 128
+#define MAX_OFFSET 65535
+
+// Encoding helpers.
+static void putVarint(std::vector<unsigned char> &buf, unsigned int v)
+{
+    while (v >= 0x80)
+    {
+        buf.push_back((unsigned char)(v | 0x80));
+        v >>= 7;
+    }
+    buf.push_back((unsigned char)v);
+}
+
+
+static void putSigned(std::vector<unsigned char> &buf, int v)
+{
+    putVarint(buf, ((unsigned int)v << 1) ^ (unsigned int)(v >> 31));
+}
+
+
+static bool getVarint(std::vector<unsigned char> &buf, int &pos, unsigned int &v)
+{
+    int shift = 0;
+    unsigned int b;
+
+    v = 0;
+    do
+    {
+        if (pos >= (int)buf.size() || shift > 28) return false;
+        b = buf[pos++];
+        v |= (b & 0x7f) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return true;
+}
+
+
+static bool getSigned(std::vector<unsigned char> &buf, int &pos, int &v)
+{
+    unsigned int u;
+
+    if (!getVarint(buf, pos, u)) return false;
+    v = (int)(u >> 1) ^ -(int)(u & 1);
+    return true;
+}
+
+
+static void writeInt(FILE *fp, unsigned int v)
+{
+    unsigned char b[4];
+
+    b[0] = (unsigned char)v;
+    b[1] = (unsigned char)(v >> 8);
+    b[2] = (unsigned char)(v >> 16);
+    b[3] = (unsigned char)(v >> 24);
+    fwrite(b, 1, 4, fp);
+}
+
+
+static void writeLong(FILE *fp, long long v)
+{
+    writeInt(fp, (unsigned int)v);
+    writeInt(fp, (unsigned int)((unsigned long long)v >> 32));
+}
+
+
+static bool readInt(FILE *fp, unsigned int &v)
+{
+    unsigned char b[4];
+
+    if (fread(b, 1, 4, fp) != 4) return false;
+    v = (unsigned int)b[0] | ((unsigned int)b[1] << 8) |
+        ((unsigned int)b[2] << 16) | ((unsigned int)b[3] << 24);
+    return true;
+}
+
+
+static bool readLong(FILE *fp, long long &v)
+{
+    unsigned int lo,hi;
+
+    if (!readInt(fp, lo) || !readInt(fp, hi)) return false;
+    v = (long long)(((unsigned long long)hi << 32) | lo);
+    return true;
+}
+
+
+// Particle id ordering.
+static bool idLess(Particle *particle1, Particle *particle2)
+{
+    return particle1->id < particle2->id;
+}
+
+
+// Clear frame.
+void TrajectoryFrame::clear()
+{
+    cycle = 0;
+    keyFrame = false;
+    ids.clear();
+    types.clear();
+    states.clear();
+    orientations.clear();
+    x.clear();
+    y.clear();
+    bonds.clear();
+}
+
+
+// Load frame from physics.
+void TrajectoryFrame::load(int cycle, Physics *physics)
+{
+    int i,j,n;
+    Particle *particle;
+    std::vector<Particle *> sorted;
+
+    clear();
+    this->cycle = cycle;
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        sorted.push_back(particle);
+    }
+    std::sort(sorted.begin(), sorted.end(), idLess);
+    n = (int)sorted.size();
+    ids.resize(n);
+    types.resize(n);
+    states.resize(n);
+    orientations.resize(n);
+    x.resize(n);
+    y.resize(n);
+    bonds.resize(n * 8);
+    for (i = 0; i < n; i++)
+    {
+        particle = sorted[i];
+        ids[i] = particle->id;
+        types[i] = particle->type;
+        states[i] = particle->state;
+        orientations[i] = particle->orientation.direction |
+            (particle->orientation.mirrored ? 8 : 0);
+        x[i] = (int)floor(particle->vPosition.x * (float)TRAJECTORY_QUANTUM + 0.5f);
+        y[i] = (int)floor(particle->vPosition.y * (float)TRAJECTORY_QUANTUM + 0.5f);
+        for (j = 0; j < 8; j++)
+        {
+            if (particle->bonds[j] != NULL)
+            {
+                bonds[(i * 8) + j] = particle->bonds[j]->id;
+            }
+            else
+            {
+                bonds[(i * 8) + j] = -1;
+            }
+        }
+    }
+}
+
+
+// Encode frame against previous frame.
+static void encodeFrame(TrajectoryFrame *frame, TrajectoryFrame *previous,
+std::vector<unsigned char> &buf)
+{
+    int i,j,k,n,mask,lastId;
+
+    buf.clear();
+    putVarint(buf, (unsigned int)frame->cycle);
+    buf.push_back(frame->keyFrame ? 1 : 0);
+    n = (int)frame->ids.size();
+    putVarint(buf, (unsigned int)n);
+    lastId = -1;
+    for (i = k = 0; i < n; i++)
+    {
+        putSigned(buf, frame->ids[i] - lastId);
+        lastId = frame->ids[i];
+        putSigned(buf, frame->types[i]);
+        putSigned(buf, frame->states[i]);
+        putVarint(buf, (unsigned int)frame->orientations[i]);
+
+        // Delta against same particle in previous frame.
+        if (!frame->keyFrame)
+        {
+            while (k < (int)previous->ids.size() && previous->ids[k] < frame->ids[i]) k++;
+        }
+        if (!frame->keyFrame && k < (int)previous->ids.size() &&
+            previous->ids[k] == frame->ids[i])
+        {
+            putSigned(buf, frame->x[i] - previous->x[k]);
+            putSigned(buf, frame->y[i] - previous->y[k]);
+        }
+        else
+        {
+            putSigned(buf, frame->x[i]);
+            putSigned(buf, frame->y[i]);
+        }
+
+        // Bonds.
+        for (j = mask = 0; j < 8; j++)
+        {
+            if (frame->bonds[(i * 8) + j] != -1) mask |= (1 << j);
+        }
+        buf.push_back((unsigned char)mask);
+        for (j = 0; j < 8; j++)
+        {
+            if (mask & (1 << j))
+            {
+                putSigned(buf, frame->bonds[(i * 8) + j] - frame->ids[i]);
+            }
+        }
+    }
+}
+
+
+// Decode frame against previous frame.
+static bool decodeFrame(std::vector<unsigned char> &buf,
+TrajectoryFrame *previous, TrajectoryFrame *frame)
+{
+    int i,j,k,n,pos,v,lastId;
+    unsigned int u;
+
+    frame->clear();
+    pos = 0;
+    if (!getVarint(buf, pos, u)) return false;
+    frame->cycle = (int)u;
+    if (pos >= (int)buf.size()) return false;
+    frame->keyFrame = (buf[pos++] == 1);
+    if (!getVarint(buf, pos, u)) return false;
+    n = (int)u;
+    frame->ids.resize(n);
+    frame->types.resize(n);
+    frame->states.resize(n);
+    frame->orientations.resize(n);
+    frame->x.resize(n);
+    frame->y.resize(n);
+    frame->bonds.resize(n * 8);
+    lastId = -1;
+    for (i = k = 0; i < n; i++)
+    {
+        if (!getSigned(buf, pos, v)) return false;
+        frame->ids[i] = lastId = lastId + v;
+        if (!getSigned(buf, pos, frame->types[i])) return false;
+        if (!getSigned(buf, pos, frame->states[i])) return false;
+        if (!getVarint(buf, pos, u)) return false;
+        frame->orientations[i] = (int)u;
+        if (!getSigned(buf, pos, frame->x[i])) return false;
+        if (!getSigned(buf, pos, frame->y[i])) return false;
+        if (!frame->keyFrame)
+        {
+            while (k < (int)previous->ids.size() && previous->ids[k] < frame->ids[i]) k++;
+            if (k < (int)previous->ids.size() && previous->ids[k] == frame->ids[i])
+            {
+                frame->x[i] += previous->x[k];
+                frame->y[i] += previous->y[k];
+            }
+        }
+        if (pos >= (int)buf.size()) return false;
+        int mask = buf[pos++];
+        for (j = 0; j < 8; j++)
+        {
+            if (mask & (1 << j))
+            {
+                if (!getSigned(buf, pos, v)) return false;
+                frame->bonds[(i * 8) + j] = frame->ids[i] + v;
+            }
+            else
+            {
+                frame->bonds[(i * 8) + j] = -1;
+            }
+        }
+    }
+    return true;
+}
+
+
+// Writer constructor.
+TrajectoryWriter::TrajectoryWriter()
+{
+    profiler = NULL;
+    fp = NULL;
+    interval = 1;
+    done = false;
+    writer = NULL;
+    frameCount = 0;
+}
+
+
+// Writer destructor.
+TrajectoryWriter::~TrajectoryWriter()
+{
+    close();
+}
+
+
+// Open trajectory file.
+bool TrajectoryWriter::open(char *fileName, int interval)
+{
+    close();
+    if ((fp = fopen(fileName, "wb")) == NULL) return false;
+    if (interval < 1) interval = 1;
+    this->interval = interval;
+    fwrite(TRAJECTORY_MAGIC, 1, 4, fp);
+    writeInt(fp, TRAJECTORY_VERSION);
+    writeInt(fp, TRAJECTORY_QUANTUM);
+    writeInt(fp, (unsigned int)interval);
+    previous.clear();
+    frameCount = 0;
+    offsets.clear();
+    cycles.clear();
+    keys.clear();
+    done = false;
+    writer = new std::thread(&TrajectoryWriter::run, this);
+    assert(writer != NULL);
+    return true;
+}
+
+
+// Record frame.
+void TrajectoryWriter::record(int cycle, Physics *physics)
+{
+    TrajectoryFrame *frame;
+
+    if (fp == NULL || (cycle % interval) != 0) return;
+    if (profiler != NULL) profiler->beginEvent("trajectory_record");
+    frame = new TrajectoryFrame();
+    assert(frame != NULL);
+    frame->load(cycle, physics);
+
+    std::unique_lock<std::mutex> lock(queueLock);
+    while ((int)queue.size() >= TRAJECTORY_MAX_QUEUE)
+    {
+        queueSignal.wait(lock);
+    }
+    queue.push_back(frame);
+    queueSignal.notify_all();
+    lock.unlock();
+    if (profiler != NULL) profiler->endEvent("trajectory_record");
+}
+
+
+// Flush frames and write index footer.
+void TrajectoryWriter::close()
+{
+    int i;
+    long long indexOffset;
+
+    if (fp == NULL) return;
+    {
+        std::unique_lock<std::mutex> lock(queueLock);
+        done = true;
+        queueSignal.notify_all();
+    }
+    writer->join();
+    delete writer;
+    writer = NULL;
+
+    // Write index and footer.
+    fflush(fp);
+    indexOffset = (long long)ftell(fp);
+    for (i = 0; i < frameCount; i++)
+    {
+        writeLong(fp, offsets[i]);
+        writeInt(fp, (unsigned int)cycles[i]);
+        fputc(keys[i], fp);
+    }
+    writeLong(fp, indexOffset);
+    writeInt(fp, (unsigned int)frameCount);
+    fwrite(TRAJECTORY_INDEX_MAGIC, 1, 4, fp);
+    fclose(fp);
+    fp = NULL;
+}
+
+
+// Writer thread.
+void TrajectoryWriter::run()
+{
+    TrajectoryFrame *frame;
+
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(queueLock);
+            while (queue.empty() && !done)
+            {
+                queueSignal.wait(lock);
+            }
+            if (queue.empty()) return;
+            frame = queue.front();
+            queue.pop_front();
+            queueSignal.notify_all();
+        }
+        if (profiler != NULL) profiler->beginEvent("trajectory_write");
+        write(frame);
+        if (profiler != NULL) profiler->endEvent("trajectory_write");
+        delete frame;
+    }
+}
+
+
+// Encode and write a frame.
+void TrajectoryWriter::write(TrajectoryFrame *frame)
+{
+    frame->keyFrame = ((frameCount % TRAJECTORY_KEY_INTERVAL) == 0);
+    encodeFrame(frame, &previous, raw);
+    TrajectoryCompressor::compress(raw, compressed);
+    offsets.push_back((long long)ftell(fp));
+    cycles.push_back(frame->cycle);
+    keys.push_back(frame->keyFrame ? 1 : 0);
+    writeInt(fp, (unsigned int)compressed.size());
+    writeInt(fp, (unsigned int)raw.size());
+    if (compressed.size() > 0)
+    {
+        fwrite(&compressed[0], 1, compressed.size(), fp);
+    }
+    frameCount++;
+
+    // Keep frame for next delta.
+    previous.cycle = frame->cycle;
+    previous.ids.swap(frame->ids);
+    previous.x.swap(frame->x);
+    previous.y.swap(frame->y);
+}
+
+
+// Reader constructor.
+TrajectoryReader::TrajectoryReader()
+{
+    fp = NULL;
+    interval = 1;
+    currentIndex = -1;
+}
+
+
+// Reader destructor.
+TrajectoryReader::~TrajectoryReader()
+{
+    close();
+}
+
+
+// Open trajectory file.
+bool TrajectoryReader::open(char *fileName)
+{
+    int i;
+    unsigned int version,quantum,num,cycle;
+    long long indexOffset,offset;
+    char magic[4];
+
+    close();
+    if ((fp = fopen(fileName, "rb")) == NULL) return false;
+    if (fread(magic, 1, 4, fp) != 4 ||
+        strncmp(magic, TRAJECTORY_MAGIC, 4) != 0 ||
+        !readInt(fp, version) || version != TRAJECTORY_VERSION ||
+        !readInt(fp, quantum) || quantum != TRAJECTORY_QUANTUM ||
+        !readInt(fp, num))
+    {
+        close();
+        return false;
+    }
+    interval = (int)num;
+
+    // Read footer and index.
+    if (fseek(fp, -TRAJECTORY_FOOTER_SIZE, SEEK_END) != 0 ||
+        !readLong(fp, indexOffset) || !readInt(fp, num) ||
+        fread(magic, 1, 4, fp) != 4 ||
+        strncmp(magic, TRAJECTORY_INDEX_MAGIC, 4) != 0 ||
+        fseek(fp, (long)indexOffset, SEEK_SET) != 0)
+    {
+        close();
+        return false;
+    }
+    for (i = 0; i < (int)num; i++)
+    {
+        if (!readLong(fp, offset) || !readInt(fp, cycle))
+        {
+            close();
+            return false;
+        }
+        offsets.push_back(offset);
+        cycles.push_back((int)cycle);
+        keys.push_back((unsigned char)fgetc(fp));
+    }
+    return true;
+}
+
+
+// Close.
+void TrajectoryReader::close()
+{
+    if (fp != NULL)
+    {
+        fclose(fp);
+        fp = NULL;
+    }
+    offsets.clear();
+    cycles.clear();
+    keys.clear();
+    current.clear();
+    currentIndex = -1;
+}
+
+
+// Read frame by index.
+bool TrajectoryReader::read(int frameIndex, TrajectoryFrame &frame)
+{
+    int i;
+
+    if (fp == NULL || frameIndex < 0 || frameIndex >= getNumFrames()) return false;
+
+    // Decode forward from the nearest key frame or the current frame.
+    for (i = frameIndex; i > 0 && keys[i] == 0; i--) {}
+    if (currentIndex >= i && currentIndex <= frameIndex) i = currentIndex + 1;
+    for (; i <= frameIndex; i++)
+    {
+        if (!decode(i))
+        {
+            currentIndex = -1;
+            return false;
+        }
+    }
+    frame = current;
+    return true;
+}
+
+
+// Decode frame at index against current frame.
+bool TrajectoryReader::decode(int frameIndex)
+{
+    unsigned int size,rawSize;
+    TrajectoryFrame previous;
+
+    if (fseek(fp, (long)offsets[frameIndex], SEEK_SET) != 0 ||
+        !readInt(fp, size) || !readInt(fp, rawSize))
+    {
+        return false;
+    }
+    compressed.resize(size);
+    if (size > 0 && fread(&compressed[0], 1, size, fp) != size) return false;
+    if (!TrajectoryCompressor::decompress(size > 0 ? &compressed[0] : NULL,
+        (int)size, raw, (int)rawSize))
+    {
+        return false;
+    }
+    previous.ids.swap(current.ids);
+    previous.x.swap(current.x);
+    previous.y.swap(current.y);
+    if (!decodeFrame(raw, &previous, &current)) return false;
+    currentIndex = frameIndex;
+    return true;
+}
+
+
+// Compress input to output.
+// Byte-oriented LZ77: a control byte below 0x80 introduces a run of
+// (control + 1) literal bytes; otherwise it is a match of
+// (control - 0x80 + MIN_MATCH) bytes at a 16-bit backward offset.
+void TrajectoryCompressor::compress(std::vector<unsigned char> &input,
+std::vector<unsigned char> &output)
+{
+    int n,pos,literal,candidate,len,offset,count,h;
+    unsigned int v;
+    std::vector<int> table(1 << HASH_BITS, -1);
+
+    output.clear();
+    n = (int)input.size();
+    pos = literal = 0;
+    while (pos + MIN_MATCH <= n)
+    {
+        memcpy(&v, &input[pos], 4);
+        h = (int)((v * 2654435761u) >> (32 - HASH_BITS));
+        candidate = table[h];
+        table[h] = pos;
+        if (candidate >= 0 && (pos - candidate) <= MAX_OFFSET &&
+            memcmp(&input[candidate], &input[pos], MIN_MATCH) == 0)
+        {
+            for (len = MIN_MATCH; pos + len < n && len < MAX_MATCH &&
+                input[candidate + len] == input[pos + len]; len++) {}
+
+            // Flush literals.
+            for (; literal < pos; literal += count)
+            {
+                count = pos - literal;
+                if (count > MAX_LITERALS) count = MAX_LITERALS;
+                output.push_back((unsigned char)(count - 1));
+                output.insert(output.end(), input.begin() + literal,
+                    input.begin() + literal + count);
+            }
+
+            offset = pos - candidate;
+            output.push_back((unsigned char)(0x80 | (len - MIN_MATCH)));
+            output.push_back((unsigned char)offset);
+            output.push_back((unsigned char)(offset >> 8));
+            pos += len;
+            literal = pos;
+        }
+        else
+        {
+            pos++;
+        }
+    }
+    for (; literal < n; literal += count)
+    {
+        count = n - literal;
+        if (count > MAX_LITERALS) count = MAX_LITERALS;
+        output.push_back((unsigned char)(count - 1));
+        output.insert(output.end(), input.begin() + literal,
+            input.begin() + literal + count);
+    }
+}
+
+
+// Decompress input to output of given size.
+bool TrajectoryCompressor::decompress(unsigned char *input, int inputSize,
+std::vector<unsigned char> &output, int outputSize)
+{
+    int pos,out,len,offset,control;
+
+    output.resize(outputSize);
+    for (pos = out = 0; pos < inputSize; )
+    {
+        control = input[pos++];
+        if (control < 0x80)
+        {
+            len = control + 1;
+            if (pos + len > inputSize || out + len > outputSize) return false;
+            memcpy(&output[out], &input[pos], len);
+            pos += len;
+            out += len;
+        }
+        else
+        {
+            if (pos + 2 > inputSize) return false;
+            len = (control - 0x80) + MIN_MATCH;
+            offset = input[pos] | (input[pos + 1] << 8);
+            pos += 2;
+            if (offset == 0 || offset > out || out + len > outputSize) return false;
+
+            // Byte copy: source may overlap destination.
+            for (; len > 0; len--, out++)
+            {
+                output[out] = output[out - offset];
+            }
+        }
+    }
+    return out == outputSize;
+}
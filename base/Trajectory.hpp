@@ -0,0 +1,195 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Trajectory stream.
+ * Records particle positions, types, states and bonds every given
+ * number of cycles. Positions are quantized and delta-encoded against
+ * the previous frame, and each frame is compressed. Frames are written
+ * by a background thread. An index footer allows a reader to seek
+ * to any frame.
+ *
+ * File layout:
+ *   header: magic, version, quantum, interval
+ *   frames: compressed size, raw size, compressed bytes
+ *   index:  per frame: file offset, cycle, key frame flag
+ *   footer: index offset, number of frames, magic
+ */
+
+#ifndef __TRAJECTORY__
+#define __TRAJECTORY__
+
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "Physics.hpp"
+#include "Profiler.hpp"
+
+// Position quantization (units per cell).
+#define TRAJECTORY_QUANTUM 1024
+
+// Key frame interval (frames).
+#define TRAJECTORY_KEY_INTERVAL 64
+
+// Maximum frames queued for the writer thread.
+#define TRAJECTORY_MAX_QUEUE 16
+
+// Trajectory frame.
+class TrajectoryFrame
+{
+    public:
+
+        int cycle;
+        bool keyFrame;
+
+        // Per particle, sorted by id.
+        std::vector<int> ids;
+        std::vector<int> types;
+        std::vector<int> states;
+        std::vector<int> orientations;            // direction | (mirrored << 3)
+        std::vector<int> x;                       // quantized position
+        std::vector<int> y;
+
+        // Bond partner ids, 8 per particle (-1 = none).
+        std::vector<int> bonds;
+
+        // Clear frame.
+        void clear();
+
+        // Load from physics.
+        void load(int cycle, Physics *physics);
+
+        // Position in cell units.
+        float getX(int index) { return (float)x[index] / (float)TRAJECTORY_QUANTUM; }
+        float getY(int index) { return (float)y[index] / (float)TRAJECTORY_QUANTUM; }
+};
+
+// Trajectory writer.
+class TrajectoryWriter
+{
+    public:
+
+        // Event profiler (NULL for none); called from the writer thread too.
+        Profiler *profiler;
+
+        // Constructor.
+        TrajectoryWriter();
+
+        // Destructor.
+        ~TrajectoryWriter();
+
+        // Open trajectory file: record every interval cycles.
+        bool open(char *fileName, int interval);
+
+        // Record frame if cycle is on the interval.
+        void record(int cycle, Physics *physics);
+
+        // Flush frames and write index footer.
+        void close();
+
+    private:
+
+        FILE *fp;
+        int interval;
+
+        // Frame queue.
+        std::deque<TrajectoryFrame *> queue;
+        std::mutex queueLock;
+        std::condition_variable queueSignal;
+        bool done;
+        std::thread *writer;
+
+        // Writer thread state.
+        TrajectoryFrame previous;
+        int frameCount;
+        std::vector<long long> offsets;
+        std::vector<int> cycles;
+        std::vector<unsigned char> keys;
+        std::vector<unsigned char> raw;
+        std::vector<unsigned char> compressed;
+
+        // Writer thread.
+        void run();
+
+        // Encode and write a frame.
+        void write(TrajectoryFrame *frame);
+};
+
+// Trajectory reader.
+class TrajectoryReader
+{
+    public:
+
+        // Constructor.
+        TrajectoryReader();
+
+        // Destructor.
+        ~TrajectoryReader();
+
+        // Open trajectory file.
+        bool open(char *fileName);
+
+        // Close.
+        void close();
+
+        // Number of frames.
+        int getNumFrames() { return (int)offsets.size(); }
+
+        // Cycle of frame.
+        int getCycle(int frameIndex) { return cycles[frameIndex]; }
+
+        // Recording interval.
+        int getInterval() { return interval; }
+
+        // Read frame by index.
+        bool read(int frameIndex, TrajectoryFrame &frame);
+
+    private:
+
+        FILE *fp;
+        int interval;
+        std::vector<long long> offsets;
+        std::vector<int> cycles;
+        std::vector<unsigned char> keys;
+
+        // Last decoded frame (for sequential reading).
+        TrajectoryFrame current;
+        int currentIndex;
+
+        std::vector<unsigned char> raw;
+        std::vector<unsigned char> compressed;
+
+        // Decode frame at index against current frame.
+        bool decode(int frameIndex);
+};
+
+// Byte stream compression.
+class TrajectoryCompressor
+{
+    public:
+
+        // Compress input to output.
+        static void compress(std::vector<unsigned char> &input,
+            std::vector<unsigned char> &output);
+
+        // Decompress input to output of given size.
+        static bool decompress(unsigned char *input, int inputSize,
+            std::vector<unsigned char> &output, int outputSize);
+};
+#endif
@@ -0,0 +1,921 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/**
+ * Physics and chemistry kernel microbenchmarks.
+ *
+ * Each hot routine is run in isolation over synthetic particle
+ * populations of increasing size at several densities, and the
+ * time per particle is reported. Sizes whose projected run time
+ * exceeds the time budget are skipped.
+ *
+ * With -checkKernels, the AVX2 vector kernels are instead checked
+ * against their scalar versions over random inputs.
+ *
+ * With -checkTrajectory, a trajectory of a changing population is
+ * written and read back in seek order, and each frame is checked
+ * against the physics it was recorded from.
+ *
+ * Usage:
+ * Microbenchmark
+ *    [-routine <routine name> (default: all)]
+ *    [-minParticles <smallest population>]
+ *    [-maxParticles <largest population>]
+ *    [-budget <seconds per measurement>]
+ *    [-output <CSV file name>]
+ *    [-checkKernels (check vector kernels against scalar)]
+ *    [-checkTrajectory (check trajectory seek and read back)]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "../base/Physics.hpp"
+#include "../base/Kernels.hpp"
+#include "../base/Trajectory.hpp"
+#include "../chemistry/Chemistry.hpp"
+#include "../util/Random.hpp"
+#include "../util/Benchmark.hpp"
+#include "../util/Log.hpp"
+
+// Usage.
+const char *Usage = "Microbenchmark\n\t[-routine <routine name> (default: all)]\n\t[-minParticles <smallest population>]\n\t[-maxParticles <largest population>]\n\t[-budget <seconds per measurement>]\n\t[-output <CSV file name>]\n\t[-checkKernels (check vector kernels against scalar)]\n\t[-checkTrajectory (check trajectory seek and read back)]";
+
+// Population parameters.
+#define DEFAULT_MIN_PARTICLES 1000
+#define DEFAULT_MAX_PARTICLES 1000000
+#define NUM_SIZES 6
+int Sizes[NUM_SIZES] = { 1000, 4000, 16000, 64000, 250000, 1000000 };
+#define NUM_DENSITIES 3
+float Densities[NUM_DENSITIES] = { 0.05f, 0.25f, 1.0f };
+#define NUM_TYPES 9
+#define NUM_STATES 4
+#define CHAIN_LENGTH 4
+#define NUM_REACTIONS 62
+#define MAX_SAMPLES 256
+
+// Verlet list skin for the neighbor list kernels.
+#define VERLET_SKIN 0.5f
+
+// Vector kernel check: array size (not a whole number of vectors),
+// trials and relative tolerance.
+#define CHECK_SIZE 1003
+#define CHECK_TRIALS 100
+#define CHECK_TOLERANCE 1.0e-6
+
+// Trajectory check: population, cycles, recording interval, cycles
+// between particle replacements and scratch file.
+#define CHECK_TRAJECTORY_PARTICLES 1000
+#define CHECK_TRAJECTORY_CYCLES 300
+#define CHECK_TRAJECTORY_INTERVAL 2
+#define CHECK_TRAJECTORY_CHURN 7
+#define CHECK_TRAJECTORY_FILE "checkTrajectory.trj"
+
+// Timing.
+#define DEFAULT_BUDGET 5.0
+#define MIN_MEASURE_TIME 0.1
+#define RANDOM_SEED 4517
+
+// Benchmark context.
+struct Context
+{
+    Physics *physics;
+    Chemistry *chemistry;
+    int numSamples;
+    Particle *samples[MAX_SAMPLES];
+    Neighborhood *neighborhoods;
+
+    // Kernel arrays gathered from the population.
+    MotionArrays motion;
+    MotionParameters motionParameters;
+    BondArrays bonds;
+};
+
+// Kernels.
+void chargeForces(Context *);
+void bondForces(Context *);
+void collisions(Context *);
+void verletCollisions(Context *);
+void neighborhoods(Context *);
+void matchNeighborhoods(Context *);
+void cellLocations(Context *);
+void integrateScalar(Context *);
+void integrateDispatched(Context *);
+void bondForcesScalar(Context *);
+void bondForcesDispatched(Context *);
+void randomNext(Context *);
+void randomFill(Context *);
+
+// Routine table.
+struct Routine
+{
+    const char *name;
+    void (*kernel)(Context *);
+    bool perSample;                               // Time is per sampled particle.
+};
+Routine Routines[] =
+{
+    { "updateChargeForces", chargeForces, false },
+    { "updateBonds", bondForces, false },
+    { "checkCollisions/resolveCollisions", collisions, false },
+    { "checkCollisions (Verlet lists)", verletCollisions, false },
+    { "Chemistry::getNeighborhood", neighborhoods, false },
+    { "Reaction::matchNeighborhood", matchNeighborhoods, true },
+    { "Neighborhood::getCellLocation", cellLocations, true },
+    { "Kernels::integrate (scalar)", integrateScalar, false },
+    { "Kernels::integrate (dispatched)", integrateDispatched, false },
+    { "Kernels::bondForces (scalar)", bondForcesScalar, false },
+    { "Kernels::bondForces (dispatched)", bondForcesDispatched, false },
+    { "Random::nextFloat", randomNext, false },
+    { "Random::fill", randomFill, false },
+    { NULL, NULL, false }
+};
+
+// Create synthetic population.
+void populate(Context *context, int numParticles, float density,
+    bool sample);
+
+// Create synthetic reactions.
+void createReactions(Chemistry *chemistry);
+
+// Release population.
+void release(Context *context);
+
+// Gather kernel arrays from population.
+void gatherArrays(Context *context);
+
+// Time kernel: seconds per call.
+double measure(void (*kernel)(Context *), Context *context);
+
+// Check vector kernels against scalar kernels.
+bool checkKernels();
+
+// Check trajectory writing, seeking and reading.
+bool checkTrajectory();
+
+int main(int argc, char *argv[])
+{
+    int i,d,k,n,lastSize,minParticles,maxParticles;
+    double budget,t,lastTime,predicted,exponent,perParticle;
+    char *routineName,*outputFileName;
+    bool skip,check,checkTrajectoryFile;
+    FILE *fp;
+    Routine *routine;
+    Context context;
+
+    Log::LOGGING_FLAG = LOG_TO_PRINT;
+    routineName = outputFileName = NULL;
+    minParticles = DEFAULT_MIN_PARTICLES;
+    maxParticles = DEFAULT_MAX_PARTICLES;
+    budget = DEFAULT_BUDGET;
+    check = checkTrajectoryFile = false;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-routine") == 0 && i + 1 < argc)
+        {
+            i++;
+            routineName = argv[i];
+            continue;
+        }
+        if (strcmp(argv[i], "-minParticles") == 0 && i + 1 < argc)
+        {
+            i++;
+            minParticles = atoi(argv[i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-maxParticles") == 0 && i + 1 < argc)
+        {
+            i++;
+            maxParticles = atoi(argv[i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-budget") == 0 && i + 1 < argc)
+        {
+            i++;
+            budget = atof(argv[i]);
+            continue;
+        }
+        if (strcmp(argv[i], "-output") == 0 && i + 1 < argc)
+        {
+            i++;
+            outputFileName = argv[i];
+            continue;
+        }
+        if (strcmp(argv[i], "-checkKernels") == 0)
+        {
+            check = true;
+            continue;
+        }
+        if (strcmp(argv[i], "-checkTrajectory") == 0)
+        {
+            checkTrajectoryFile = true;
+            continue;
+        }
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+    if (check)
+    {
+        i = checkKernels() ? 0 : 1;
+        Log::close();
+        return i;
+    }
+    if (checkTrajectoryFile)
+    {
+        i = checkTrajectory() ? 0 : 1;
+        Log::close();
+        return i;
+    }
+    if (minParticles < 1 || maxParticles < minParticles || budget <= 0.0)
+    {
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    fp = NULL;
+    if (outputFileName != NULL)
+    {
+        if ((fp = fopen(outputFileName, "w")) == NULL)
+        {
+            sprintf(Log::messageBuf, "Cannot open output file %s", outputFileName);
+            Log::logError();
+            exit(1);
+        }
+        fprintf(fp, "routine,particles,density,seconds_per_call,ns_per_particle\n");
+    }
+
+    sprintf(Log::messageBuf, "Vector kernels: %s",
+        Kernels::isVectorized() ? "AVX2" : "scalar");
+    Log::logInformation();
+    sprintf(Log::messageBuf, "%-36s %10s %8s %14s %14s", "routine",
+        "particles", "density", "ms/call", "ns/particle");
+    Log::logInformation();
+    for (routine = Routines; routine->name != NULL; routine++)
+    {
+        if (routineName != NULL && strstr(routine->name, routineName) == NULL) continue;
+        for (d = 0; d < NUM_DENSITIES; d++)
+        {
+            lastTime = 0.0;
+            lastSize = 0;
+            exponent = 2.0;
+            skip = false;
+            for (k = 0; k < NUM_SIZES; k++)
+            {
+                n = Sizes[k];
+                if (n < minParticles || n > maxParticles) continue;
+
+                // Project run time from the measured scaling.
+                if (lastTime > 0.0)
+                {
+                    predicted = lastTime *
+                        pow((double)n / (double)lastSize, exponent);
+                    if (predicted > budget) skip = true;
+                }
+                if (skip)
+                {
+                    sprintf(Log::messageBuf, "%-36s %10d %8.2f %14s %14s",
+                        routine->name, n, Densities[d], "skipped", "-");
+                    Log::logInformation();
+                    continue;
+                }
+
+                populate(&context, n, Densities[d], routine->perSample);
+                t = measure(routine->kernel, &context);
+                if (routine->perSample)
+                {
+                    perParticle = t / (double)context.numSamples;
+                }
+                else
+                {
+                    perParticle = t / (double)n;
+                }
+                release(&context);
+
+                if (lastTime > 0.0 && t > lastTime)
+                {
+                    exponent = log(t / lastTime) /
+                        log((double)n / (double)lastSize);
+                    if (exponent < 1.0) exponent = 1.0;
+                    if (exponent > 2.0) exponent = 2.0;
+                }
+                lastTime = t;
+                lastSize = n;
+
+                sprintf(Log::messageBuf, "%-36s %10d %8.2f %14.4f %14.2f",
+                    routine->name, n, Densities[d], t * 1.0e3, perParticle * 1.0e9);
+                Log::logInformation();
+                if (fp != NULL)
+                {
+                    fprintf(fp, "%s,%d,%f,%e,%f\n", routine->name, n,
+                        Densities[d], t, perParticle * 1.0e9);
+                    fflush(fp);
+                }
+            }
+        }
+    }
+    if (fp != NULL) fclose(fp);
+    Log::close();
+    return 0;
+}
+
+
+// Create synthetic population.
+// Particles are placed uniformly in a square sized for the density.
+// Half are free; half form bonded vertical chains.
+// Sampled neighborhoods are gathered for the per-sample kernels.
+void populate(Context *context, int numParticles, float density,
+bool sample)
+{
+    int i,j;
+    float side,x,y;
+    bool bonded;
+    Particle *particle,*previous;
+    Vector velocity;
+
+    context->physics = new Physics();
+    assert(context->physics != NULL);
+    context->physics->random.setRand(RANDOM_SEED);
+    context->chemistry = new Chemistry();
+    assert(context->chemistry != NULL);
+    context->chemistry->init(context->physics);
+    createReactions(context->chemistry);
+
+    side = (float)sqrt((double)numParticles / (double)density);
+    context->physics->setSize((int)side + 1, (int)side + 1);
+    previous = NULL;
+    x = y = 0.0f;
+    for (i = 0; i < numParticles; i++)
+    {
+        j = i % CHAIN_LENGTH;
+        bonded = (((i / CHAIN_LENGTH) % 2) == 0);
+        if (j == 0 || !bonded)
+        {
+            x = context->physics->random.nextFloat() * side;
+            y = context->physics->random.nextFloat() * side;
+        }
+        particle = new Particle((int)context->physics->random.nextInt(NUM_TYPES));
+        assert(particle != NULL);
+        particle->state = (int)context->physics->random.nextInt(NUM_STATES);
+        particle->orientation.direction = (int)context->physics->random.nextInt(8);
+        particle->orientation.mirrored = context->physics->random.nextBoolean();
+        particle->vPosition.x = x;
+        particle->vPosition.y = bonded ? y - (float)j : y;
+        velocity.x = (context->physics->random.nextFloat() - 0.5f) * MAX_VELOCITY;
+        velocity.y = (context->physics->random.nextFloat() - 0.5f) * MAX_VELOCITY;
+        context->physics->addParticle(particle, velocity);
+        if (bonded && j > 0)
+        {
+            context->physics->createBond(previous, SOUTH, particle, NORTH);
+        }
+        previous = particle;
+    }
+
+    // Sample particles and their neighborhoods.
+    context->numSamples = 0;
+    for (particle = context->physics->particles; sample && particle != NULL &&
+        context->numSamples < MAX_SAMPLES; particle = particle->next)
+    {
+        context->samples[context->numSamples++] = particle;
+    }
+    context->neighborhoods = new Neighborhood[context->numSamples];
+    assert(context->neighborhoods != NULL);
+    for (i = 0; i < context->numSamples; i++)
+    {
+        context->chemistry->getNeighborhood(context->samples[i],
+            &context->neighborhoods[i]);
+    }
+    gatherArrays(context);
+}
+
+
+// Gather kernel arrays from population.
+// Forces are random; friction is 1 so that velocities do not decay
+// toward denormal values over repeated calls.
+void gatherArrays(Context *context)
+{
+    int i,j,n;
+    Particle *particle,*particle2;
+    MotionArrays &motion = context->motion;
+    BondArrays &bonds = context->bonds;
+    Physics *physics = context->physics;
+
+    motion.resize(physics->numParticles);
+    n = 0;
+    for (i = 0, particle = physics->particles; particle != NULL;
+        i++, particle = particle->next)
+    {
+        motion.x[i] = particle->vPosition.x;
+        motion.y[i] = particle->vPosition.y;
+        motion.vx[i] = particle->vVelocity.x;
+        motion.vy[i] = particle->vVelocity.y;
+        motion.fx[i] = (physics->random.nextFloat() - 0.5f) * MAX_BROWNIAN_FORCE;
+        motion.fy[i] = (physics->random.nextFloat() - 0.5f) * MAX_BROWNIAN_FORCE;
+        motion.mass[i] = particle->fMass;
+        for (j = 0; j < 8; j++)
+        {
+            if (particle->bonds[j] != NULL) n++;
+        }
+    }
+    context->motionParameters.dtime = 1.0f;
+    context->motionParameters.maxVelocity = MAX_VELOCITY;
+    context->motionParameters.friction = 1.0f;
+    context->motionParameters.periodic = false;
+    context->motionParameters.width = (float)physics->width;
+    context->motionParameters.height = (float)physics->height;
+    context->motionParameters.lowX = context->motionParameters.lowY = POSITION(0.0f);
+    context->motionParameters.highX = POSITION(physics->width - 1);
+    context->motionParameters.highY = POSITION(physics->height - 1);
+
+    bonds.resize(n);
+    bonds.maxLength = MAX_BOND_LENGTH;
+    n = 0;
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        for (j = 0; j < 8; j++)
+        {
+            if ((particle2 = particle->bonds[j]) == NULL) continue;
+            bonds.x1[n] = particle->vPosition.x;
+            bonds.y1[n] = particle->vPosition.y;
+            bonds.ox[n] = DirectionOffsetX[j];
+            bonds.oy[n] = DirectionOffsetY[j];
+            bonds.x2[n] = particle2->vPosition.x;
+            bonds.y2[n] = particle2->vPosition.y;
+            bonds.strength[n] = particle->bondProperties[j]->getStrength();
+            n++;
+        }
+    }
+}
+
+
+// Create synthetic reactions resembling the replicator rules:
+// a typed center particle with one or two typed neighbors.
+void createReactions(Chemistry *chemistry)
+{
+    int i;
+    Reaction *reaction;
+
+    chemistry->numReactions = NUM_REACTIONS;
+    chemistry->reactions = new Reaction*[NUM_REACTIONS];
+    assert(chemistry->reactions != NULL);
+    for (i = 0; i < NUM_REACTIONS; i++)
+    {
+        reaction = new Reaction();
+        assert(reaction != NULL);
+        reaction->types[1][1] = (int)chemistry->physics->random.nextInt(NUM_TYPES);
+        reaction->states[1][1] = (int)chemistry->physics->random.nextInt(NUM_STATES);
+        reaction->types[2][1] = (int)chemistry->physics->random.nextInt(NUM_TYPES);
+        reaction->states[2][1] = (int)chemistry->physics->random.nextInt(NUM_STATES);
+        if (chemistry->physics->random.nextBoolean())
+        {
+            reaction->types[1][0] = (int)chemistry->physics->random.nextInt(NUM_TYPES);
+        }
+        reaction->reactionType = BOND_REACTION;
+        reaction->x = 2; reaction->y = 1;
+        reaction->sourceBond = EAST;
+        reaction->targetBond = WEST;
+        chemistry->reactions[i] = reaction;
+    }
+}
+
+
+// Release population.
+void release(Context *context)
+{
+    delete [] context->neighborhoods;
+    delete context->chemistry;
+    delete context->physics;
+}
+
+
+// Time kernel: seconds per call.
+double measure(void (*kernel)(Context *), Context *context)
+{
+    int calls;
+    double start,t;
+
+    // Warm up.
+    start = Benchmark::getTime();
+    kernel(context);
+    t = Benchmark::getTime() - start;
+    if (t >= MIN_MEASURE_TIME) return t;
+
+    start = Benchmark::getTime();
+    for (calls = 0; (t = Benchmark::getTime() - start) < MIN_MEASURE_TIME; calls++)
+    {
+        kernel(context);
+    }
+    return t / (double)calls;
+}
+
+
+// Charge forces.
+void chargeForces(Context *context)
+{
+    context->physics->updateChargeForces();
+}
+
+
+// Bond breaking and forces: the particles do not move,
+// so bonds break only on the first call.
+void bondForces(Context *context)
+{
+    context->physics->updateBonds();
+}
+
+
+// Collision detection and resolution.
+void collisions(Context *context)
+{
+    context->physics->detectCollisions();
+    context->physics->resolveCollisions();
+    context->physics->releaseCollisions();
+}
+
+
+// Collision detection and resolution with Verlet lists: the
+// particles do not move, so the lists are built on the first call.
+void verletCollisions(Context *context)
+{
+    if (context->physics->getVerletSkin() == 0.0f)
+    {
+        context->physics->setVerlet(VERLET_SKIN, 0.0f);
+    }
+    collisions(context);
+}
+
+
+// Neighborhood gathering for every particle.
+void neighborhoods(Context *context)
+{
+    Particle *particle;
+    Neighborhood neighbors;
+
+    for (particle = context->physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        context->chemistry->getNeighborhood(particle, &neighbors);
+    }
+}
+
+
+// Reaction matching over sampled neighborhoods.
+void matchNeighborhoods(Context *context)
+{
+    int i,j;
+    Chemistry *chemistry = context->chemistry;
+
+    for (i = 0; i < context->numSamples; i++)
+    {
+        context->neighborhoods[i].transform(context->samples[i]->orientation);
+        for (j = 0; j < chemistry->numReactions; j++)
+        {
+            chemistry->reactions[j]->matchNeighborhood(&context->neighborhoods[i]);
+        }
+    }
+}
+
+
+// Cell location transforms over sampled orientations.
+void cellLocations(Context *context)
+{
+    int i,x,y,x2,y2;
+
+    for (i = 0; i < context->numSamples; i++)
+    {
+        context->neighborhoods[i].transform(context->samples[i]->orientation);
+        for (x = -1; x <= 1; x++)
+        {
+            for (y = -1; y <= 1; y++)
+            {
+                x2 = x;
+                y2 = y;
+                context->neighborhoods[i].getCellLocation(x2, y2);
+            }
+        }
+    }
+}
+
+
+// Motion integration kernels.
+void integrateScalar(Context *context)
+{
+    Kernels::integrateScalar(context->motion, context->motionParameters,
+        0, context->motion.count);
+}
+
+
+void integrateDispatched(Context *context)
+{
+    Kernels::integrate(context->motion, context->motionParameters);
+}
+
+
+// Bond force kernels.
+void bondForcesScalar(Context *context)
+{
+    Kernels::bondForcesScalar(context->bonds, 0, context->bonds.count);
+}
+
+
+void bondForcesDispatched(Context *context)
+{
+    Kernels::bondForces(context->bonds);
+}
+
+
+// Random numbers: one per particle.
+void randomNext(Context *context)
+{
+    Random *random = &context->physics->random;
+    float *values = context->motion.fx.data();
+    int i,n;
+
+    n = context->motion.count;
+    for (i = 0; i < n; i++)
+    {
+        values[i] = random->nextFloat();
+    }
+}
+
+
+void randomFill(Context *context)
+{
+    context->physics->random.fill(context->motion.fx.data(),
+        context->motion.count);
+}
+
+
+// Relative difference of kernel results.
+static double difference(float a, float b)
+{
+    double d = fabs((double)a - (double)b);
+    double m = fabs((double)a) > fabs((double)b) ? fabs((double)a) : fabs((double)b);
+
+    return m > 1.0 ? d / m : d;
+}
+
+
+// Check vector kernels against scalar kernels over random inputs:
+// velocities above and far below the speed limit, positions beyond
+// the edges, bounded and periodic worlds, and zero length and
+// overstretched bonds.
+bool checkKernels()
+{
+    int i,trial,failures;
+    double d,maxDifference;
+    Random random;
+    MotionArrays motion,motion2;
+    MotionParameters parameters;
+    BondArrays bonds,bonds2;
+
+    if (!Kernels::hasAVX2())
+    {
+        sprintf(Log::messageBuf, "AVX2 not supported: no vector kernels to check");
+        Log::logInformation();
+        return true;
+    }
+    Kernels::setVectorize(true);
+    random.setRand(RANDOM_SEED);
+    failures = 0;
+    maxDifference = 0.0;
+    for (trial = 0; trial < CHECK_TRIALS; trial++)
+    {
+        // Motion.
+        motion.resize(CHECK_SIZE);
+        for (i = 0; i < CHECK_SIZE; i++)
+        {
+            motion.x[i] = (random.nextFloat() * 1.2f - 0.1f) * 100.0f;
+            motion.y[i] = (random.nextFloat() * 1.2f - 0.1f) * 100.0f;
+            motion.vx[i] = (random.nextFloat() - 0.5f) * 2.0f * MAX_VELOCITY;
+            motion.vy[i] = (random.nextFloat() - 0.5f) * 2.0f * MAX_VELOCITY;
+            if (random.nextInt(10) == 0) motion.vx[i] *= 1.0e-8f;
+            motion.fx[i] = (random.nextFloat() - 0.5f) * MAX_BROWNIAN_FORCE * 20.0f;
+            motion.fy[i] = (random.nextFloat() - 0.5f) * MAX_BROWNIAN_FORCE * 20.0f;
+            motion.mass[i] = 0.5f + random.nextFloat();
+        }
+        motion2 = motion;
+        parameters.dtime = 1.0f;
+        parameters.maxVelocity = MAX_VELOCITY;
+        parameters.friction = 1.0f - VISCOSITY_FRICTION;
+        parameters.periodic = ((trial % 2) == 1);
+        parameters.width = parameters.height = 100.0f;
+        parameters.lowX = parameters.lowY = POSITION(0.0f);
+        parameters.highX = parameters.highY = POSITION(99);
+        Kernels::integrateScalar(motion, parameters, 0, motion.count);
+        Kernels::integrate(motion2, parameters);
+        for (i = 0; i < CHECK_SIZE; i++)
+        {
+            d = difference(motion.x[i], motion2.x[i]);
+            if (difference(motion.y[i], motion2.y[i]) > d) d = difference(motion.y[i], motion2.y[i]);
+            if (difference(motion.vx[i], motion2.vx[i]) > d) d = difference(motion.vx[i], motion2.vx[i]);
+            if (difference(motion.vy[i], motion2.vy[i]) > d) d = difference(motion.vy[i], motion2.vy[i]);
+            if (motion2.fx[i] != 0.0f || motion2.fy[i] != 0.0f) d = 1.0;
+            if (d > maxDifference) maxDifference = d;
+            if (d > CHECK_TOLERANCE) failures++;
+        }
+
+        // Bonds.
+        bonds.resize(CHECK_SIZE);
+        for (i = 0; i < CHECK_SIZE; i++)
+        {
+            bonds.x1[i] = random.nextFloat() * 100.0f;
+            bonds.y1[i] = random.nextFloat() * 100.0f;
+            bonds.ox[i] = (float)((int)random.nextInt(3) - 1);
+            bonds.oy[i] = (float)((int)random.nextInt(3) - 1);
+            if (random.nextInt(4) == 0)
+            {
+                bonds.x2[i] = bonds.x1[i] + bonds.ox[i];
+                bonds.y2[i] = bonds.y1[i] + bonds.oy[i];
+            }
+            else if (random.nextInt(4) == 0)
+            {
+                bonds.x2[i] = bonds.x1[i] + (random.nextFloat() - 0.5f) * 4.0f * MAX_BOND_LENGTH;
+                bonds.y2[i] = bonds.y1[i] + (random.nextFloat() - 0.5f) * 4.0f * MAX_BOND_LENGTH;
+            }
+            else
+            {
+                bonds.x2[i] = bonds.x1[i] + bonds.ox[i] + (random.nextFloat() - 0.5f) * 4.0f;
+                bonds.y2[i] = bonds.y1[i] + bonds.oy[i] + (random.nextFloat() - 0.5f) * 4.0f;
+            }
+            bonds.strength[i] = DEFAULT_BOND_STRENGTH * (0.5f + random.nextFloat());
+        }
+        bonds.maxLength = MAX_BOND_LENGTH;
+        bonds2 = bonds;
+        Kernels::bondForcesScalar(bonds, 0, bonds.count);
+        Kernels::bondForces(bonds2);
+        for (i = 0; i < CHECK_SIZE; i++)
+        {
+            d = difference(bonds.fx[i], bonds2.fx[i]);
+            if (difference(bonds.fy[i], bonds2.fy[i]) > d) d = difference(bonds.fy[i], bonds2.fy[i]);
+            if ((bonds.apply[i] != 0) != (bonds2.apply[i] != 0)) d = 1.0;
+            if ((bonds.stretched[i] != 0) != (bonds2.stretched[i] != 0)) d = 1.0;
+            if (d > maxDifference) maxDifference = d;
+            if (d > CHECK_TOLERANCE) failures++;
+        }
+    }
+    sprintf(Log::messageBuf, "Vector kernel check: %d trials of %d, maximum difference %g, %d failures: %s",
+        CHECK_TRIALS, CHECK_SIZE, maxDifference, failures, failures == 0 ? "passed" : "FAILED");
+    if (failures == 0)
+    {
+        Log::logInformation();
+    }
+    else
+    {
+        Log::logError();
+    }
+    return failures == 0;
+}
+
+
+// Frames hold the same particles, bonds and quantized positions?
+bool sameFrame(TrajectoryFrame &frame, TrajectoryFrame &frame2)
+{
+    return frame.cycle == frame2.cycle && frame.ids == frame2.ids &&
+        frame.types == frame2.types && frame.states == frame2.states &&
+        frame.orientations == frame2.orientations &&
+        frame.x == frame2.x && frame.y == frame2.y &&
+        frame.bonds == frame2.bonds;
+}
+
+
+// Check trajectory writing, seeking and reading.
+// A population is stepped and recorded while particles are replaced
+// and their states changed. The file is then read back: key frames,
+// frames between key frames, backward seeks and finally every frame
+// in order, each compared with the frame loaded from the physics
+// when it was recorded.
+bool checkTrajectory()
+{
+    int i,cycle,numFrames,failures;
+    Context context;
+    Physics *physics;
+    Particle *particle;
+    Vector velocity;
+    TrajectoryWriter *writer;
+    TrajectoryReader reader;
+    TrajectoryFrame frame;
+    std::vector<TrajectoryFrame> expected;
+    std::vector<int> order;
+    char fileName[] = CHECK_TRAJECTORY_FILE;
+
+    populate(&context, CHECK_TRAJECTORY_PARTICLES, 0.25f, false);
+    physics = context.physics;
+
+    // Record.
+    writer = new TrajectoryWriter();
+    assert(writer != NULL);
+    if (!writer->open(fileName, CHECK_TRAJECTORY_INTERVAL))
+    {
+        sprintf(Log::messageBuf, "Cannot open trajectory file %s", fileName);
+        Log::logError();
+        delete writer;
+        release(&context);
+        return false;
+    }
+    for (cycle = 0; ; cycle++)
+    {
+        if ((cycle % CHECK_TRAJECTORY_INTERVAL) == 0)
+        {
+            expected.resize(expected.size() + 1);
+            expected.back().load(cycle, physics);
+        }
+        writer->record(cycle, physics);
+        if (cycle == CHECK_TRAJECTORY_CYCLES) break;
+        physics->step(DTIME);
+
+        // Replace a particle and change a state.
+        if ((cycle % CHECK_TRAJECTORY_CHURN) == 0)
+        {
+            physics->removeParticle(physics->particles);
+            particle = new Particle((int)physics->random.nextInt(NUM_TYPES));
+            assert(particle != NULL);
+            particle->vPosition.x = physics->random.nextFloat() * (float)(physics->width - 1);
+            particle->vPosition.y = physics->random.nextFloat() * (float)(physics->height - 1);
+            physics->addParticle(particle, velocity);
+            physics->setState(physics->particles->next,
+                (int)physics->random.nextInt(NUM_STATES));
+        }
+    }
+    writer->close();
+    delete writer;
+    release(&context);
+
+    // Read back.
+    failures = 0;
+    numFrames = (int)expected.size();
+    if (!reader.open(fileName))
+    {
+        sprintf(Log::messageBuf, "Cannot open trajectory file %s", fileName);
+        Log::logError();
+        remove(fileName);
+        return false;
+    }
+    if (reader.getNumFrames() != numFrames ||
+        reader.getInterval() != CHECK_TRAJECTORY_INTERVAL)
+    {
+        failures++;
+    }
+    else
+    {
+        for (i = 0; i < numFrames; i++)
+        {
+            if (reader.getCycle(i) != expected[i].cycle) failures++;
+        }
+
+        // Key frames, frames after and before them, the last frame,
+        // a backward seek within a key interval, then every frame.
+        order.push_back(TRAJECTORY_KEY_INTERVAL);
+        order.push_back(0);
+        order.push_back(TRAJECTORY_KEY_INTERVAL + 1);
+        order.push_back(TRAJECTORY_KEY_INTERVAL - 1);
+        order.push_back(numFrames - 1);
+        order.push_back((TRAJECTORY_KEY_INTERVAL * 3) / 2);
+        order.push_back(TRAJECTORY_KEY_INTERVAL + 2);
+        for (i = 0; i < numFrames; i++)
+        {
+            order.push_back(i);
+        }
+        for (i = 0; i < (int)order.size(); i++)
+        {
+            if (order[i] >= numFrames) continue;
+            if (!reader.read(order[i], frame) ||
+                !sameFrame(frame, expected[order[i]]))
+            {
+                failures++;
+            }
+        }
+    }
+    reader.close();
+    remove(fileName);
+
+    sprintf(Log::messageBuf, "Trajectory check: %d frames of %d particles, %d reads, %d failures: %s",
+        numFrames, CHECK_TRAJECTORY_PARTICLES, (int)order.size(), failures,
+        failures == 0 ? "passed" : "FAILED");
+    if (failures == 0)
+    {
+        Log::logInformation();
+    }
+    else
+    {
+        Log::logError();
+    }
+    return failures == 0;
+}
@@ -18,26 +18,52 @@
  * Chemistry.
  */
 
+#include <assert.h>
 #include "Chemistry.hpp"
+#include "../base/Instrument.hpp"
 
 // Constructor.
 Chemistry::Chemistry()
 {
     numReactions = 0;
     reactions = NULL;
+    sharedReactions = false;
+    profiler = NULL;
 }
 
 
-// Constructor.
+// Destructor.
 Chemistry::~Chemistry()
 {
-    for (int i = 0; i < numReactions; i++)
+    clearReactions();
+}
+
+
+// Release reactions.
+void Chemistry::clearReactions()
+{
+    if (!sharedReactions)
     {
-        delete reactions[i];
-        reactions[i] = NULL;
+        for (int i = 0; i < numReactions; i++)
+        {
+            delete reactions[i];
+            reactions[i] = NULL;
+        }
+        if (reactions != NULL) delete [] reactions;
     }
-    if (reactions != NULL) delete reactions;
     reactions = NULL;
+    numReactions = 0;
+    sharedReactions = false;
+}
+
+
+// Use another chemistry's reactions.
+void Chemistry::shareReactions(Chemistry *chemistry)
+{
+    clearReactions();
+    reactions = chemistry->reactions;
+    numReactions = chemistry->numReactions;
+    sharedReactions = true;
 }
 
 
@@ -52,100 +78,143 @@ void Chemistry::init(Physics *physics)
 // Step chemistry.
 void Chemistry::step()
 {
-    int x,y;
-    float px,py;
-    Particle *particle,*particle2;
+    Particle *particle;
     Neighborhood neighbors;
 
-    // Step particles.
-    for (particle = physics->particles; particle != NULL;
-        particle = particle->next)
+    // Step particles of awake tiles when sleeping.
+    if (physics->isSleepEnabled())
     {
-        for (x = 0; x < 3; x++)
+        for (int i = 0; i < (int)physics->active.size(); i++)
         {
-            for (y = 0; y < 3; y++)
+            if ((particle = physics->active[i]) != NULL)
             {
-                neighbors.particles[x][y].clear();
+                step(particle, &neighbors);
             }
         }
+        return;
+    }
+
+    // Step particles.
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        step(particle, &neighbors);
+    }
+}
+
+
+// Step particle.
+void Chemistry::step(Particle *particle, Neighborhood *neighbors)
+{
+    // Ghosts react in their owners.
+    if (particle->ghost) return;
+
+    // Gather neighborhood.
+    if (profiler != NULL) profiler->beginPhase(PHASE_NEIGHBORHOOD);
+    getNeighborhood(particle, neighbors);
+    if (profiler != NULL) profiler->endPhase(PHASE_NEIGHBORHOOD);
+    INSTRUMENT_NEIGHBORHOOD(neighbors->size() - 1);
+
+    // Particle reactions.
+    if (profiler != NULL) profiler->beginPhase(PHASE_MATCH);
+    react(neighbors);
+    if (profiler != NULL) profiler->endPhase(PHASE_MATCH);
+}
 
-        // Center particle.
-        neighbors.particles[1][1].push_front(particle);
 
-        // Attach neighboring particles.
-        px = particle->vPosition.x;
-        py = particle->vPosition.y;
-        for (particle2 = physics->particles; particle2 != NULL;
-            particle2 = particle2->next)
+// Gather Moore neighborhood of particle.
+void Chemistry::getNeighborhood(Particle *particle, Neighborhood *neighbors)
+{
+    int i,x,y;
+    float px,py;
+    Particle *particle2;
+    Vector position;
+
+    for (x = 0; x < 3; x++)
+    {
+        for (y = 0; y < 3; y++)
         {
-            if (particle == particle2) continue;
+            neighbors->particles[x][y].clear();
+        }
+    }
+
+    // Center particle.
+    neighbors->particles[1][1].push_front(particle);
+
+    // Attach neighboring particles.
+    px = particle->vPosition.x;
+    py = particle->vPosition.y;
+    x = Grid::getCell(px);
+    y = Grid::getCell(py);
+    physics->getGridParticles(x - 2, y - 2, x + 2, y + 2, candidates);
+    for (i = 0; i < (int)candidates.size(); i++)
+    {
+        particle2 = candidates[i];
+        if (particle == particle2) continue;
+        position = physics->getImage(particle2->vPosition, particle->vPosition);
 
-            if (particle2->vPosition.x < (px - 0.5f) &&
-                particle2->vPosition.x >= (px - 1.5f))
+        if (position.x < (px - 0.5f) &&
+            position.x >= (px - 1.5f))
+        {
+            if (position.y < (py - 0.5f) &&
+                position.y >= (py - 1.5f))
             {
-                if (particle2->vPosition.y < (py - 0.5f) &&
-                    particle2->vPosition.y >= (py - 1.5f))
-                {
-                    neighbors.particles[0][0].push_front(particle2);
-                    continue;
-                }
-                if (particle2->vPosition.y >= (py - 0.5f) &&
-                    particle2->vPosition.y < (py + 0.5f))
-                {
-                    neighbors.particles[0][1].push_front(particle2);
-                    continue;
-                }
-                if (particle2->vPosition.y >= (py + 0.5f) &&
-                    particle2->vPosition.y < (py + 1.5f))
-                {
-                    neighbors.particles[0][2].push_front(particle2);
-                    continue;
-                }
+                neighbors->particles[0][0].push_front(particle2);
+                continue;
             }
-
-            if (particle2->vPosition.x >= (px - 0.5f) &&
-                particle2->vPosition.x < (px + 0.5f))
+            if (position.y >= (py - 0.5f) &&
+                position.y < (py + 0.5f))
             {
-                if (particle2->vPosition.y < (py - 0.5f) &&
-                    particle2->vPosition.y >= (py - 1.5f))
-                {
-                    neighbors.particles[1][0].push_front(particle2);
-                    continue;
-                }
-                if (particle2->vPosition.y >= (py + 0.5f) &&
-                    particle2->vPosition.y < (py + 1.5f))
-                {
-                    neighbors.particles[1][2].push_front(particle2);
-                    continue;
-                }
+                neighbors->particles[0][1].push_front(particle2);
+                continue;
+            }
+            if (position.y >= (py + 0.5f) &&
+                position.y < (py + 1.5f))
+            {
+                neighbors->particles[0][2].push_front(particle2);
+                continue;
             }
+        }
 
-            if (particle2->vPosition.x >= (px + 0.5f) &&
-                particle2->vPosition.x < (px + 1.5f))
+        if (position.x >= (px - 0.5f) &&
+            position.x < (px + 0.5f))
+        {
+            if (position.y < (py - 0.5f) &&
+                position.y >= (py - 1.5f))
             {
-                if (particle2->vPosition.y < (py - 0.5f) &&
-                    particle2->vPosition.y >= (py - 1.5f))
-                {
-                    neighbors.particles[2][0].push_front(particle2);
-                    continue;
-                }
-                if (particle2->vPosition.y >= (py - 0.5f) &&
-                    particle2->vPosition.y < (py + 0.5f))
-                {
-                    neighbors.particles[2][1].push_front(particle2);
-                    continue;
-                }
-                if (particle2->vPosition.y >= (py + 0.5f) &&
-                    particle2->vPosition.y < (py + 1.5f))
-                {
-                    neighbors.particles[2][2].push_front(particle2);
-                    continue;
-                }
+                neighbors->particles[1][0].push_front(particle2);
+                continue;
+            }
+            if (position.y >= (py + 0.5f) &&
+                position.y < (py + 1.5f))
+            {
+                neighbors->particles[1][2].push_front(particle2);
+                continue;
             }
         }
 
-        // Particle reactions.
-        react(&neighbors);
+        if (position.x >= (px + 0.5f) &&
+            position.x < (px + 1.5f))
+        {
+            if (position.y < (py - 0.5f) &&
+                position.y >= (py - 1.5f))
+            {
+                neighbors->particles[2][0].push_front(particle2);
+                continue;
+            }
+            if (position.y >= (py - 0.5f) &&
+                position.y < (py + 0.5f))
+            {
+                neighbors->particles[2][1].push_front(particle2);
+                continue;
+            }
+            if (position.y >= (py + 0.5f) &&
+                position.y < (py + 1.5f))
+            {
+                neighbors->particles[2][2].push_front(particle2);
+                continue;
+            }
+        }
     }
 }
 
@@ -153,10 +222,12 @@ void Chemistry::step()
 // Particle reactions.
 void Chemistry::react(Neighborhood *neighbors)
 {
-    int reactionIndex,x,y;
+    int reactionIndex;
     Reaction *reaction;
-    Particle *particle,*particle2;
-    std::list<Particle *>::const_iterator listItr,listItr2;
+    Particle *particle;
+    std::list<Particle *>::const_iterator listItr;
+
+    INSTRUMENT_TIMER(TIMER_CHEMISTRY_REACT);
 
     // Process particles in neighborhood center.
     for (listItr = neighbors->particles[1][1].begin();
@@ -172,118 +243,174 @@ void Chemistry::react(Neighborhood *neighbors)
         {
             reaction = reactions[reactionIndex];
             if (reaction->reactionType == NULL_REACTION) continue;
-            if (!reaction->matchNeighborhood(neighbors)) continue;
-
-            // Determine reaction target location.
-            x = reaction->x - 1;
-            y = reaction->y - 1;
-            neighbors->getCellLocation(x, y);
-            x++; y++;
-
-            // Create particle?
-            if (reaction->reactionType == CREATE_REACTION)
+            if (!reaction->matchNeighborhood(neighbors))
             {
-                float px = particle->vPosition.x + float(x - 1);
-                if (px < 0.0f || px >= (float)WIDTH) continue;
-                float py = particle->vPosition.y + float(y - 1);
-                if (py < 0.0f || py >= (float)HEIGHT) continue;
-                particle2 = physics->createParticle(reaction->type);
-                if (particle2 != NULL)
-                {
-                    #if ( TRAP == 1 )
-                    // Trap event?
-                    if (reaction->trap)
-                    {
-                        appTrap(reaction->trapNum);
-                    }
-                    #endif
-                    particle2->vPosition.x = px;
-                    particle2->vPosition.y = py;
-                    particle2->vVelocity = particle->vVelocity;
-
-                    // Orient particle.
-                    particle2->orientation.direction =
-                        particle->orientation.aim(reaction->orientation.direction);
-                    particle2->orientation.mirrored =
-                        particle->orientation.getMirrorX2(reaction->orientation.mirrored);
-
-                    // Set next states.
-                    if (reaction->sourceState != Reaction::IGNORE_STATE)
-                    {
-                        particle->state = reaction->sourceState;
-                    }
-                    if (reaction->targetState != Reaction::IGNORE_STATE)
-                    {
-                        particle2->state = reaction->targetState;
-                    }
-                }
+                INSTRUMENT_MATCH(reactionIndex, false);
                 continue;
             }
+            INSTRUMENT_MATCH(reactionIndex, true);
+            if (profiler != NULL) profiler->beginPhase(PHASE_APPLY);
+            apply(particle, reaction, neighbors);
+            if (profiler != NULL) profiler->endPhase(PHASE_APPLY);
+        }
+    }
+}
 
-            // Apply remaining reactions to targeted particles.
-            for (listItr2 = neighbors->particles[x][y].begin();
-                listItr2 != neighbors->particles[x][y].end(); listItr2++)
+
+// Apply matched reaction.
+void Chemistry::apply(Particle *particle, Reaction *reaction,
+Neighborhood *neighbors)
+{
+    int x,y;
+    Particle *particle2;
+    std::list<Particle *>::const_iterator listItr2;
+
+    // Determine reaction target location.
+    x = reaction->x - 1;
+    y = reaction->y - 1;
+    neighbors->getCellLocation(x, y);
+    x++; y++;
+
+    // Create particle?
+    if (reaction->reactionType == CREATE_REACTION)
+    {
+        float px = particle->vPosition.x + float(x - 1);
+        float py = particle->vPosition.y + float(y - 1);
+        if (physics->isPeriodic())
+        {
+            px = Physics::wrap(px, physics->width);
+            py = Physics::wrap(py, physics->height);
+        }
+        else
+        {
+            if (px < 0.0f || px >= (float)physics->width) return;
+            if (py < 0.0f || py >= (float)physics->height) return;
+        }
+        particle2 = physics->createParticle(reaction->type);
+        if (particle2 != NULL)
+        {
+            #if ( TRAP == 1 )
+            // Trap event?
+            if (reaction->trap)
+            {
+                appTrap(reaction->trapNum);
+            }
+            #endif
+            particle2->vPosition.x = px;
+            particle2->vPosition.y = py;
+            particle2->vVelocity = particle->vVelocity;
+
+            // Orient particle.
+            particle2->orientation.direction =
+                particle->orientation.aim(reaction->orientation.direction);
+            particle2->orientation.mirrored =
+                particle->orientation.getMirrorX2(reaction->orientation.mirrored);
+
+            // Set next states.
+            if (reaction->sourceState != Reaction::IGNORE_STATE)
             {
-                particle2 = *listItr2;
-                if (particle2->type != reaction->types[x][y]) continue;
-
-                #if ( TRAP == 1 )
-                // Trap event?
-                if (reaction->trap)
-                {
-                    appTrap(reaction->trapNum);
-                }
-                #endif
-                // Set next states.
-                if (reaction->sourceState != Reaction::IGNORE_STATE)
-                {
-                    particle->state = reaction->sourceState;
-                }
-                if (reaction->targetState != Reaction::IGNORE_STATE)
-                {
-                    particle2->state = reaction->targetState;
-                }
-
-                switch(reaction->reactionType)
-                {
-                    case BOND_REACTION:
-                        physics->createBond(particle,
-                            particle->orientation.aim(reaction->sourceBond),
-                            particle2,
-                            particle->orientation.aim(reaction->targetBond),
-                            reaction->bondStrength);
-                        break;
-
-                    case SET_TYPE_REACTION:
-                        particle2->type = reaction->type;
-                        break;
-
-                    case SET_STATE_REACTION:
-                        break;
-
-                    case ORIENT_REACTION:
-                        particle2->orientation.direction =
-                            particle->orientation.aim(reaction->orientation.direction);
-                        particle2->orientation.mirrored =
-                            particle->orientation.getMirrorX2(reaction->orientation.mirrored);
-                        break;
-
-                    case UNBOND_REACTION:
-                        physics->removeBond(particle2, particle2->orientation.aim(reaction->sourceBond));
-                        break;
-
-                    case DESTROY_REACTION:
-                        physics->removeParticle(particle2);
-                        break;
-                }
+                physics->setState(particle, reaction->sourceState);
             }
+            if (reaction->targetState != Reaction::IGNORE_STATE)
+            {
+                physics->setState(particle2, reaction->targetState);
+            }
+        }
+        return;
+    }
+
+    // Apply remaining reactions to targeted particles.
+    for (listItr2 = neighbors->particles[x][y].begin();
+        listItr2 != neighbors->particles[x][y].end(); listItr2++)
+    {
+        particle2 = *listItr2;
+        if (particle2->type != reaction->types[x][y]) continue;
+
+        #if ( TRAP == 1 )
+        // Trap event?
+        if (reaction->trap)
+        {
+            appTrap(reaction->trapNum);
+        }
+        #endif
+        // Reacting particles are awake.
+        physics->wake(particle);
+        physics->wake(particle2);
+
+        // Set next states.
+        if (reaction->sourceState != Reaction::IGNORE_STATE)
+        {
+            physics->setState(particle, reaction->sourceState);
+        }
+        if (reaction->targetState != Reaction::IGNORE_STATE)
+        {
+            physics->setState(particle2, reaction->targetState);
+        }
+
+        switch(reaction->reactionType)
+        {
+            case BOND_REACTION:
+                physics->createBond(particle,
+                    particle->orientation.aim(reaction->sourceBond),
+                    particle2,
+                    particle->orientation.aim(reaction->targetBond),
+                    reaction->bondStrength);
+                break;
+
+            case SET_TYPE_REACTION:
+                physics->setType(particle2, reaction->type);
+                break;
+
+            case SET_STATE_REACTION:
+                break;
+
+            case ORIENT_REACTION:
+                particle2->orientation.direction =
+                    particle->orientation.aim(reaction->orientation.direction);
+                particle2->orientation.mirrored =
+                    particle->orientation.getMirrorX2(reaction->orientation.mirrored);
+                break;
+
+            case UNBOND_REACTION:
+                physics->removeBond(particle2, particle2->orientation.aim(reaction->sourceBond));
+                break;
+
+            case DESTROY_REACTION:
+                physics->removeParticle(particle2);
+                break;
         }
     }
 }
 
 
 // Load chemistry.
-void Chemistry::load(FILE *fp) {}
+// A run saved without a reaction table keeps the current reactions.
+void Chemistry::load(FILE *fp)
+{
+    int i,num;
+
+    if (fscanf(fp, "%d", &num) != 1 || num < 0) return;
+    clearReactions();
+    if (num == 0) return;
+    reactions = new Reaction*[num];
+    assert(reactions != NULL);
+    for (i = 0; i < num; i++)
+    {
+        reactions[i] = Reaction::read(fp);
+    }
+    numReactions = num;
+}
+
 
 // Save chemistry.
-void Chemistry::save(FILE *fp) {}
+void Chemistry::save(FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "%d\n", numReactions);
+    for (i = 0; i < numReactions; i++)
+    {
+        Reaction::write(fp, reactions[i]);
+    }
+    fflush(fp);
+}
@@ -21,6 +21,7 @@
 #ifndef __CHEMISTRY__
 #define __CHEMISTRY__
 
+#include <vector>
 #include "../util/Random.hpp"
 #include "../base/Physics.hpp"
 #include "Reaction.hpp"
@@ -38,6 +39,12 @@ class Chemistry
         int numReactions;
         Reaction **reactions;
 
+        // Reactions owned by another chemistry?
+        bool sharedReactions;
+
+        // Phase profiler (optional).
+        Profiler *profiler;
+
         // Constructor.
         Chemistry();
 
@@ -47,16 +54,36 @@ class Chemistry
         // Initialize.
         void init(Physics *physics);
 
+        // Release reactions.
+        void clearReactions();
+
+        // Use another chemistry's reactions, read-only.
+        // The other chemistry must outlive this one.
+        void shareReactions(Chemistry *chemistry);
+
         // Step chemistry.
         void step();
 
-        // Load and save chemistry.
+        // Gather Moore neighborhood of particle.
+        void getNeighborhood(Particle *particle, Neighborhood *neighbors);
+
+        // Load and save chemistry, including the reaction table.
         void load(FILE *fp);
         void save(FILE *fp);
 
     private:
 
+        // Neighborhood candidates from the physics grid.
+        std::vector<Particle *> candidates;
+
+        // Step particle.
+        void step(Particle *particle, Neighborhood *neighbors);
+
         // Particle reactions.
         void react(Neighborhood *neighbors);
+
+        // Apply matched reaction.
+        void apply(Particle *particle, Reaction *reaction,
+            Neighborhood *neighbors);
 };
 #endif
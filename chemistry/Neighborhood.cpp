@@ -43,6 +43,22 @@ void Neighborhood::clear()
 }
 
 
+// Number of particles in neighborhood.
+int Neighborhood::size()
+{
+    int x,y,n;
+
+    for (x = n = 0; x < 3; x++)
+    {
+        for (y = 0; y < 3; y++)
+        {
+            n += (int)particles[x][y].size();
+        }
+    }
+    return n;
+}
+
+
 // Transform neighborhood.
 void Neighborhood::transform(Orientation &orientation)
 {
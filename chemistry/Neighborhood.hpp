@@ -41,6 +41,9 @@ class Neighborhood
         // Clear.
         void clear();
 
+        // Number of particles in neighborhood.
+        int size();
+
         // Transform neighborhood by given orientation.
         void transform(Orientation &orientation);
 
@@ -197,7 +197,7 @@ Reaction *Reaction::read(FILE *fp)
     if (len > 0)
     {
         fgetc(fp);
-        reaction->description = new char[len] + 2;
+        reaction->description = new char[len + 2];
         assert(reaction->description != NULL);
         fgets(reaction->description , len + 2 , fp);
         reaction->description[len] = '\0';
@@ -252,7 +252,7 @@ void Reaction::write(FILE *fp, Reaction *reaction)
     }
     else
     {
-        fprintf(fp, "%d %s\n", strlen(reaction->description),
+        fprintf(fp, "%d %s\n", (int)strlen(reaction->description),
             reaction->description);
     }
     for (x = 0; x < 3; x++)
@@ -286,7 +286,7 @@ void Reaction::write(FILE *fp, Reaction *reaction)
     }
     fprintf(fp, "%d ", reaction->sourceBond);
     fprintf(fp, "%d ", reaction->targetBond);
-    fprintf(fp, "%s\n", reaction->bondStrength);
+    fprintf(fp, "%f\n", reaction->bondStrength);
     fflush(fp);
 }
 
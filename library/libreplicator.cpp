@@ -0,0 +1,252 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Replicator library.
+ * Worlds are automata; particle handles are the particles themselves.
+ */
+
+#include <stdio.h>
+#include <assert.h>
+#include "libreplicator.h"
+#include "../base/Automaton.hpp"
+
+// Handle conversions.
+static inline Automaton *automatonOf(ReplicatorWorld *world)
+{
+    return (Automaton *)world;
+}
+
+
+static inline Particle *particleOf(ReplicatorParticle *particle)
+{
+    return (Particle *)particle;
+}
+
+
+static inline const Particle *particleOf(const ReplicatorParticle *particle)
+{
+    return (const Particle *)particle;
+}
+
+
+static inline const ReplicatorParticle *handleOf(const Particle *particle)
+{
+    return (const ReplicatorParticle *)particle;
+}
+
+
+// Create world.
+ReplicatorWorld *replicator_create(int width, int height,
+int maxParticles, long seed)
+{
+    Automaton *automaton;
+
+    if (width < 1 || height < 1 || maxParticles < 1) return NULL;
+    automaton = new Automaton();
+    assert(automaton != NULL);
+    automaton->physics.setSize(width, height);
+    automaton->physics.maxParticles = maxParticles;
+    automaton->physics.random.setRand(seed);
+    return (ReplicatorWorld *)automaton;
+}
+
+
+// Destroy world.
+void replicator_destroy(ReplicatorWorld *world)
+{
+    if (world != NULL) delete automatonOf(world);
+}
+
+
+// Load reaction table.
+int replicator_load_reactions(ReplicatorWorld *world, const char *fileName)
+{
+    FILE *fp;
+    Chemistry *chemistry = &automatonOf(world)->chemistry;
+
+    if ((fp = fopen(fileName, "r")) == NULL) return 0;
+    chemistry->load(fp);
+    fclose(fp);
+    return chemistry->numReactions > 0 ? 1 : 0;
+}
+
+
+// Save reaction table.
+int replicator_save_reactions(ReplicatorWorld *world, const char *fileName)
+{
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "w")) == NULL) return 0;
+    automatonOf(world)->chemistry.save(fp);
+    fclose(fp);
+    return 1;
+}
+
+
+// Load run.
+int replicator_load(ReplicatorWorld *world, const char *fileName)
+{
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "r")) == NULL) return 0;
+    automatonOf(world)->load(fp);
+    fclose(fp);
+    return 1;
+}
+
+
+// Save run.
+int replicator_save(ReplicatorWorld *world, const char *fileName)
+{
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "w")) == NULL) return 0;
+    automatonOf(world)->save(fp);
+    fclose(fp);
+    return 1;
+}
+
+
+// Step cycles.
+void replicator_step(ReplicatorWorld *world, int cycles)
+{
+    Automaton *automaton = automatonOf(world);
+
+    for (int i = 0; i < cycles; i++)
+    {
+        automaton->step();
+    }
+}
+
+
+// Counts.
+int replicator_num_particles(ReplicatorWorld *world)
+{
+    return automatonOf(world)->physics.numParticles;
+}
+
+
+int replicator_num_molecules(ReplicatorWorld *world)
+{
+    return automatonOf(world)->physics.getNumMolecules();
+}
+
+
+int replicator_species_count(ReplicatorWorld *world, int type, int state)
+{
+    return automatonOf(world)->physics.getSpeciesCount(type, state);
+}
+
+
+// Add particle.
+ReplicatorParticle *replicator_add_particle(ReplicatorWorld *world,
+int type, int state, float x, float y)
+{
+    Physics *physics = &automatonOf(world)->physics;
+    Particle *particle;
+
+    if ((particle = physics->createParticle(type)) == NULL) return NULL;
+    physics->setState(particle, state);
+    particle->vPosition.x = x;
+    particle->vPosition.y = y;
+    return (ReplicatorParticle *)particle;
+}
+
+
+// Bond particles.
+int replicator_bond(ReplicatorWorld *world, ReplicatorParticle *particle1,
+int direction1, ReplicatorParticle *particle2, int direction2)
+{
+    if (direction1 < 0 || direction1 > 7 || direction2 < 0 || direction2 > 7)
+    {
+        return 0;
+    }
+    return automatonOf(world)->physics.createBond(particleOf(particle1), direction1,
+        particleOf(particle2), direction2) ? 1 : 0;
+}
+
+
+// Particle iteration.
+const ReplicatorParticle *replicator_first_particle(ReplicatorWorld *world)
+{
+    return handleOf(automatonOf(world)->physics.particles);
+}
+
+
+const ReplicatorParticle *replicator_next_particle(const ReplicatorParticle *particle)
+{
+    return handleOf(particleOf(particle)->next);
+}
+
+
+// Particle fields.
+int replicator_particle_id(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->id;
+}
+
+
+int replicator_particle_type(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->type;
+}
+
+
+int replicator_particle_state(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->state;
+}
+
+
+int replicator_particle_direction(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->orientation.direction;
+}
+
+
+int replicator_particle_mirrored(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->orientation.mirrored ? 1 : 0;
+}
+
+
+const float *replicator_particle_position(const ReplicatorParticle *particle)
+{
+    return &particleOf(particle)->vPosition.x;
+}
+
+
+const float *replicator_particle_velocity(const ReplicatorParticle *particle)
+{
+    return &particleOf(particle)->vVelocity.x;
+}
+
+
+int replicator_particle_molecule(const ReplicatorParticle *particle)
+{
+    return particleOf(particle)->molecule;
+}
+
+
+// Bond partner.
+const ReplicatorParticle *replicator_particle_bond(const ReplicatorParticle *particle,
+int direction)
+{
+    if (direction < 0 || direction > 7) return NULL;
+    return handleOf(particleOf(particle)->bonds[direction]);
+}
@@ -0,0 +1,94 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Replicator library.
+ * C interface for running simulations from another program: create a
+ * world, load reactions or a saved run, add and bond particles, step,
+ * and read particles and bonds where the simulation keeps them, without
+ * copying. A particle handle is valid until the particle is destroyed,
+ * which a reaction can do during a step; walk the particles again after
+ * each step. Positions and velocities are DIMENSIONS floats.
+ * The library does not use OpenGL or GLUT.
+ */
+
+#ifndef __LIBREPLICATOR__
+#define __LIBREPLICATOR__
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef struct ReplicatorWorld ReplicatorWorld;
+typedef struct ReplicatorParticle ReplicatorParticle;
+
+// Create world of given size (cells) and particle limit, seeded.
+ReplicatorWorld *replicator_create(int width, int height,
+    int maxParticles, long seed);
+
+// Destroy world.
+void replicator_destroy(ReplicatorWorld *world);
+
+// Load and save the reaction table (returns 1 on success, else 0).
+int replicator_load_reactions(ReplicatorWorld *world, const char *fileName);
+int replicator_save_reactions(ReplicatorWorld *world, const char *fileName);
+
+// Load and save a run: particles, bonds, reactions and random state
+// (returns 1 on success, else 0).
+int replicator_load(ReplicatorWorld *world, const char *fileName);
+int replicator_save(ReplicatorWorld *world, const char *fileName);
+
+// Step given number of cycles.
+void replicator_step(ReplicatorWorld *world, int cycles);
+
+// Counts.
+int replicator_num_particles(ReplicatorWorld *world);
+int replicator_num_molecules(ReplicatorWorld *world);
+int replicator_species_count(ReplicatorWorld *world, int type, int state);
+
+// Add particle at position (NULL if at the particle limit).
+ReplicatorParticle *replicator_add_particle(ReplicatorWorld *world,
+    int type, int state, float x, float y);
+
+// Bond particles in given directions (0-7, clockwise from up)
+// (returns 1 on success, else 0).
+int replicator_bond(ReplicatorWorld *world, ReplicatorParticle *particle1,
+    int direction1, ReplicatorParticle *particle2, int direction2);
+
+// Particle iteration (NULL at end).
+const ReplicatorParticle *replicator_first_particle(ReplicatorWorld *world);
+const ReplicatorParticle *replicator_next_particle(const ReplicatorParticle *particle);
+
+// Particle fields.
+int replicator_particle_id(const ReplicatorParticle *particle);
+int replicator_particle_type(const ReplicatorParticle *particle);
+int replicator_particle_state(const ReplicatorParticle *particle);
+int replicator_particle_direction(const ReplicatorParticle *particle);
+int replicator_particle_mirrored(const ReplicatorParticle *particle);
+const float *replicator_particle_position(const ReplicatorParticle *particle);
+const float *replicator_particle_velocity(const ReplicatorParticle *particle);
+int replicator_particle_molecule(const ReplicatorParticle *particle);
+
+// Bond partner in given direction (NULL = none).
+const ReplicatorParticle *replicator_particle_bond(const ReplicatorParticle *particle,
+    int direction);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -25,13 +25,38 @@
  *    [-numReplicators <number of replicator molecules>]
  *    [-numCatalysts <number of catalysts>]
  *    [-numComponents <number of free components>]
+ *    [-width <world width> (default: 20)]
+ *    [-height <world height> (default: 20)]
+ *    [-maxParticles <particle limit> (default: 5000)]
+ *    [-seed <random seed> (default: time)]
+ *    [-periodic (world wraps around at its edges)]
+ *    [-verlet <skin distance> (collision neighbor lists)]
+ *    [-chargeCutoff <distance> (charge forces within distance; requires verlet)]
+ *    [-vectorKernels (integrate and bond forces with vector kernels)]
+ *    [-sleep (do not step tiles of free particles at rest)]
+ *    [-sleepParticles (do not integrate particles at rest)]
  *    [-input <input file name> (for run continuation)]
  *    [-output <output file name> (to save run)]
  *    [-logfile <log file name>]
+ *    [-trajectory <trajectory file name>]
+ *    [-trajectoryInterval <cycles between trajectory frames>]
+ *    [-census <census file name> (CSV)]
+ *    [-censusInterval <cycles between census rows>]
+ *    [-bench <benchmark summary file name> (JSON)]
+ *    [-benchCounters (add hardware counters to benchmark)]
+ *    [-trace <timeline trace file name> (Chrome trace JSON)]
+ *    [-ensemble <number of replicas> (run replicas in parallel)]
+ *    [-threads <number of ensemble threads> (default: all cores)]
+ *    [-sweep <physics parameter sweep file> (ensemble per parameter set)]
+ *    [-results <ensemble results file name> (CSV)]
+ *    [-domain <number of strips> (run strips in worker processes)]
+ *    [-lockstep (compare with reference physics each cycle)]
+ *    [-lockstepResume <cycle> (compare with run saved and resumed at cycle)]
  *    [-display (GUI)]
  *    [-pause (start in pause mode)]
  */
 
+#include <unordered_map>
 #include "../util/Driver.h"
 
 // Particle types.
@@ -57,9 +82,10 @@ struct ParticleColor
 #define BOND_STATE 1
 #define HANDOFF_STATE 2
 #define UNBOND_STATE 3
+#define NUM_STATES 4
 
 // Usage.
-char *Usage = "Replicator -cycles <reaction cycles>\n\t[-numReplicators <number of replicator molecules>]\n\t[-numCatalysts <number of catalysts>]\n\t[-numComponents <number of free components>]\n\t[-input <input file name> (for run continuation)]\n\t[-output <output file name> (to save run)]\n\t[-logfile <log file name>]\n\t[-display (GUI)]\n\t[-pause (start in pause mode)]";
+char *Usage = "Replicator -cycles <reaction cycles>\n\t[-numReplicators <number of replicator molecules>]\n\t[-numCatalysts <number of catalysts>]\n\t[-numComponents <number of free components>]\n\t[-width <world width> (default: 20)]\n\t[-height <world height> (default: 20)]\n\t[-maxParticles <particle limit> (default: 5000)]\n\t[-seed <random seed> (default: time)]\n\t[-periodic (world wraps around at its edges)]\n\t[-verlet <skin distance> (collision neighbor lists)]\n\t[-chargeCutoff <distance> (charge forces within distance; requires verlet)]\n\t[-vectorKernels (integrate and bond forces with vector kernels)]\n\t[-sleep (do not step tiles of free particles at rest)]\n\t[-sleepParticles (do not integrate particles at rest)]\n\t[-input <input file name> (for run continuation)]\n\t[-output <output file name> (to save run)]\n\t[-logfile <log file name>]\n\t[-trajectory <trajectory file name>]\n\t[-trajectoryInterval <cycles between trajectory frames>]\n\t[-census <census file name> (CSV)]\n\t[-censusInterval <cycles between census rows>]\n\t[-bench <benchmark summary file name> (JSON)]\n\t[-benchCounters (add hardware counters to benchmark)]\n\t[-trace <timeline trace file name> (Chrome trace JSON)]\n\t[-ensemble <number of replicas> (run replicas in parallel)]\n\t[-threads <number of ensemble threads> (default: all cores)]\n\t[-sweep <physics parameter sweep file> (ensemble per parameter set)]\n\t[-results <ensemble results file name> (CSV)]\n\t[-domain <number of strips> (run strips in worker processes)]\n\t[-lockstep (compare with reference physics each cycle)]\n\t[-lockstepResume <cycle> (compare with run saved and resumed at cycle)]\n\t[-display (GUI)]\n\t[-pause (start in pause mode)]";
 
 // Quantities.
 int NumReplicators;
@@ -67,16 +93,16 @@ int NumCatalysts;
 int NumComponents;
 
 // Create reactions.
-void createReactions();
+void createReactions(Chemistry *);
 
 // Create particles.
-void createParticles(int, int, int);
+void createParticles(Automaton *, int, int, int);
 #define MAX_PLACEMENT_TRIES 1000
-int placeMap[WIDTH][HEIGHT];
 
 int main(int argc, char *argv[])
 {
     int i;
+    bool seeded;
 
     // Logging to print.
     Log::LOGGING_FLAG = LOG_TO_PRINT;
@@ -122,6 +148,108 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        if (strcmp(argv[i], "-width") == 0)
+        {
+            i++;
+            WorldWidth = atoi(argv[i]);
+            if (WorldWidth < 2)
+            {
+                sprintf(Log::messageBuf, "%s: invalid width", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-height") == 0)
+        {
+            i++;
+            WorldHeight = atoi(argv[i]);
+            if (WorldHeight < 4)
+            {
+                sprintf(Log::messageBuf, "%s: invalid height", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-maxParticles") == 0)
+        {
+            i++;
+            MaxParticles = atoi(argv[i]);
+            if (MaxParticles < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid maximum particles", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-seed") == 0)
+        {
+            i++;
+            RandomSeed = atol(argv[i]);
+            if (RandomSeed < 0)
+            {
+                sprintf(Log::messageBuf, "%s: invalid random seed", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-periodic") == 0)
+        {
+            Periodic = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-verlet") == 0)
+        {
+            i++;
+            VerletSkin = (float)atof(argv[i]);
+            if (VerletSkin <= 0.0f)
+            {
+                sprintf(Log::messageBuf, "%s: invalid verlet skin", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-chargeCutoff") == 0)
+        {
+            i++;
+            ChargeCutoff = (float)atof(argv[i]);
+            if (ChargeCutoff <= 0.0f)
+            {
+                sprintf(Log::messageBuf, "%s: invalid charge cutoff", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-vectorKernels") == 0)
+        {
+            VectorKernels = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-sleep") == 0)
+        {
+            Sleep = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-sleepParticles") == 0)
+        {
+            SleepParticles = true;
+            continue;
+        }
+
         if (strcmp(argv[i], "-input") == 0)
         {
             i++;
@@ -144,6 +272,139 @@ int main(int argc, char *argv[])
             continue;
         }
 
+        if (strcmp(argv[i], "-trajectory") == 0)
+        {
+            i++;
+            TrajectoryFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-trajectoryInterval") == 0)
+        {
+            i++;
+            TrajectoryInterval = atoi(argv[i]);
+            if (TrajectoryInterval < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid trajectory interval", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-census") == 0)
+        {
+            i++;
+            CensusFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-censusInterval") == 0)
+        {
+            i++;
+            CensusInterval = atoi(argv[i]);
+            if (CensusInterval < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid census interval", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-bench") == 0)
+        {
+            i++;
+            BenchmarkFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-benchCounters") == 0)
+        {
+            BenchmarkCounters = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-trace") == 0)
+        {
+            i++;
+            TraceFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-ensemble") == 0)
+        {
+            i++;
+            EnsembleSize = atoi(argv[i]);
+            if (EnsembleSize < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid number of replicas", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-threads") == 0)
+        {
+            i++;
+            EnsembleThreads = atoi(argv[i]);
+            if (EnsembleThreads < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid number of threads", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-sweep") == 0)
+        {
+            i++;
+            SweepFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-results") == 0)
+        {
+            i++;
+            ResultsFileName = argv[i];
+            continue;
+        }
+
+        if (strcmp(argv[i], "-domain") == 0)
+        {
+            i++;
+            DomainStrips = atoi(argv[i]);
+            if (DomainStrips < 1)
+            {
+                sprintf(Log::messageBuf, "%s: invalid domain strips", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            continue;
+        }
+
+        if (strcmp(argv[i], "-lockstep") == 0)
+        {
+            LockstepMode = true;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-lockstepResume") == 0)
+        {
+            i++;
+            LockstepResume = atoi(argv[i]);
+            if (LockstepResume < 0)
+            {
+                sprintf(Log::messageBuf, "%s: invalid lockstep resume cycle", argv[0]);
+                Log::logError();
+                exit(1);
+            }
+            LockstepMode = true;
+            continue;
+        }
+
         if (strcmp(argv[i], "-display") == 0)
         {
             Display = true;
@@ -186,6 +447,89 @@ int main(int argc, char *argv[])
         exit(1);
     }
 
+    if (Display && BenchmarkFileName != NULL)
+    {
+        sprintf(Log::messageBuf, "\nBenchmark option not valid with display");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    // A sweep runs an ensemble per parameter set.
+    if (SweepFileName != NULL && EnsembleSize == 0) EnsembleSize = 1;
+
+    if (EnsembleSize > 0 && (Display || OutputFileName != NULL ||
+        TrajectoryFileName != NULL || CensusFileName != NULL ||
+        BenchmarkFileName != NULL))
+    {
+        sprintf(Log::messageBuf, "\nEnsemble option not valid with display, output, trajectory, census or bench");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (DomainStrips > 0 && (Display || EnsembleSize > 0 ||
+        TrajectoryFileName != NULL || CensusFileName != NULL ||
+        BenchmarkFileName != NULL || TraceFileName != NULL ||
+        Sleep || SleepParticles || Periodic))
+    {
+        sprintf(Log::messageBuf, "\nDomain option not valid with display, ensemble, sweep, trajectory, census, bench, trace, sleep or periodic");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (LockstepMode && (Display || EnsembleSize > 0 || DomainStrips > 0 ||
+        OutputFileName != NULL || TrajectoryFileName != NULL ||
+        CensusFileName != NULL || BenchmarkFileName != NULL ||
+        TraceFileName != NULL || SleepParticles))
+    {
+        sprintf(Log::messageBuf, "\nLockstep option not valid with display, ensemble, sweep, domain, output, trajectory, census, bench, trace or sleepParticles");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (LockstepResume > Cycles)
+    {
+        sprintf(Log::messageBuf, "\nLockstep resume cycle beyond reaction cycles");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (EnsembleSize == 0 && (EnsembleThreads > 0 || ResultsFileName != NULL))
+    {
+        sprintf(Log::messageBuf, "\nThreads and results options require ensemble or sweep option");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (ChargeCutoff > 0.0f && VerletSkin == 0.0f)
+    {
+        sprintf(Log::messageBuf, "\nCharge cutoff option requires verlet option");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
+    if (BenchmarkCounters && BenchmarkFileName == NULL)
+    {
+        sprintf(Log::messageBuf, "\nBenchmark counters option requires benchmark option");
+        Log::logError();
+        sprintf(Log::messageBuf, "\nUsage: %s", Usage);
+        Log::logError();
+        exit(1);
+    }
+
     if (InputFileName == NULL)
     {
         if (NumReplicators < 0 || NumCatalysts < 0 || NumComponents < 0)
@@ -208,63 +552,101 @@ int main(int argc, char *argv[])
     }
 
     // Create particle colors.
+    Random colorRandom;
     for (i = 0; i < NUM_PARTICLE_TYPES; i++)
     {
-        ParticleColors[i].r = ((float)Random::nextDouble() * 0.5f) + 0.5f;
-        ParticleColors[i].g = ((float)Random::nextDouble() * 0.5f) + 0.5f;
-        ParticleColors[i].b = ((float)Random::nextDouble() * 0.5f) + 0.5f;
+        ParticleColors[i].r = ((float)colorRandom.nextDouble() * 0.5f) + 0.5f;
+        ParticleColors[i].g = ((float)colorRandom.nextDouble() * 0.5f) + 0.5f;
+        ParticleColors[i].b = ((float)colorRandom.nextDouble() * 0.5f) + 0.5f;
     }
 
-    // Seed random numbers.
-    Random::setRand(time(NULL));
+    // Census covers all particle types and states.
+    CensusTypes = NUM_PARTICLE_TYPES;
+    CensusStates = NUM_STATES;
 
     // Create automaton containing chemistry.
     automaton = new Automaton();
     assert(automaton != NULL);
+    automaton->physics.setSize(WorldWidth, WorldHeight);
+    automaton->physics.maxParticles = MaxParticles;
+    automaton->physics.setPeriodic(Periodic);
+    automaton->physics.setVerlet(VerletSkin, ChargeCutoff);
+    automaton->physics.setVectorKernels(VectorKernels);
+    automaton->physics.setSleep(Sleep, FREE_STATE);
+    automaton->physics.setParticleSleep(SleepParticles);
 
-    // Create reactions.
-    createReactions();
+    // Seed random numbers.
+    // A continued run keeps its saved random sequence unless a seed is given.
+    seeded = (RandomSeed >= 0);
+    if (!seeded) RandomSeed = (long)time(NULL);
+    automaton->physics.random.setRand(RandomSeed);
 
     // Initialize run.
+    // In ensemble and lockstep modes the automaton only provides the
+    // reactions.
     if (InputFileName == NULL)
     {
+        // Create reactions.
+        createReactions(&automaton->chemistry);
+
         // Create particles.
-        createParticles(NumReplicators,
-            NumCatalysts, NumComponents);
+        if (EnsembleSize == 0 && !LockstepMode)
+        {
+            createParticles(automaton, NumReplicators,
+                NumCatalysts, NumComponents);
+        }
     }
     else
     {
         // Continue run.
         load(InputFileName);
+        if (seeded)
+        {
+            automaton->physics.random.setRand(RandomSeed);
+        }
+        else
+        {
+            RandomSeed = automaton->physics.random.getSeed();
+        }
+
+        // Create reactions if not saved with run.
+        if (automaton->chemistry.numReactions == 0)
+        {
+            createReactions(&automaton->chemistry);
+        }
     }
 
+    // Log seed for repeating the run.
+    sprintf(Log::messageBuf, "Random seed: %ld", RandomSeed);
+    Log::logInformation();
+
     // Run.
     return driver(argc, argv, "Replicator");
 }
 
 
 // Create reactions.
-void createReactions()
+void createReactions(Chemistry *chemistry)
 {
     int n;
     Reaction *reaction;
 
     // Allocate reactions.
-    automaton->chemistry.numReactions = 62;
-    automaton->chemistry.reactions =
-        new Reaction*[automaton->chemistry.numReactions];
-    assert(automaton->chemistry.reactions != NULL);
-    for (n = 0; n < automaton->chemistry.numReactions; n++)
+    chemistry->numReactions = 62;
+    chemistry->reactions =
+        new Reaction*[chemistry->numReactions];
+    assert(chemistry->reactions != NULL);
+    for (n = 0; n < chemistry->numReactions; n++)
     {
-        automaton->chemistry.reactions[n] = new Reaction();
-        assert(automaton->chemistry.reactions[n] != NULL);
+        chemistry->reactions[n] = new Reaction();
+        assert(chemistry->reactions[n] != NULL);
     }
     n = 0;
 
     // Particle A:
 
     // Present catalyst to B.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = A_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -279,7 +661,7 @@ void createReactions()
     #endif
 
     // Handoff catalyst to B.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][0] = CATALYST_TYPE;
     reaction->types[1][1] = A_TYPE;
     reaction->types[1][0] = B_TYPE;
@@ -291,7 +673,7 @@ void createReactions()
     reaction->sourceBond = SOUTHWEST;
 
     // Unbond from W.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = A_TYPE;
     reaction->types[2][1] = W_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -300,7 +682,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = EAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = A_TYPE;
     reaction->types[2][1] = W_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -311,7 +693,7 @@ void createReactions()
     reaction->sourceBond = EAST;
 
     // Bond to free W.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = A_TYPE;
     reaction->types[2][1] = W_TYPE;
     reaction->types[1][0] = B_TYPE;
@@ -326,7 +708,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Create A-B bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = A_TYPE;
     reaction->types[1][0] = B_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -339,7 +721,7 @@ void createReactions()
     // Particle B:
 
     // Bond to catalyst presented by A.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = B_TYPE;
     reaction->types[1][2] = A_TYPE;
@@ -352,7 +734,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Present catalyst to C.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = B_TYPE;
     reaction->types[1][2] = A_TYPE;
@@ -363,7 +745,7 @@ void createReactions()
     reaction->sourceBond = SOUTHWEST;
     reaction->targetBond = NORTHEAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = B_TYPE;
     reaction->types[1][2] = A_TYPE;
@@ -374,7 +756,7 @@ void createReactions()
     reaction->sourceBond = WEST;
 
     // Handoff catalyst to C.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][0] = CATALYST_TYPE;
     reaction->types[1][1] = B_TYPE;
     reaction->types[1][0] = C_TYPE;
@@ -386,7 +768,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from X.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = B_TYPE;
     reaction->types[2][1] = X_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -395,7 +777,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = EAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = B_TYPE;
     reaction->types[2][1] = X_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -406,7 +788,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free X.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = B_TYPE;
     reaction->types[2][1] = X_TYPE;
     reaction->types[1][0] = C_TYPE;
@@ -421,7 +803,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Create B-C bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = B_TYPE;
     reaction->types[1][0] = C_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -434,7 +816,7 @@ void createReactions()
     // Particle C:
 
     // Bond to catalyst presented by B.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = C_TYPE;
     reaction->types[1][2] = B_TYPE;
@@ -447,7 +829,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Present catalyst to D.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = C_TYPE;
     reaction->types[1][2] = B_TYPE;
@@ -458,7 +840,7 @@ void createReactions()
     reaction->sourceBond = SOUTHWEST;
     reaction->targetBond = NORTHEAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = C_TYPE;
     reaction->types[1][2] = B_TYPE;
@@ -469,7 +851,7 @@ void createReactions()
     reaction->sourceBond = WEST;
 
     // Handoff catalyst to D.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][0] = CATALYST_TYPE;
     reaction->types[1][1] = C_TYPE;
     reaction->types[1][0] = D_TYPE;
@@ -481,7 +863,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from Y.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = C_TYPE;
     reaction->types[2][1] = Y_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -490,7 +872,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = EAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = C_TYPE;
     reaction->types[2][1] = Y_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -501,7 +883,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free Y.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = C_TYPE;
     reaction->types[2][1] = Y_TYPE;
     reaction->types[1][0] = D_TYPE;
@@ -516,7 +898,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Create C-D bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = C_TYPE;
     reaction->types[1][0] = D_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -529,7 +911,7 @@ void createReactions()
     // Particle D:
 
     // Bond to catalyst presented by C.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = D_TYPE;
     reaction->types[1][2] = C_TYPE;
@@ -542,7 +924,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Wait for handoff by C
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[0][1] = CATALYST_TYPE;
     reaction->types[1][1] = D_TYPE;
     reaction->types[1][2] = C_TYPE;
@@ -554,7 +936,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from Z.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = D_TYPE;
     reaction->types[2][1] = Z_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -563,7 +945,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = EAST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = D_TYPE;
     reaction->types[2][1] = Z_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -574,7 +956,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free Z.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = D_TYPE;
     reaction->types[2][1] = Z_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -589,7 +971,7 @@ void createReactions()
     // Particle W:
 
     // Present catalyst to X.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = W_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -600,7 +982,7 @@ void createReactions()
     reaction->targetBond = NORTHWEST;
 
     // Handoff catalyst to X.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][0] = CATALYST_TYPE;
     reaction->types[1][1] = W_TYPE;
     reaction->types[1][0] = X_TYPE;
@@ -612,7 +994,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from A.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = W_TYPE;
     reaction->types[0][1] = A_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -621,7 +1003,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = WEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = W_TYPE;
     reaction->types[0][1] = A_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -632,7 +1014,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free A.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = W_TYPE;
     reaction->types[0][1] = A_TYPE;
     reaction->types[1][0] = X_TYPE;
@@ -647,7 +1029,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Create W-X bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = W_TYPE;
     reaction->types[1][0] = X_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -660,7 +1042,7 @@ void createReactions()
     // Particle X:
 
     // Bond to catalyst presented by W.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = X_TYPE;
     reaction->types[1][2] = W_TYPE;
@@ -673,7 +1055,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Present catalyst to Y.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = X_TYPE;
     reaction->types[1][2] = W_TYPE;
@@ -684,7 +1066,7 @@ void createReactions()
     reaction->sourceBond = SOUTHEAST;
     reaction->targetBond = NORTHWEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = X_TYPE;
     reaction->types[1][2] = W_TYPE;
@@ -695,7 +1077,7 @@ void createReactions()
     reaction->sourceBond = EAST;
 
     // Handoff catalyst to Y.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][0] = CATALYST_TYPE;
     reaction->types[1][1] = X_TYPE;
     reaction->types[1][0] = Y_TYPE;
@@ -707,7 +1089,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from B.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = X_TYPE;
     reaction->types[0][1] = B_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -716,7 +1098,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = WEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = X_TYPE;
     reaction->types[0][1] = B_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -727,7 +1109,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free B.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = X_TYPE;
     reaction->types[0][1] = B_TYPE;
     reaction->types[1][0] = Y_TYPE;
@@ -742,7 +1124,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Create X-Y bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = X_TYPE;
     reaction->types[1][0] = Y_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -755,7 +1137,7 @@ void createReactions()
     // Particle Y:
 
     // Bond to catalyst presented by X.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[1][2] = X_TYPE;
@@ -768,7 +1150,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Present catalyst to Z.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[1][2] = X_TYPE;
@@ -779,7 +1161,7 @@ void createReactions()
     reaction->sourceBond = SOUTHEAST;
     reaction->targetBond = NORTHWEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[1][2] = X_TYPE;
@@ -790,7 +1172,7 @@ void createReactions()
     reaction->sourceBond = EAST;
 
     // Handoff catalyst to Z.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][0] = CATALYST_TYPE;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[1][0] = Z_TYPE;
@@ -802,7 +1184,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from C.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[0][1] = C_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -811,7 +1193,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = WEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[0][1] = C_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -822,7 +1204,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free C.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[0][1] = C_TYPE;
     reaction->types[1][0] = Z_TYPE;
@@ -837,7 +1219,7 @@ void createReactions()
     reaction->targetBond = EAST;
 
     // Create Y-Z bond.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Y_TYPE;
     reaction->types[1][0] = Z_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -850,7 +1232,7 @@ void createReactions()
     // Particle Z:
 
     // Bond to catalyst presented by Y.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = Z_TYPE;
     reaction->types[1][2] = Y_TYPE;
@@ -863,7 +1245,7 @@ void createReactions()
     reaction->targetBond = WEST;
 
     // Wait for handoff by Y
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[2][1] = CATALYST_TYPE;
     reaction->types[1][1] = Z_TYPE;
     reaction->types[1][2] = Y_TYPE;
@@ -875,7 +1257,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Unbond from D.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Z_TYPE;
     reaction->types[0][1] = D_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -884,7 +1266,7 @@ void createReactions()
     reaction->x = 1; reaction->y = 1;
     reaction->sourceBond = WEST;
 
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Z_TYPE;
     reaction->types[0][1] = D_TYPE;
     reaction->states[1][1] = BOND_STATE;
@@ -895,7 +1277,7 @@ void createReactions()
     reaction->sourceState = UNBOND_STATE;
 
     // Bond to free D.
-    reaction = automaton->chemistry.reactions[n]; n++;
+    reaction = chemistry->reactions[n]; n++;
     reaction->types[1][1] = Z_TYPE;
     reaction->types[0][1] = D_TYPE;
     reaction->states[1][1] = UNBOND_STATE;
@@ -909,42 +1291,58 @@ void createReactions()
 }
 
 
+// Sparse placement map: cell to particle type.
+typedef std::unordered_map<long long, int> PlaceMap;
+
+// Get placement (-1 = empty).
+static int getPlace(PlaceMap &placeMap, int x, int y)
+{
+    PlaceMap::iterator itr;
+
+    itr = placeMap.find(((long long)x << 32) | (long long)(unsigned int)y);
+    if (itr == placeMap.end()) return -1;
+    return itr->second;
+}
+
+
+// Set placement.
+static void setPlace(PlaceMap &placeMap, int x, int y, int type)
+{
+    placeMap[((long long)x << 32) | (long long)(unsigned int)y] = type;
+}
+
+
 // Configure particles.
-void createParticles(int numReplicators,
+void createParticles(Automaton *automaton, int numReplicators,
 int numCatalysts, int numComponents)
 {
     int i,j,k,dx,dy;
     Particle *a,*b,*c,*d,*w,*x,*y,*z;
-
-    // Clear placement placeMap.
-    for (dx = 0; dx < WIDTH; dx++)
-    {
-        for (dy = 0; dy < HEIGHT; dy++)
-        {
-            placeMap[dx][dy] = -1;
-        }
-    }
+    PlaceMap placeMap;
+    int width = automaton->physics.width;
+    int height = automaton->physics.height;
+    Random *random = &automaton->physics.random;
 
     // Create replicators.
     for (i = 0; i < numReplicators; i++)
     {
         for (j = 0; j < MAX_PLACEMENT_TRIES; j++)
         {
-            dx = Random::nextInt(WIDTH - 1);
-            dy = Random::nextInt(HEIGHT - 3) + 3;
-            if (placeMap[dx][dy] == -1 && placeMap[dx][dy-1] == -1 &&
-                placeMap[dx][dy-2] == -1 && placeMap[dx][dy-3] == -1 &&
-                placeMap[dx+1][dy] == -1 && placeMap[dx+1][dy-1] == -1 &&
-                placeMap[dx+1][dy-2] == -1 && placeMap[dx+1][dy-3] == -1)
+            dx = random->nextInt(width - 1);
+            dy = random->nextInt(height - 3) + 3;
+            if (getPlace(placeMap, dx, dy) == -1 && getPlace(placeMap, dx, dy-1) == -1 &&
+                getPlace(placeMap, dx, dy-2) == -1 && getPlace(placeMap, dx, dy-3) == -1 &&
+                getPlace(placeMap, dx+1, dy) == -1 && getPlace(placeMap, dx+1, dy-1) == -1 &&
+                getPlace(placeMap, dx+1, dy-2) == -1 && getPlace(placeMap, dx+1, dy-3) == -1)
             {
-                placeMap[dx][dy] = A_TYPE;
-                placeMap[dx][dy-1] = B_TYPE;
-                placeMap[dx][dy-2] = C_TYPE;
-                placeMap[dx][dy-3] = D_TYPE;
-                placeMap[dx+1][dy] = W_TYPE;
-                placeMap[dx+1][dy-1] = X_TYPE;
-                placeMap[dx+1][dy-2] = Y_TYPE;
-                placeMap[dx+1][dy-3] = Z_TYPE;
+                setPlace(placeMap, dx, dy, A_TYPE);
+                setPlace(placeMap, dx, dy-1, B_TYPE);
+                setPlace(placeMap, dx, dy-2, C_TYPE);
+                setPlace(placeMap, dx, dy-3, D_TYPE);
+                setPlace(placeMap, dx+1, dy, W_TYPE);
+                setPlace(placeMap, dx+1, dy-1, X_TYPE);
+                setPlace(placeMap, dx+1, dy-2, Y_TYPE);
+                setPlace(placeMap, dx+1, dy-3, Z_TYPE);
                 break;
             }
         }
@@ -952,42 +1350,42 @@ int numCatalysts, int numComponents)
 
         // Left half.
         a = automaton->physics.createParticle(A_TYPE);
-        a->state = BOND_STATE;
+        automaton->physics.setState(a, BOND_STATE);
         a->vPosition.x = POSITION(dx);
         a->vPosition.y = POSITION(dy);
         b = automaton->physics.createParticle(B_TYPE);
-        b->state = BOND_STATE;
+        automaton->physics.setState(b, BOND_STATE);
         b->vPosition.x = POSITION(dx);
         b->vPosition.y = POSITION(dy - 1);
         automaton->physics.createBond(a, SOUTH, b, NORTH);
         c = automaton->physics.createParticle(C_TYPE);
-        c->state = BOND_STATE;
+        automaton->physics.setState(c, BOND_STATE);
         c->vPosition.x = POSITION(dx);
         c->vPosition.y = POSITION(dy - 2);
         automaton->physics.createBond(b, SOUTH, c, NORTH);
         d = automaton->physics.createParticle(D_TYPE);
-        d->state = BOND_STATE;
+        automaton->physics.setState(d, BOND_STATE);
         d->vPosition.x = POSITION(dx);
         d->vPosition.y = POSITION(dy - 3);
         automaton->physics.createBond(c, SOUTH, d, NORTH);
 
         // Right half.
         w = automaton->physics.createParticle(W_TYPE);
-        w->state = BOND_STATE;
+        automaton->physics.setState(w, BOND_STATE);
         w->vPosition.x = POSITION(dx + 1);
         w->vPosition.y = POSITION(dy);
         x = automaton->physics.createParticle(X_TYPE);
-        x->state = BOND_STATE;
+        automaton->physics.setState(x, BOND_STATE);
         x->vPosition.x = POSITION(dx + 1);
         x->vPosition.y = POSITION(dy - 1);
         automaton->physics.createBond(w, SOUTH, x, NORTH);
         y = automaton->physics.createParticle(Y_TYPE);
-        y->state = BOND_STATE;
+        automaton->physics.setState(y, BOND_STATE);
         y->vPosition.x = POSITION(dx + 1);
         y->vPosition.y = POSITION(dy - 2);
         automaton->physics.createBond(x, SOUTH, y, NORTH);
         z = automaton->physics.createParticle(Z_TYPE);
-        z->state = BOND_STATE;
+        automaton->physics.setState(z, BOND_STATE);
         z->vPosition.x = POSITION(dx + 1);
         z->vPosition.y = POSITION(dy - 3);
         automaton->physics.createBond(y, SOUTH, z, NORTH);
@@ -1003,11 +1401,11 @@ int numCatalysts, int numComponents)
     {
         for (j = 0; j < MAX_PLACEMENT_TRIES; j++)
         {
-            dx = Random::nextInt(WIDTH - 1);
-            dy = Random::nextInt(HEIGHT - 3) + 3;
-            if (placeMap[dx][dy] == -1)
+            dx = random->nextInt(width - 1);
+            dy = random->nextInt(height - 3) + 3;
+            if (getPlace(placeMap, dx, dy) == -1)
             {
-                placeMap[dx][dy] = CATALYST_TYPE;
+                setPlace(placeMap, dx, dy, CATALYST_TYPE);
                 break;
             }
         }
@@ -1023,19 +1421,19 @@ int numCatalysts, int numComponents)
     {
         for (j = 0; j < MAX_PLACEMENT_TRIES; j++)
         {
-            dx = Random::nextInt(WIDTH - 1);
-            dy = Random::nextInt(HEIGHT - 3) + 3;
-            if (placeMap[dx][dy] == -1)
+            dx = random->nextInt(width - 1);
+            dy = random->nextInt(height - 3) + 3;
+            if (getPlace(placeMap, dx, dy) == -1)
             {
-                k = Random::nextInt(NUM_PARTICLE_TYPES - 1);
-                placeMap[dx][dy] = k;
+                k = random->nextInt(NUM_PARTICLE_TYPES - 1);
+                setPlace(placeMap, dx, dy, k);
                 break;
             }
         }
         if (j == MAX_PLACEMENT_TRIES) break;
 
         x = automaton->physics.createParticle(k);
-        x->state = FREE_STATE;
+        automaton->physics.setState(x, FREE_STATE);
         x->vPosition.x = POSITION(dx);
         x->vPosition.y = POSITION(dy);
     }
@@ -1074,30 +1472,62 @@ struct BondDisplay &display)
 }
 
 
-// Termination hook.
-void appTerminate(int code)
+// Initialize ensemble replica.
+void appInitReplica(Automaton *replica)
 {
-    Particle *particle;
-    int replicatorCount,strandCount;
+    FILE *fp;
 
-    // Count molecules.
-    replicatorCount = strandCount = 0;
-    for (particle = automaton->physics.particles;
-        particle != NULL; particle = particle->next)
+    if (InputFileName == NULL)
     {
-        if (particle->type == A_TYPE)
+        createParticles(replica, NumReplicators,
+            NumCatalysts, NumComponents);
+    }
+    else
+    {
+        if ((fp = fopen(InputFileName, "r")) == NULL)
         {
-            if (particle->state == BOND_STATE)
-            {
-                replicatorCount++;
-            } else if (particle->state == UNBOND_STATE)
-            {
-                strandCount++;
-            }
+            sprintf(Log::messageBuf, "Cannot load file %s", InputFileName);
+            Log::logError();
+            exit(1);
         }
+        replica->physics.load(fp);
+        fclose(fp);
+    }
+}
+
+
+// Census: count replicator and strand molecules (pairs) and free
+// components.
+int appCensus(Automaton *automaton, const char **names, int *values)
+{
+    Physics *physics = &automaton->physics;
+    int i,freeCount;
+
+    freeCount = 0;
+    for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+    {
+        freeCount += physics->getSpeciesCount(i, FREE_STATE);
     }
+    names[0] = "replicators";
+    values[0] = physics->getSpeciesCount(A_TYPE, BOND_STATE);
+    names[1] = "strands";
+    values[1] = physics->getSpeciesCount(A_TYPE, UNBOND_STATE);
+    names[2] = "free";
+    values[2] = freeCount;
+    return 3;
+}
+
+
+// Termination hook.
+void appTerminate(int code)
+{
+    const char *names[MAX_CENSUS];
+    int values[MAX_CENSUS];
+
+    // Count molecules.
+    appCensus(automaton, names, values);
     sprintf(Log::messageBuf, "Terminating: replicators=%d strands=%d (pairs)",
-        replicatorCount, strandCount);
+        values[0], values[1]);
     Log::logInformation();
 
     // Save run.
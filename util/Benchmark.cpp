@@ -0,0 +1,336 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Throughput benchmark.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include "Benchmark.hpp"
+#include "Log.hpp"
+
+// Constructor.
+Benchmark::Benchmark()
+{
+    int i,j;
+
+    startTime = getTime();
+    elapsedTime = 0.0;
+    particleUpdates = 0;
+    cycleStart = lastTime = startTime;
+    depth = 0;
+    counters = NULL;
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        phaseAccum[i] = 0.0;
+        for (j = 0; j < NUM_COUNTERS; j++)
+        {
+            phaseCounts[i][j] = 0;
+        }
+    }
+    for (j = 0; j < NUM_COUNTERS; j++)
+    {
+        lastCounts[j] = 0;
+    }
+}
+
+
+// Count hardware events per phase.
+void Benchmark::setCounters(PerfCounters *counters)
+{
+    this->counters = counters;
+    if (counters != NULL) counters->read(lastCounts);
+}
+
+
+// Charge counts since last reading to phase.
+void Benchmark::chargeCounts(int phase)
+{
+    int i;
+    long long counts[NUM_COUNTERS];
+
+    counters->read(counts);
+    for (i = 0; i < NUM_COUNTERS; i++)
+    {
+        if (phase != -1) phaseCounts[phase][i] += counts[i] - lastCounts[i];
+        lastCounts[i] = counts[i];
+    }
+}
+
+
+// Monotonic time in seconds.
+double Benchmark::getTime()
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Begin phase: charge elapsed time to enclosing phase.
+void Benchmark::beginPhase(int phase)
+{
+    double t = getTime();
+
+    if (depth > 0)
+    {
+        phaseAccum[phaseStack[depth - 1]] += t - lastTime;
+    }
+    if (counters != NULL)
+    {
+        chargeCounts((depth > 0 && depth <= MAX_PHASE_DEPTH) ?
+            phaseStack[depth - 1] : -1);
+    }
+    if (depth < MAX_PHASE_DEPTH)
+    {
+        phaseStack[depth] = phase;
+    }
+    depth++;
+    lastTime = t;
+}
+
+
+// End phase.
+void Benchmark::endPhase(int phase)
+{
+    double t = getTime();
+
+    if (depth > 0 && depth <= MAX_PHASE_DEPTH)
+    {
+        phaseAccum[phaseStack[depth - 1]] += t - lastTime;
+    }
+    if (counters != NULL)
+    {
+        chargeCounts((depth > 0 && depth <= MAX_PHASE_DEPTH) ?
+            phaseStack[depth - 1] : -1);
+    }
+    if (depth > 0) depth--;
+    lastTime = t;
+}
+
+
+// Begin cycle.
+void Benchmark::beginCycle(int numParticles)
+{
+    int i;
+
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        phaseAccum[i] = 0.0;
+    }
+    depth = 0;
+    particleUpdates += numParticles;
+    cycleStart = lastTime = getTime();
+}
+
+
+// End cycle.
+void Benchmark::endCycle()
+{
+    int i;
+    double t = getTime();
+
+    cycleTimes.push_back(t - cycleStart);
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        phaseTimes[i].push_back(phaseAccum[i]);
+    }
+    elapsedTime = t - startTime;
+}
+
+
+// Get mean, median and 99th percentile in microseconds.
+void Benchmark::getStats(std::vector<double> &samples,
+double &mean, double &p50, double &p99)
+{
+    int i,n;
+    std::vector<double> sorted;
+
+    mean = p50 = p99 = 0.0;
+    if ((n = (int)samples.size()) == 0) return;
+    sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    for (i = 0; i < n; i++)
+    {
+        mean += sorted[i];
+    }
+    mean = (mean / (double)n) * 1.0e6;
+    p50 = sorted[((n - 1) * 50) / 100] * 1.0e6;
+    p99 = sorted[((n - 1) * 99) / 100] * 1.0e6;
+}
+
+
+// Log summary.
+void Benchmark::report()
+{
+    int i,cycles;
+    double mean,p50,p99;
+    double ipc,cacheMisses,branchMisses;
+    char ipcBuf[20],cacheBuf[20],branchBuf[20];
+
+    cycles = (int)cycleTimes.size();
+    if (cycles == 0 || elapsedTime <= 0.0) return;
+    sprintf(Log::messageBuf, "Benchmark: cycles=%d seconds=%f cycles/sec=%f particle-updates/sec=%f",
+        cycles, elapsedTime, (double)cycles / elapsedTime,
+        (double)particleUpdates / elapsedTime);
+    Log::logInformation();
+    getStats(cycleTimes, mean, p50, p99);
+    sprintf(Log::messageBuf, "  %-14s mean=%10.3fus p50=%10.3fus p99=%10.3fus",
+        "cycle", mean, p50, p99);
+    Log::logInformation();
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        getStats(phaseTimes[i], mean, p50, p99);
+        sprintf(Log::messageBuf, "  %-14s mean=%10.3fus p50=%10.3fus p99=%10.3fus",
+            PhaseNames[i], mean, p50, p99);
+        Log::logInformation();
+    }
+
+    // Hardware counters.
+    if (counters == NULL) return;
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        getCounterStats(i, ipc, cacheMisses, branchMisses);
+        formatValue(ipcBuf, ipc);
+        formatValue(cacheBuf, cacheMisses);
+        formatValue(branchBuf, branchMisses);
+        sprintf(Log::messageBuf, "  %-14s ipc=%9s cache-misses/particle=%9s branch-misses/particle=%9s",
+            PhaseNames[i], ipcBuf, cacheBuf, branchBuf);
+        Log::logInformation();
+    }
+}
+
+
+// Get instructions per cycle and misses per particle update for phase.
+// Unavailable values are negative.
+void Benchmark::getCounterStats(int phase, double &ipc,
+double &cacheMisses, double &branchMisses)
+{
+    long long *counts = phaseCounts[phase];
+
+    ipc = cacheMisses = branchMisses = -1.0;
+    if (counters->isAvailable(COUNTER_CYCLES) &&
+        counters->isAvailable(COUNTER_INSTRUCTIONS) &&
+        counts[COUNTER_CYCLES] > 0)
+    {
+        ipc = (double)counts[COUNTER_INSTRUCTIONS] / (double)counts[COUNTER_CYCLES];
+    }
+    if (particleUpdates == 0) return;
+    if (counters->isAvailable(COUNTER_CACHE_MISSES))
+    {
+        cacheMisses = (double)counts[COUNTER_CACHE_MISSES] / (double)particleUpdates;
+    }
+    if (counters->isAvailable(COUNTER_BRANCH_MISSES))
+    {
+        branchMisses = (double)counts[COUNTER_BRANCH_MISSES] / (double)particleUpdates;
+    }
+}
+
+
+// Format counter statistic ("n/a" if negative).
+void Benchmark::formatValue(char *buf, double value)
+{
+    if (value < 0.0)
+    {
+        strcpy(buf, "n/a");
+    }
+    else
+    {
+        sprintf(buf, "%.3f", value);
+    }
+}
+
+
+// Write JSON value (null if negative).
+void Benchmark::writeValue(FILE *fp, const char *name, double value,
+const char *separator)
+{
+    if (value < 0.0)
+    {
+        fprintf(fp, "\"%s\": null%s", name, separator);
+    }
+    else
+    {
+        fprintf(fp, "\"%s\": %f%s", name, value, separator);
+    }
+}
+
+
+// Write JSON summary.
+bool Benchmark::write(char *fileName)
+{
+    int i,j,cycles;
+    double mean,p50,p99,rate;
+    double ipc,cacheMisses,branchMisses;
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "w")) == NULL) return false;
+    cycles = (int)cycleTimes.size();
+    rate = (elapsedTime > 0.0) ? 1.0 / elapsedTime : 0.0;
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"cycles\": %d,\n", cycles);
+    fprintf(fp, "  \"seconds\": %f,\n", elapsedTime);
+    fprintf(fp, "  \"cycles_per_second\": %f,\n", (double)cycles * rate);
+    fprintf(fp, "  \"particle_updates\": %lld,\n", particleUpdates);
+    fprintf(fp, "  \"particle_updates_per_second\": %f,\n",
+        (double)particleUpdates * rate);
+    getStats(cycleTimes, mean, p50, p99);
+    fprintf(fp, "  \"cycle_us\": { \"mean\": %f, \"p50\": %f, \"p99\": %f },\n",
+        mean, p50, p99);
+    fprintf(fp, "  \"phases_us\": {\n");
+    for (i = 0; i < NUM_PHASES; i++)
+    {
+        getStats(phaseTimes[i], mean, p50, p99);
+        fprintf(fp, "    \"%s\": { \"mean\": %f, \"p50\": %f, \"p99\": %f }%s\n",
+            PhaseNames[i], mean, p50, p99, (i < NUM_PHASES - 1) ? "," : "");
+    }
+    if (counters == NULL)
+    {
+        fprintf(fp, "  }\n");
+    }
+    else
+    {
+        // Hardware counters: totals, IPC and misses per particle update.
+        fprintf(fp, "  },\n");
+        fprintf(fp, "  \"phase_counters\": {\n");
+        for (i = 0; i < NUM_PHASES; i++)
+        {
+            fprintf(fp, "    \"%s\": { ", PhaseNames[i]);
+            for (j = 0; j < NUM_COUNTERS; j++)
+            {
+                if (counters->isAvailable(j))
+                {
+                    fprintf(fp, "\"%s\": %lld, ", CounterNames[j], phaseCounts[i][j]);
+                }
+                else
+                {
+                    fprintf(fp, "\"%s\": null, ", CounterNames[j]);
+                }
+            }
+            getCounterStats(i, ipc, cacheMisses, branchMisses);
+            writeValue(fp, "ipc", ipc, ", ");
+            writeValue(fp, "cache_misses_per_particle", cacheMisses, ", ");
+            writeValue(fp, "branch_misses_per_particle", branchMisses, " ");
+            fprintf(fp, "}%s\n", (i < NUM_PHASES - 1) ? "," : "");
+        }
+        fprintf(fp, "  }\n");
+    }
+    fprintf(fp, "}\n");
+    fclose(fp);
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Throughput benchmark.
+ * Measures cycle rate, particle update rate and the time spent in
+ * each simulation phase per cycle. Nested phases are timed exclusively:
+ * time spent in an inner phase is not charged to the outer one.
+ * Optionally, hardware counters are charged to phases the same way.
+ */
+
+#ifndef __BENCHMARK__
+#define __BENCHMARK__
+
+#include <stdio.h>
+#include <vector>
+#include "../base/Profiler.hpp"
+#include "PerfCounters.hpp"
+
+// Maximum phase nesting.
+#define MAX_PHASE_DEPTH 8
+
+class Benchmark : public Profiler
+{
+    public:
+
+        // Constructor.
+        Benchmark();
+
+        // Count hardware events per phase (NULL to disable).
+        void setCounters(PerfCounters *counters);
+
+        // Phase timing.
+        void beginPhase(int phase);
+        void endPhase(int phase);
+
+        // Cycle timing.
+        void beginCycle(int numParticles);
+        void endCycle();
+
+        // Log summary.
+        void report();
+
+        // Write JSON summary.
+        bool write(char *fileName);
+
+        // Monotonic time in seconds.
+        static double getTime();
+
+    private:
+
+        // Run totals.
+        double startTime;
+        double elapsedTime;
+        long long particleUpdates;
+
+        // Per-cycle samples.
+        std::vector<double> cycleTimes;
+        std::vector<double> phaseTimes[NUM_PHASES];
+
+        // Current cycle.
+        double cycleStart;
+        double phaseAccum[NUM_PHASES];
+
+        // Phase stack.
+        int phaseStack[MAX_PHASE_DEPTH];
+        int depth;
+        double lastTime;
+
+        // Hardware counter run totals per phase.
+        PerfCounters *counters;
+        long long lastCounts[NUM_COUNTERS];
+        long long phaseCounts[NUM_PHASES][NUM_COUNTERS];
+
+        // Charge counts since last reading to phase (-1 for none).
+        void chargeCounts(int phase);
+
+        // Counter statistics for phase (negative if unavailable).
+        void getCounterStats(int phase, double &ipc,
+            double &cacheMisses, double &branchMisses);
+
+        // Format statistic ("n/a" if negative).
+        static void formatValue(char *buf, double value);
+
+        // Write JSON value (null if negative).
+        static void writeValue(FILE *fp, const char *name, double value,
+            const char *separator);
+
+        // Statistics (microseconds).
+        static void getStats(std::vector<double> &samples,
+            double &mean, double &p50, double &p99);
+};
+#endif
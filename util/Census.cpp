@@ -0,0 +1,123 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Census stream.
+ */
+
+#include <stdio.h>
+#include "Census.hpp"
+
+// Constructor.
+Census::Census(int numTypes, int numStates)
+{
+    this->numTypes = numTypes;
+    this->numStates = numStates;
+    fp = NULL;
+    interval = 1;
+    census = NULL;
+    header = false;
+}
+
+
+// Destructor.
+Census::~Census()
+{
+    close();
+}
+
+
+// Open census file.
+bool Census::open(char *fileName, int interval, ReplicaCensus census)
+{
+    if ((fp = fopen(fileName, "w")) == NULL) return false;
+    this->interval = interval;
+    this->census = census;
+    header = false;
+    return true;
+}
+
+
+// Record row if cycle is on the interval.
+void Census::record(int cycle, Automaton *automaton)
+{
+    Physics *physics = &automaton->physics;
+    const char *names[MAX_CENSUS];
+    int values[MAX_CENSUS];
+    int i,j,n,larger;
+
+    if (fp == NULL || (cycle % interval) != 0) return;
+    n = 0;
+    if (census != NULL) n = census(automaton, names, values);
+
+    // Header names the application's values.
+    if (!header)
+    {
+        fprintf(fp, "cycle,particles,molecules");
+        for (i = 0; i < n; i++)
+        {
+            fprintf(fp, ",%s", names[i]);
+        }
+        for (i = 0; i < numTypes; i++)
+        {
+            for (j = 0; j < numStates; j++)
+            {
+                fprintf(fp, ",type%d_state%d", i, j);
+            }
+        }
+        for (i = 1; i < CENSUS_MAX_SIZE; i++)
+        {
+            fprintf(fp, ",size%d", i);
+        }
+        fprintf(fp, ",size%d+\n", CENSUS_MAX_SIZE);
+        header = true;
+    }
+
+    fprintf(fp, "%d,%d,%d", cycle, physics->numParticles, physics->getNumMolecules());
+    for (i = 0; i < n; i++)
+    {
+        fprintf(fp, ",%d", values[i]);
+    }
+    for (i = 0; i < numTypes; i++)
+    {
+        for (j = 0; j < numStates; j++)
+        {
+            fprintf(fp, ",%d", physics->getSpeciesCount(i, j));
+        }
+    }
+    for (i = 1; i < CENSUS_MAX_SIZE; i++)
+    {
+        fprintf(fp, ",%d", physics->getMoleculeCount(i));
+    }
+    larger = physics->getNumMolecules();
+    for (i = 1; i < CENSUS_MAX_SIZE; i++)
+    {
+        larger -= physics->getMoleculeCount(i);
+    }
+    fprintf(fp, ",%d\n", larger);
+}
+
+
+// Close.
+void Census::close()
+{
+    if (fp != NULL)
+    {
+        fclose(fp);
+        fp = NULL;
+    }
+}
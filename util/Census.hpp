@@ -0,0 +1,67 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Census stream.
+ * Every given number of cycles a CSV row is written with the number of
+ * particles and molecules, the application's census values, the number
+ * of particles of each type in each state, and the number of molecules
+ * of each size. The counts are kept up to date by the physics as
+ * particles, bonds, types and states change, so a row costs the same
+ * whatever the number of particles.
+ */
+
+#ifndef __CENSUS__
+#define __CENSUS__
+
+#include <stdio.h>
+#include "../base/Automaton.hpp"
+#include "Ensemble.hpp"
+
+// Molecule size columns: sizes 1 to CENSUS_MAX_SIZE - 1, then all larger.
+#define CENSUS_MAX_SIZE 16
+
+class Census
+{
+    public:
+
+        // Constructor: species columns for types and states below given.
+        Census(int numTypes, int numStates);
+
+        // Destructor.
+        ~Census();
+
+        // Open census file: record every interval cycles, with census
+        // values from the application (NULL for none).
+        bool open(char *fileName, int interval, ReplicaCensus census);
+
+        // Record row if cycle is on the interval.
+        void record(int cycle, Automaton *automaton);
+
+        // Close.
+        void close();
+
+    private:
+
+        FILE *fp;
+        int interval;
+        int numTypes;
+        int numStates;
+        ReplicaCensus census;
+        bool header;
+};
+#endif
@@ -0,0 +1,431 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/**
+ * Display front end: runs the reaction loop in a GLUT window.
+ * Headless builds link Headless.cpp in its place.
+ */
+
+#include <GL/gl.h>
+#include <GL/glu.h>
+#include <GL/glut.h>
+#include "Driver.h"
+
+// Draw grid?
+bool DrawGrid = false;
+
+// Run flags.
+bool Quit = false;
+bool Step = false;
+bool Progress = true;
+
+// Window size.
+#define WINDOW_WIDTH 550
+#define WINDOW_HEIGHT 550
+int WindowWidth = WINDOW_WIDTH;
+int WindowHeight = WINDOW_HEIGHT;
+float CellWidth = (float)WindowWidth / (float)WIDTH;
+float CellHeight = (float)WindowHeight / (float)HEIGHT;
+
+/*
+    Available fonts:
+    GLUT_BITMAP_8_BY_13
+    GLUT_BITMAP_9_BY_15
+    GLUT_BITMAP_TIMES_ROMAN_10
+    GLUT_BITMAP_TIMES_ROMAN_24
+    GLUT_BITMAP_HELVETICA_10
+    GLUT_BITMAP_HELVETICA_12
+    GLUT_BITMAP_HELVETICA_18
+*/
+#define SMALL_FONT GLUT_BITMAP_8_BY_13
+#define FONT GLUT_BITMAP_9_BY_15
+#define BIG_FONT GLUT_BITMAP_TIMES_ROMAN_24
+#define LINE_SPACE 15
+
+// User modes.
+typedef enum { RUN, HELP }
+USERMODE;
+USERMODE UserMode = RUN;
+
+// Control information.
+char *ControlInfo[] =
+{
+    "           h : Control help",
+    "           c : Toggle cycle display",
+    "           p : Toggle pause mode",
+    "           s : Toggle step mode",
+    "     <space> : Step",
+    "           q : Quit",
+#if ( INSTRUMENT == 1 )
+    "           i : Dump instrumentation",
+#endif
+    NULL
+};
+
+// GUI functions.
+void display(), drawParticle(Particle *);
+void idle();
+void reshape(int, int);
+void keyInput(unsigned char key, int x, int y);
+void helpInfo();
+void renderBitmapString(GLfloat, GLfloat, void *, char *);
+
+// Display driver.
+int displayDriver(int argc, char *argv[], char *appName)
+{
+    // Initialize display.
+    CellWidth = (float)WindowWidth / (float)automaton->physics.width;
+    CellHeight = (float)WindowHeight / (float)automaton->physics.height;
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGB | GLUT_DOUBLE);
+    glutInitWindowSize(WindowWidth, WindowHeight);
+    glutCreateWindow(appName);
+    glutDisplayFunc(display);
+    glutReshapeFunc(reshape);
+    glutKeyboardFunc(keyInput);
+    glutIdleFunc(idle);
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0.0f, (float)WindowWidth, 0.0f, (float)WindowHeight);
+    glScalef(1, -1, 1);
+    glTranslatef(0, -WindowHeight, 0);
+
+    // Start up.
+    glutMainLoop();
+    return 0;
+}
+
+
+// Display.
+void display()
+{
+    int i, x, y;
+    float x2, y2, x3, y3;
+    Particle *particle,*particle2;
+    Vector image;
+    char buf[50];
+    struct BondDisplay bondDisplay;
+
+    if (trace != NULL) trace->beginEvent("frame");
+    glClear(GL_COLOR_BUFFER_BIT);
+    glColor3f(0.0f, 0.0f, 0.0f);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+
+    // Draw automaton.
+    if (automaton != NULL)
+    {
+        glBegin(GL_LINES);
+        if (DrawGrid)
+        {
+            y2 = (float)WindowHeight;
+            for (x = 1, x2 = CellWidth - 1.0f; x < automaton->physics.width;
+                x++, x2 = (CellWidth * (float)x) - 1.0f)
+            {
+                glVertex2f(x2, 0.0f);
+                glVertex2f(x2, y2);
+            }
+            x2 = (float)WindowWidth;
+            for (y = 1, y2 = CellHeight - 1.0f; y < automaton->physics.height;
+                y++, y2 = (CellHeight * (float)y) - 1.0f)
+            {
+                glVertex2f(0.0f, y2);
+                glVertex2f(x2, y2);
+            }
+        }
+        else
+        {
+            glVertex2f(0.0f, 0.0f);
+            glVertex2f((float)WindowWidth, 0.0f);
+            glVertex2f(0.0f, (float)WindowHeight - 1.0f);
+            glVertex2f((float)WindowWidth, (float)WindowHeight - 1.0f);
+        }
+        glEnd();
+
+        for (particle = automaton->physics.particles; particle != NULL;
+            particle = particle->next)
+        {
+            drawParticle(particle);
+        }
+        for (particle = automaton->physics.particles; particle != NULL;
+            particle = particle->next)
+        {
+            for (i = 0; i < 8; i++)
+            {
+                if ((particle2 = particle->bonds[i]) == NULL) continue;
+                bondDisplay.r = bondDisplay.g = bondDisplay.b = 0.0f;
+                bondDisplay.repeat = 1;
+                bondDisplay.pattern = 0xffff;
+                appGetBondDisplay(particle->bondProperties[i], bondDisplay);
+                if (bondDisplay.pattern != 0xffff)
+                {
+                    glEnable(GL_LINE_STIPPLE);
+                    glLineStipple(bondDisplay.repeat, bondDisplay.pattern);
+                }
+                glBegin(GL_LINES);
+                glColor3f(bondDisplay.r, bondDisplay.g, bondDisplay.b);
+                x2 = CellWidth * particle->vPosition.x;
+                y2 = CellHeight * particle->vPosition.y;
+                y2 = WindowHeight - y2;
+                image = automaton->physics.getImage(particle2->vPosition,
+                    particle->vPosition);
+                x3 = CellWidth * image.x;
+                y3 = CellHeight * image.y;
+                y3 = WindowHeight - y3;
+                glVertex2f(x2, y2);
+                glVertex2f(x3, y3);
+                glEnd();
+                if (bondDisplay.pattern != 0xffff)
+                {
+                    glDisable(GL_LINE_STIPPLE);
+                }
+            }
+        }
+    }
+
+    // User messages.
+    glColor3f(0.0f, 0.0f, 0.0f);
+    renderBitmapString(5, 15, FONT, "h for help");
+    if (Step)
+    {
+        renderBitmapString(WINDOW_WIDTH - 60, WINDOW_HEIGHT -  10, FONT, "Step");
+    } else if (Pause)
+    {
+        renderBitmapString(WINDOW_WIDTH - 60, WINDOW_HEIGHT -  10, FONT, "Pause");
+    }
+    if (Progress)
+    {
+        sprintf(buf, "Cycle = %d/%d", CycleCount, Cycles);
+        renderBitmapString(5, WINDOW_HEIGHT - 10, FONT, buf);
+    }
+
+    glutSwapBuffers();
+    glFlush();
+    if (trace != NULL) trace->endEvent("frame");
+}
+
+
+// Draw a particle.
+void drawParticle(Particle *particle)
+{
+    struct ParticleDisplay display;
+
+    // Get application particle display specification.
+    display.r = display.g = display.b = 0.0f;
+    display.solid = false;
+    display.label = '\0';
+    appGetParticleDisplay(particle, display);
+
+    // Set particle color.
+    glColor3f(display.r, display.g, display.b);
+
+    // Draw particle.
+    if (display.solid)
+    {
+        glBegin(GL_POLYGON);
+    }
+    else
+    {
+        glBegin(GL_LINE_LOOP);
+    }
+    float x = CellWidth * particle->vPosition.x;
+    float y = CellHeight * particle->vPosition.y;
+    y = WindowHeight - y;
+    float rx = CellWidth * particle->fRadius;
+    float ry = CellHeight * particle->fRadius;
+
+    // Draw circle.
+    glVertex2f(x + rx, y);
+    int sides = 20;
+    float ad = 360.0f / (float)sides;
+    float a = ad;
+    for (int i = 1; i < sides; i++, a += ad)
+    {
+        glVertex2f(x + (rx * cos(DegreesToRadians(a))),
+            y + (ry * sin(DegreesToRadians(a))));
+    }
+    glEnd();
+
+    // Draw particle label.
+    if (display.solid) glColor3f(0.0f, 0.0f, 0.0f);
+    if (display.label != '\0')
+    {
+        char buf[2];
+        buf[0] = display.label;
+        buf[1] = '\0';
+        renderBitmapString(x - (CellWidth / 3.0), y + (CellHeight / 3.0), FONT, buf);
+    }
+}
+
+
+// Idle.
+void idle()
+{
+    // Done?
+    if (CycleCount >= Cycles || Quit) terminate(0);
+
+    if (UserMode == HELP)
+    {
+        helpInfo();
+
+    }
+    else
+    {
+
+        // Run a cycle.
+        if (!Pause)
+        {
+            automaton->step();
+            CycleCount++;
+            if (trajectory != NULL)
+            {
+                trajectory->record(CycleCount, &automaton->physics);
+            }
+            if (census != NULL) census->record(CycleCount, automaton);
+        }
+
+        #if ( INSTRUMENT == 1 )
+        if (DumpInstrument)
+        {
+            DumpInstrument = false;
+            Instrument::dump();
+        }
+        #endif
+
+        // Reset pause?
+        if (Step) Pause = true;
+
+        // Display.
+        display();
+    }
+}
+
+
+// Reshape window.
+void reshape(int w, int h)
+{
+    glViewport(0, 0, w, h);
+    WindowWidth = w;
+    WindowHeight = h;
+    if (automaton != NULL)
+    {
+        CellWidth = (float)WindowWidth / (float)automaton->physics.width;
+        CellHeight = (float)WindowHeight / (float)automaton->physics.height;
+    }
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    gluOrtho2D(0.0f, (float)WindowWidth, 0.0f, (float)WindowHeight);
+    glScalef(1, -1, 1);
+    glTranslatef(0, -WindowHeight, 0);
+}
+
+
+// Keyboard input.
+void keyInput(unsigned char key, int x, int y)
+{
+    if (key == 'q')
+    {
+        Quit = true;
+        return;
+    }
+    if (key == 'h')
+    {
+        UserMode = HELP;
+        return;
+    }
+    if (UserMode == HELP)
+    {
+        UserMode = RUN;
+        return;
+    }
+    if (key == 'c')
+    {
+        Progress = !Progress;
+        return;
+    }
+    if (key == 'p')
+    {
+        if (Step)
+        {
+            Step = false;
+            Pause = true;
+        }
+        else
+        {
+            Pause = !Pause;
+        }
+        return;
+    }
+    if (key == 's')
+    {
+        Step = !Step;
+        if (Step)
+        {
+            Pause = true;
+        }
+        else
+        {
+            Pause = false;
+        }
+        return;
+    }
+    if (key == ' ')
+    {
+        if (Step) Pause = false;
+        return;
+    }
+    #if ( INSTRUMENT == 1 )
+    if (key == 'i')
+    {
+        DumpInstrument = true;
+        return;
+    }
+    #endif
+}
+
+
+// Help for controls.
+void helpInfo()
+{
+    int i,v;
+
+    glClear(GL_COLOR_BUFFER_BIT);
+    glColor3f(0.0f, 0.0f, 0.0f);
+
+    v = 15;
+    renderBitmapString(5, v, FONT, "Controls:"); v += (2 * LINE_SPACE);
+    for (i = 0; ControlInfo[i] != NULL; i++)
+    {
+        renderBitmapString(5, v, FONT, ControlInfo[i]);
+        v += LINE_SPACE;
+    }
+
+    glutSwapBuffers();
+    glFlush();
+}
+
+
+// Print string on screen at specified location.
+void renderBitmapString(GLfloat x, GLfloat y, void *font, char *string)
+{
+    char *c;
+    glRasterPos2f(x, y);
+    for (c=string; *c != '\0'; c++)
+    {
+        glutBitmapCharacter(font, *c);
+    }
+}
@@ -0,0 +1,747 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Domain decomposition.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#ifdef UNIX
+#include <unistd.h>
+#endif
+#include "Domain.hpp"
+#include "Log.hpp"
+
+// Ghost edits.
+#define EDIT_SET 0                                // type, state, orientation
+#define EDIT_DESTROY 1
+#define EDIT_BOND 2                               // bond to remote partner
+#define EDIT_UNBOND 3
+
+// Constructor.
+Domain::Domain(int numStrips)
+{
+    this->numStrips = numStrips;
+    transport = NULL;
+    automaton = NULL;
+    physics = NULL;
+    rank = 0;
+    left = right = 0.0f;
+    numEdits[0] = numEdits[1] = 0;
+}
+
+
+// Destructor.
+Domain::~Domain()
+{
+    if (transport != NULL) delete transport;
+}
+
+
+// Run automaton decomposed into strips.
+bool Domain::run(Automaton *automaton, int cycles)
+{
+    #ifdef UNIX
+    SocketTransport *socketTransport;
+    bool ok;
+
+    this->automaton = automaton;
+    physics = &automaton->physics;
+    if (physics->width / numStrips < MIN_STRIP_WIDTH)
+    {
+        sprintf(Log::messageBuf, "Strips must be at least %d cells wide", MIN_STRIP_WIDTH);
+        Log::logError();
+        return false;
+    }
+    if ((socketTransport = SocketTransport::start(numStrips)) == NULL)
+    {
+        sprintf(Log::messageBuf, "Cannot start %d domain workers", numStrips);
+        Log::logError();
+        return false;
+    }
+    transport = socketTransport;
+
+    // Worker: run strip and exit.
+    if (!transport->isCoordinator())
+    {
+        ok = work(cycles);
+        delete transport;
+        transport = NULL;
+        _exit(ok ? 0 : 1);
+    }
+
+    // Coordinator.
+    ok = gather();
+    if (!socketTransport->wait()) ok = false;
+    delete transport;
+    transport = NULL;
+    return ok;
+    #else
+    sprintf(Log::messageBuf, "Domain decomposition requires UNIX");
+    Log::logError();
+    return false;
+    #endif
+}
+
+
+// Worker.
+bool Domain::work(int cycles)
+{
+    int i;
+    Message message;
+    Particle *particle;
+
+    rank = transport->getRank();
+    left = (float)physics->width * (float)rank / (float)numStrips;
+    right = (float)physics->width * (float)(rank + 1) / (float)numStrips;
+
+    // Own random stream and particle ids.
+    for (i = 0; i < rank; i++)
+    {
+        physics->random.jump();
+    }
+    physics->idFactory += ((rank - physics->idFactory % numStrips) +
+        numStrips) % numStrips;
+    physics->idStride = numStrips;
+
+    partition();
+    for (i = 0; i < cycles; i++)
+    {
+        if (!exchangeHalos()) return false;
+        automaton->step();
+        collectEdits();
+        removeGhosts();
+        if (!migrate()) return false;
+    }
+
+    // Send particles to coordinator.
+    message.putInt(physics->numParticles);
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        writeParticle(message, particle);
+        writeBonds(message, particle);
+    }
+    return transport->send(transport->getSize(), message);
+}
+
+
+// Gather particles from workers.
+bool Domain::gather()
+{
+    int i,j,k,n,count;
+    Message message;
+    Particle *particle;
+    RemoteBond bond;
+
+    // Replace the automaton's particles.
+    while (physics->particles != NULL)
+    {
+        physics->removeParticle(physics->particles);
+    }
+    physics->idFactory = 0;
+    remoteBonds.clear();
+    for (i = 0; i < numStrips; i++)
+    {
+        if (!transport->receive(i, message))
+        {
+            sprintf(Log::messageBuf, "Cannot gather particles from worker %d", i);
+            Log::logError();
+            return false;
+        }
+        n = message.getInt();
+        for (j = 0; j < n; j++)
+        {
+            particle = readParticle(message);
+            physics->addParticle(particle, particle->vVelocity);
+            count = message.getInt();
+            for (k = 0; k < count; k++)
+            {
+                bond.id = particle->id;
+                bond.direction = message.getInt();
+                bond.partnerId = message.getInt();
+                bond.partnerDirection = message.getInt();
+                bond.strength = message.getFloat();
+                remoteBonds.push_back(bond);
+            }
+        }
+    }
+
+    // Bind bonds: each is listed by both partners.
+    mapParticles();
+    for (i = 0; i < (int)remoteBonds.size(); i++)
+    {
+        RemoteBond &gathered = remoteBonds[i];
+        if (particleMap.find(gathered.partnerId) == particleMap.end()) continue;
+        particle = particleMap[gathered.id];
+        if (particle->bonds[gathered.direction] != NULL) continue;
+        physics->createBond(particle, gathered.direction,
+            particleMap[gathered.partnerId], gathered.partnerDirection,
+            gathered.strength);
+    }
+    remoteBonds.clear();
+    return true;
+}
+
+
+// Strip of position.
+int Domain::getStrip(float x)
+{
+    int strip = (int)(x * (float)numStrips / (float)physics->width);
+
+    if (strip < 0) strip = 0;
+    if (strip >= numStrips) strip = numStrips - 1;
+    return strip;
+}
+
+
+// Neighbor rank.
+int Domain::getNeighbor(int side)
+{
+    int neighbor = (side == 0 ? rank - 1 : rank + 1);
+
+    if (neighbor < 0 || neighbor >= numStrips) return -1;
+    return neighbor;
+}
+
+
+// Keep own strip's particles.
+void Domain::partition()
+{
+    int i,j;
+    Particle *particle,*partner,*next;
+    RemoteBond bond;
+
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        if (getStrip(particle->vPosition.x) != rank) continue;
+        for (i = 0; i < 8; i++)
+        {
+            if ((partner = particle->bonds[i]) == NULL) continue;
+            if (getStrip(partner->vPosition.x) == rank) continue;
+            for (j = 0; j < 8 && partner->bonds[j] != particle; j++) {}
+            if (j == 8) continue;
+            bond.id = particle->id;
+            bond.direction = i;
+            bond.partnerId = partner->id;
+            bond.partnerDirection = j;
+            bond.strength = particle->bondProperties[i]->getStrength();
+            remoteBonds.push_back(bond);
+        }
+    }
+    for (particle = physics->particles; particle != NULL; particle = next)
+    {
+        next = particle->next;
+        if (getStrip(particle->vPosition.x) != rank)
+        {
+            physics->removeParticle(particle);
+        }
+    }
+}
+
+
+// Exchange halos and bind remote bonds to ghosts.
+bool Domain::exchangeHalos()
+{
+    int i,n,side,neighbor;
+    Message output,input;
+    Particle *particle,*partner;
+    Ghost ghost;
+
+    ghosts.clear();
+    for (side = 0; side < 2; side++)
+    {
+        if ((neighbor = getNeighbor(side)) == -1) continue;
+        output.clear();
+        n = 0;
+        for (particle = physics->particles; particle != NULL;
+            particle = particle->next)
+        {
+            if (particle->ghost) continue;
+            if (side == 0 ? particle->vPosition.x < left + HALO_WIDTH :
+                particle->vPosition.x >= right - HALO_WIDTH)
+            {
+                n++;
+            }
+        }
+        output.putInt(n);
+        for (particle = physics->particles; particle != NULL;
+            particle = particle->next)
+        {
+            if (particle->ghost) continue;
+            if (side == 0 ? particle->vPosition.x < left + HALO_WIDTH :
+                particle->vPosition.x >= right - HALO_WIDTH)
+            {
+                writeParticle(output, particle);
+            }
+        }
+        if (!transport->exchange(neighbor, output, input)) return false;
+        n = input.getInt();
+        for (i = 0; i < n; i++)
+        {
+            particle = readParticle(input);
+            particle->ghost = true;
+            physics->addParticle(particle, particle->vVelocity);
+            ghost.particle = particle;
+            ghost.id = particle->id;
+            ghost.owner = neighbor;
+            ghost.type = particle->type;
+            ghost.state = particle->state;
+            ghost.direction = particle->orientation.direction;
+            ghost.mirrored = particle->orientation.mirrored;
+            ghosts.push_back(ghost);
+        }
+    }
+
+    // Bind remote bonds.
+    mapParticles();
+    for (i = 0; i < (int)remoteBonds.size(); i++)
+    {
+        RemoteBond &bond = remoteBonds[i];
+        if (particleMap.find(bond.id) == particleMap.end() ||
+            particleMap.find(bond.partnerId) == particleMap.end())
+        {
+            continue;
+        }
+        particle = particleMap[bond.id];
+        partner = particleMap[bond.partnerId];
+        if (!partner->ghost) continue;
+        if (particle->bonds[bond.direction] == NULL &&
+            partner->bonds[bond.partnerDirection] == NULL)
+        {
+            physics->createBond(particle, bond.direction, partner,
+                bond.partnerDirection, bond.strength);
+        }
+    }
+    return true;
+}
+
+
+// Record reaction changes to ghosts and cross strip bonds.
+void Domain::collectEdits()
+{
+    int i,j,side;
+    Particle *particle,*partner;
+    RemoteBond bond;
+    std::unordered_map<int, int> owners;
+
+    numEdits[0] = numEdits[1] = 0;
+    edits[0].clear();
+    edits[1].clear();
+    mapParticles();
+
+    // Changed and destroyed ghosts.
+    for (i = 0; i < (int)ghosts.size(); i++)
+    {
+        Ghost &ghost = ghosts[i];
+        side = (ghost.owner < rank ? 0 : 1);
+        owners[ghost.id] = ghost.owner;
+        if (particleMap.find(ghost.id) == particleMap.end())
+        {
+            addEdit(side, EDIT_DESTROY, ghost.id, 0, 0, 0, 0.0f);
+            ghost.particle = NULL;
+            continue;
+        }
+        particle = ghost.particle;
+        if (particle->type != ghost.type || particle->state != ghost.state ||
+            particle->orientation.direction != ghost.direction ||
+            particle->orientation.mirrored != ghost.mirrored)
+        {
+            addEdit(side, EDIT_SET, ghost.id, particle->type, particle->state,
+                particle->orientation.direction |
+                (particle->orientation.mirrored ? 8 : 0), 0.0f);
+        }
+    }
+
+    // Lost cross strip bonds.
+    for (i = 0; i < (int)remoteBonds.size(); )
+    {
+        RemoteBond &lost = remoteBonds[i];
+        std::unordered_map<int, Particle *>::iterator own = particleMap.find(lost.id);
+        std::unordered_map<int, Particle *>::iterator other = particleMap.find(lost.partnerId);
+        if (own != particleMap.end() && (other == particleMap.end() ||
+            own->second->bonds[lost.direction] == other->second))
+        {
+            i++;
+            continue;
+        }
+        if (other != particleMap.end())
+        {
+            // Bond broken or removed: tell the partner's owner.
+            side = (owners[lost.partnerId] < rank ? 0 : 1);
+            addEdit(side, EDIT_UNBOND, lost.partnerId, lost.partnerDirection, 0, 0, 0.0f);
+        }
+        else if (owners.find(lost.partnerId) == owners.end())
+        {
+            // Own particle destroyed: partner owner unknown.
+            addEdit(0, EDIT_UNBOND, lost.partnerId, lost.partnerDirection, 0, 0, 0.0f);
+            addEdit(1, EDIT_UNBOND, lost.partnerId, lost.partnerDirection, 0, 0, 0.0f);
+        }
+        remoteBonds.erase(remoteBonds.begin() + i);
+    }
+
+    // New cross strip bonds.
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        if (particle->ghost) continue;
+        for (i = 0; i < 8; i++)
+        {
+            if ((partner = particle->bonds[i]) == NULL || !partner->ghost) continue;
+            if (findRemoteBond(particle->id, i) != -1) continue;
+            for (j = 0; j < 8 && partner->bonds[j] != particle; j++) {}
+            if (j == 8) continue;
+            bond.id = particle->id;
+            bond.direction = i;
+            bond.partnerId = partner->id;
+            bond.partnerDirection = j;
+            bond.strength = particle->bondProperties[i]->getStrength();
+            remoteBonds.push_back(bond);
+            side = (owners[partner->id] < rank ? 0 : 1);
+            addEdit(side, EDIT_BOND, partner->id, j, particle->id, i, bond.strength);
+        }
+    }
+}
+
+
+// Remove ghosts.
+void Domain::removeGhosts()
+{
+    for (int i = 0; i < (int)ghosts.size(); i++)
+    {
+        if (ghosts[i].particle != NULL)
+        {
+            physics->removeParticle(ghosts[i].particle);
+        }
+    }
+    ghosts.clear();
+}
+
+
+// Migrate particles and exchange edits.
+bool Domain::migrate()
+{
+    int i,j,side,neighbor,strip;
+    Message output[2],input;
+    Particle *particle,*partner;
+    std::vector<Particle *> migrants[2];
+    RemoteBond bond;
+
+    // Particles leaving the strip.
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        strip = getStrip(particle->vPosition.x);
+        if (strip < rank) migrants[0].push_back(particle);
+        if (strip > rank) migrants[1].push_back(particle);
+    }
+
+    // Write migrants before removing any, so bonds between them are kept.
+    for (side = 0; side < 2; side++)
+    {
+        output[side].putInt((int)migrants[side].size());
+        for (i = 0; i < (int)migrants[side].size(); i++)
+        {
+            particle = migrants[side][i];
+            writeParticle(output[side], particle);
+            writeBonds(output[side], particle);
+
+            // Staying partners keep a remote bond.
+            for (j = 0; j < 8; j++)
+            {
+                if ((partner = particle->bonds[j]) == NULL) continue;
+                strip = getStrip(partner->vPosition.x);
+                if (strip != rank) continue;
+                bond.id = partner->id;
+                for (bond.direction = 0; bond.direction < 8 &&
+                    partner->bonds[bond.direction] != particle; bond.direction++) {}
+                if (bond.direction == 8) continue;
+                bond.partnerId = particle->id;
+                bond.partnerDirection = j;
+                bond.strength = particle->bondProperties[j]->getStrength();
+                remoteBonds.push_back(bond);
+            }
+        }
+    }
+    for (side = 0; side < 2; side++)
+    {
+        for (i = 0; i < (int)migrants[side].size(); i++)
+        {
+            physics->removeParticle(migrants[side][i]);
+        }
+        output[side].putInt(numEdits[side]);
+        output[side].data.insert(output[side].data.end(),
+            edits[side].data.begin(), edits[side].data.end());
+    }
+
+    // Exchange.
+    for (side = 0; side < 2; side++)
+    {
+        if ((neighbor = getNeighbor(side)) == -1) continue;
+        if (!transport->exchange(neighbor, output[side], input)) return false;
+        applyMigration(input);
+    }
+    return true;
+}
+
+
+// Apply migrants and edits from a neighbor.
+void Domain::applyMigration(Message &message)
+{
+    int i,j,n,count,edit,id,a,b,c,index;
+    float d;
+    Particle *particle,*partner;
+    RemoteBond bond;
+    std::unordered_map<int, Particle *>::iterator itr;
+
+    // Migrants.
+    mapParticles();
+    n = message.getInt();
+    for (i = 0; i < n; i++)
+    {
+        particle = readParticle(message);
+        physics->addParticle(particle, particle->vVelocity);
+        particleMap[particle->id] = particle;
+        count = message.getInt();
+        for (j = 0; j < count; j++)
+        {
+            bond.id = particle->id;
+            bond.direction = message.getInt();
+            bond.partnerId = message.getInt();
+            bond.partnerDirection = message.getInt();
+            bond.strength = message.getFloat();
+            itr = particleMap.find(bond.partnerId);
+            if (itr != particleMap.end())
+            {
+                // Partner is here: bond locally.
+                partner = itr->second;
+                physics->createBond(particle, bond.direction, partner,
+                    bond.partnerDirection, bond.strength);
+                if ((index = findRemoteBond(partner->id, bond.partnerDirection)) != -1)
+                {
+                    remoteBonds.erase(remoteBonds.begin() + index);
+                }
+            }
+            else if (findRemoteBond(bond.id, bond.direction) == -1)
+            {
+                remoteBonds.push_back(bond);
+            }
+        }
+    }
+
+    // Edits to own particles.
+    n = message.getInt();
+    for (i = 0; i < n; i++)
+    {
+        edit = message.getInt();
+        id = message.getInt();
+        a = message.getInt();
+        b = message.getInt();
+        c = message.getInt();
+        d = message.getFloat();
+        itr = particleMap.find(id);
+        if (itr == particleMap.end()) continue;
+        particle = itr->second;
+        switch(edit)
+        {
+            case EDIT_SET:
+                physics->setType(particle, a);
+                physics->setState(particle, b);
+                particle->orientation.direction = c & 7;
+                particle->orientation.mirrored = ((c & 8) != 0);
+                break;
+
+            case EDIT_DESTROY:
+                for (j = 0; j < (int)remoteBonds.size(); )
+                {
+                    if (remoteBonds[j].id == id)
+                    {
+                        remoteBonds.erase(remoteBonds.begin() + j);
+                    }
+                    else
+                    {
+                        j++;
+                    }
+                }
+                particleMap.erase(id);
+                physics->removeParticle(particle);
+                break;
+
+            case EDIT_BOND:
+                if (particle->bonds[a] == NULL && findRemoteBond(id, a) == -1)
+                {
+                    bond.id = id;
+                    bond.direction = a;
+                    bond.partnerId = b;
+                    bond.partnerDirection = c;
+                    bond.strength = d;
+                    remoteBonds.push_back(bond);
+                }
+                break;
+
+            case EDIT_UNBOND:
+                if ((index = findRemoteBond(id, a)) != -1)
+                {
+                    remoteBonds.erase(remoteBonds.begin() + index);
+                }
+                break;
+        }
+    }
+}
+
+
+// Map particles by id.
+void Domain::mapParticles()
+{
+    Particle *particle;
+
+    particleMap.clear();
+    for (particle = physics->particles; particle != NULL;
+        particle = particle->next)
+    {
+        particleMap[particle->id] = particle;
+    }
+}
+
+
+// Remote bond index.
+int Domain::findRemoteBond(int id, int direction)
+{
+    for (int i = 0; i < (int)remoteBonds.size(); i++)
+    {
+        if (remoteBonds[i].id == id && remoteBonds[i].direction == direction)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+// Add edit.
+void Domain::addEdit(int side, int edit, int id, int a, int b, int c, float d)
+{
+    edits[side].putInt(edit);
+    edits[side].putInt(id);
+    edits[side].putInt(a);
+    edits[side].putInt(b);
+    edits[side].putInt(c);
+    edits[side].putFloat(d);
+    numEdits[side]++;
+}
+
+
+// Write particle.
+void Domain::writeParticle(Message &message, Particle *particle)
+{
+    message.putInt(particle->id);
+    message.putInt(particle->type);
+    message.putInt(particle->state);
+    message.putInt(particle->orientation.direction |
+        (particle->orientation.mirrored ? 8 : 0));
+    message.putFloat(particle->fRadius);
+    message.putFloat(particle->fMass);
+    message.putFloat(particle->fCharge);
+    message.putFloat(particle->coefficientOfRestitution);
+    message.putFloat(particle->vPosition.x);
+    message.putFloat(particle->vPosition.y);
+    message.putFloat(particle->vVelocity.x);
+    message.putFloat(particle->vVelocity.y);
+    message.putFloat(particle->vForces.x);
+    message.putFloat(particle->vForces.y);
+}
+
+
+// Read particle.
+Particle *Domain::readParticle(Message &message)
+{
+    int id,type,state,orientation;
+    float radius,mass,charge;
+    Particle *particle;
+
+    id = message.getInt();
+    type = message.getInt();
+    state = message.getInt();
+    orientation = message.getInt();
+    radius = message.getFloat();
+    mass = message.getFloat();
+    charge = message.getFloat();
+    particle = new Particle(type, radius, mass, charge);
+    assert(particle != NULL);
+    particle->id = id;
+    particle->state = state;
+    particle->orientation.direction = orientation & 7;
+    particle->orientation.mirrored = ((orientation & 8) != 0);
+    particle->coefficientOfRestitution = message.getFloat();
+    particle->vPosition.x = message.getFloat();
+    particle->vPosition.y = message.getFloat();
+    particle->vVelocity.x = message.getFloat();
+    particle->vVelocity.y = message.getFloat();
+    particle->vForces.x = message.getFloat();
+    particle->vForces.y = message.getFloat();
+    return particle;
+}
+
+
+// Write bonds of particle; its remote bonds move with it.
+void Domain::writeBonds(Message &message, Particle *particle)
+{
+    int i,j,count;
+    Particle *partner;
+
+    count = 0;
+    for (i = 0; i < 8; i++)
+    {
+        if (particle->bonds[i] != NULL) count++;
+    }
+    for (i = 0; i < (int)remoteBonds.size(); i++)
+    {
+        if (remoteBonds[i].id == particle->id &&
+            particle->bonds[remoteBonds[i].direction] == NULL)
+        {
+            count++;
+        }
+    }
+    message.putInt(count);
+    for (i = 0; i < 8; i++)
+    {
+        if ((partner = particle->bonds[i]) == NULL) continue;
+        for (j = 0; j < 8 && partner->bonds[j] != particle; j++) {}
+        message.putInt(i);
+        message.putInt(partner->id);
+        message.putInt(j < 8 ? j : 0);
+        message.putFloat(particle->bondProperties[i]->getStrength());
+    }
+    for (i = 0; i < (int)remoteBonds.size(); )
+    {
+        if (remoteBonds[i].id != particle->id)
+        {
+            i++;
+            continue;
+        }
+        if (particle->bonds[remoteBonds[i].direction] == NULL)
+        {
+            message.putInt(remoteBonds[i].direction);
+            message.putInt(remoteBonds[i].partnerId);
+            message.putInt(remoteBonds[i].partnerDirection);
+            message.putFloat(remoteBonds[i].strength);
+        }
+        remoteBonds.erase(remoteBonds.begin() + i);
+    }
+}
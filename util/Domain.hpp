@@ -0,0 +1,151 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Domain decomposition.
+ * The world is split into vertical strips, each owned by a worker
+ * process. Each cycle a worker:
+ *   - exchanges halos with its neighbors: ghost copies of the particles
+ *     within HALO_WIDTH cells of a shared strip edge,
+ *   - steps its own particles, with ghosts taking part in neighborhoods,
+ *     collisions and bond forces,
+ *   - sends changes that reactions made to ghosts to their owners, and
+ *     migrates particles that left its strip, with their bonds.
+ * A bond between particles of different strips is kept by id on both
+ * sides as a remote bond, bound to the ghost partner while present.
+ * At the end the particles are gathered back into the automaton.
+ * Interactions across a strip edge see the other side as it was at the
+ * start of the cycle, so a decomposed run is not identical to a single
+ * process run.
+ */
+
+#ifndef __DOMAIN__
+#define __DOMAIN__
+
+#include <vector>
+#include <unordered_map>
+#include "../base/Automaton.hpp"
+#include "Transport.hpp"
+
+// Halo width (cells): covers the Moore neighborhood and collisions.
+#define HALO_WIDTH 2.0f
+
+// Minimum strip width (cells).
+#define MIN_STRIP_WIDTH 8
+
+class Domain
+{
+    public:
+
+        // Constructor.
+        Domain(int numStrips);
+
+        // Destructor.
+        ~Domain();
+
+        // Run automaton for given cycles in worker processes, one per
+        // strip, and gather the particles back into the automaton.
+        bool run(Automaton *automaton, int cycles);
+
+    private:
+
+        int numStrips;
+        Transport *transport;
+        Automaton *automaton;
+        Physics *physics;
+
+        // Worker rank and strip bounds.
+        int rank;
+        float left,right;
+
+        // Bond to a particle owned by another worker.
+        struct RemoteBond
+        {
+            int id;
+            int direction;
+            int partnerId;
+            int partnerDirection;
+            float strength;
+        };
+        std::vector<RemoteBond> remoteBonds;
+
+        // Ghost with its owner and reaction state on arrival.
+        struct Ghost
+        {
+            Particle *particle;
+            int id;
+            int owner;
+            int type;
+            int state;
+            int direction;
+            bool mirrored;
+        };
+        std::vector<Ghost> ghosts;
+
+        // Particles by id.
+        std::unordered_map<int, Particle *> particleMap;
+
+        // Edits for the left and right neighbors.
+        Message edits[2];
+        int numEdits[2];
+
+        // Worker.
+        bool work(int cycles);
+
+        // Coordinator: gather particles from workers.
+        bool gather();
+
+        // Strip of position.
+        int getStrip(float x);
+
+        // Neighbor rank on side (0 = left, 1 = right), -1 if none.
+        int getNeighbor(int side);
+
+        // Keep own strip's particles; cross strip bonds become remote.
+        void partition();
+
+        // Exchange halos and bind remote bonds to ghosts.
+        bool exchangeHalos();
+
+        // Record reaction changes to ghosts and cross strip bonds.
+        void collectEdits();
+
+        // Remove ghosts.
+        void removeGhosts();
+
+        // Migrate particles and exchange edits.
+        bool migrate();
+
+        // Apply migrants and edits from a neighbor.
+        void applyMigration(Message &message);
+
+        // Map particles by id.
+        void mapParticles();
+
+        // Remote bond index (-1 = none).
+        int findRemoteBond(int id, int direction);
+
+        // Add edit.
+        void addEdit(int side, int edit, int id, int a, int b, int c, float d);
+
+        // Write particle, and read into a new particle.
+        static void writeParticle(Message &message, Particle *particle);
+        static Particle *readParticle(Message &message);
+
+        // Write bonds of particle: local ones by partner id and remote.
+        void writeBonds(Message &message, Particle *particle);
+};
+#endif
@@ -0,0 +1,444 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/**
+ * Driver: the simulation core shared by the display and headless builds.
+ */
+
+#include "Driver.h"
+
+#ifdef WIN32
+#ifdef _DEBUG
+// For Windows memory checking, set CHECK_MEMORY = 1
+#define CHECK_MEMORY 0
+#if ( CHECK_MEMORY == 1 )
+#include <crtdbg.h>
+#endif
+#endif
+#endif
+
+// Automaton.
+Automaton *automaton;
+
+// Reaction cycles.
+int Cycles;
+int CycleCount;
+
+// Random seed (-1 = none given).
+long RandomSeed = -1;
+
+// World size (cells) and particle limit.
+int WorldWidth = WIDTH;
+int WorldHeight = HEIGHT;
+int MaxParticles = MAX_PARTICLES;
+
+// Periodic boundaries.
+bool Periodic = false;
+
+// Verlet list skin and charge cutoff (0 = none).
+float VerletSkin = 0.0f;
+float ChargeCutoff = 0.0f;
+
+// Vector kernels for integration and bond forces.
+bool VectorKernels = false;
+
+// Sleep quiescent tiles and particles at rest.
+bool Sleep = false;
+bool SleepParticles = false;
+
+// Ensemble mode: replicas run on a thread pool (0 threads = all cores).
+int EnsembleSize = 0;
+int EnsembleThreads = 0;
+
+// Domain decomposition: strips run in worker processes (0 = none).
+int DomainStrips = 0;
+
+// Lockstep comparison with the reference physics paths, or with
+// a run saved and resumed at a cycle (-1 = none).
+bool LockstepMode = false;
+int LockstepResume = -1;
+
+// Physics parameter sweep file and ensemble result table.
+char *SweepFileName = NULL;
+char *ResultsFileName = NULL;
+
+// Files.
+char *InputFileName = NULL;
+char *OutputFileName = NULL;
+
+// Trajectory recording.
+char *TrajectoryFileName = NULL;
+int TrajectoryInterval = DEFAULT_TRAJECTORY_INTERVAL;
+TrajectoryWriter *trajectory = NULL;
+
+// Census stream.
+char *CensusFileName = NULL;
+int CensusInterval = DEFAULT_CENSUS_INTERVAL;
+int CensusTypes = 0;
+int CensusStates = 0;
+Census *census = NULL;
+
+// Benchmark mode.
+char *BenchmarkFileName = NULL;
+Benchmark *benchmark = NULL;
+bool BenchmarkCounters = false;
+PerfCounters *counters = NULL;
+
+// Timeline trace.
+char *TraceFileName = NULL;
+Trace *trace = NULL;
+
+#if ( INSTRUMENT == 1 )
+// Instrumentation dump request.
+volatile bool DumpInstrument = false;
+#ifdef UNIX
+void requestDump(int);
+#endif
+#endif
+
+// Display mode?
+bool Display = false;
+
+// Start paused (display mode).
+bool Pause = false;
+
+// Driver.
+int driver(int argc, char *argv[], char *appName)
+{
+    Log::logInformation("Begin reactions:");
+    CycleCount = 0;
+
+    #if ( INSTRUMENT == 1 )
+    #ifdef UNIX
+    // Dump instrumentation on SIGUSR1.
+    signal(SIGUSR1, requestDump);
+    #endif
+    #endif
+
+    // Start timeline trace.
+    if (TraceFileName != NULL)
+    {
+        trace = new Trace();
+        assert(trace != NULL);
+        trace->setThreadName("main");
+    }
+
+    // Run ensemble of replicas sharing the automaton's reactions.
+    if (EnsembleSize > 0)
+    {
+        Ensemble *ensemble = new Ensemble(EnsembleSize, EnsembleThreads);
+        assert(ensemble != NULL);
+        ensemble->trace = trace;
+        if (SweepFileName != NULL && !ensemble->loadSweep(SweepFileName))
+        {
+            exit(1);
+        }
+        ensemble->run(automaton, Cycles, RandomSeed,
+            appInitReplica, appCensus);
+        ensemble->report();
+        if (ResultsFileName != NULL && !ensemble->write(ResultsFileName))
+        {
+            sprintf(Log::messageBuf, "Cannot write results file %s", ResultsFileName);
+            Log::logError();
+        }
+        delete ensemble;
+        terminate(0);
+    }
+
+    // Run in step with the reference physics paths.
+    if (LockstepMode)
+    {
+        Lockstep *lockstep = new Lockstep();
+        assert(lockstep != NULL);
+        lockstep->resumeCycle = LockstepResume;
+        bool same = lockstep->run(automaton, Cycles, RandomSeed, appInitReplica);
+        lockstep->report();
+        delete lockstep;
+        CycleCount = Cycles;
+        terminate(same ? 0 : 1);
+    }
+
+    // Run decomposed into strips and gather the result.
+    if (DomainStrips > 0)
+    {
+        Domain *domain = new Domain(DomainStrips);
+        assert(domain != NULL);
+        if (!domain->run(automaton, Cycles)) exit(1);
+        delete domain;
+        CycleCount = Cycles;
+        terminate(0);
+    }
+
+    // Start trajectory recording.
+    if (TrajectoryFileName != NULL)
+    {
+        trajectory = new TrajectoryWriter();
+        assert(trajectory != NULL);
+        trajectory->profiler = trace;
+        if (!trajectory->open(TrajectoryFileName, TrajectoryInterval))
+        {
+            sprintf(Log::messageBuf, "Cannot open trajectory file %s", TrajectoryFileName);
+            Log::logError();
+            exit(1);
+        }
+        trajectory->record(CycleCount, &automaton->physics);
+    }
+
+    // Start census stream.
+    if (CensusFileName != NULL)
+    {
+        census = new Census(CensusTypes, CensusStates);
+        assert(census != NULL);
+        if (!census->open(CensusFileName, CensusInterval, appCensus))
+        {
+            sprintf(Log::messageBuf, "Cannot open census file %s", CensusFileName);
+            Log::logError();
+            exit(1);
+        }
+        census->record(CycleCount, automaton);
+    }
+
+    // Start benchmark.
+    if (BenchmarkFileName != NULL)
+    {
+        benchmark = new Benchmark();
+        assert(benchmark != NULL);
+
+        // Count hardware events per phase.
+        if (BenchmarkCounters)
+        {
+            counters = new PerfCounters();
+            assert(counters != NULL);
+            if (counters->open())
+            {
+                benchmark->setCounters(counters);
+            }
+            else
+            {
+                sprintf(Log::messageBuf, "Hardware performance counters unavailable");
+                Log::logWarning();
+                delete counters;
+                counters = NULL;
+            }
+        }
+    }
+
+    // Attach profilers: the trace passes phases on to the benchmark.
+    if (trace != NULL)
+    {
+        trace->setProfiler(benchmark);
+        automaton->setProfiler(trace);
+    }
+    else if (benchmark != NULL)
+    {
+        automaton->setProfiler(benchmark);
+    }
+
+    // Run in a window.
+    if (Display) return displayDriver(argc, argv, appName);
+
+    // Reaction loop.
+    for (; CycleCount < Cycles; CycleCount++)
+    {
+        if (benchmark != NULL)
+        {
+            benchmark->beginCycle(automaton->physics.numParticles);
+            automaton->step();
+            benchmark->endCycle();
+        }
+        else
+        {
+            automaton->step();
+        }
+        if (trajectory != NULL)
+        {
+            trajectory->record(CycleCount + 1, &automaton->physics);
+        }
+        if (census != NULL) census->record(CycleCount + 1, automaton);
+        #if ( INSTRUMENT == 1 )
+        if (DumpInstrument)
+        {
+            DumpInstrument = false;
+            Instrument::dump();
+        }
+        #endif
+    }
+
+    // Benchmark summary.
+    if (benchmark != NULL)
+    {
+        if (trace != NULL)
+        {
+            trace->setProfiler(NULL);
+        }
+        else
+        {
+            automaton->setProfiler(NULL);
+        }
+        benchmark->report();
+        if (!benchmark->write(BenchmarkFileName))
+        {
+            sprintf(Log::messageBuf, "Cannot write benchmark file %s", BenchmarkFileName);
+            Log::logError();
+        }
+        delete benchmark;
+        benchmark = NULL;
+        if (counters != NULL)
+        {
+            delete counters;
+            counters = NULL;
+        }
+    }
+    save(OutputFileName);
+    terminate(0);
+
+    return 0;
+}
+
+
+// Load run.
+void load(char *fileName)
+{
+    FILE *fp;
+
+    if (fileName == NULL) return;
+    if ((fp = fopen(fileName, "r")) == NULL)
+    {
+        sprintf(Log::messageBuf, "Cannot load file %s", fileName);
+        Log::logError();
+        exit(1);
+    }
+    automaton->load(fp);
+    fclose(fp);
+}
+
+
+// Save run.
+void save(char *fileName)
+{
+    FILE *fp;
+
+    if (fileName == NULL) return;
+    if ((fp = fopen(fileName, "w")) == NULL)
+    {
+        sprintf(Log::messageBuf, "Cannot save to file %s", fileName);
+        Log::logError();
+        exit(1);
+    }
+    if (trace != NULL) trace->beginEvent("checkpoint");
+    automaton->save(fp);
+    fclose(fp);
+    if (trace != NULL) trace->endEvent("checkpoint");
+}
+
+
+// Terminate.
+void terminate(int code)
+{
+    // Application termination.
+    if (EnsembleSize == 0 && !LockstepMode) appTerminate(code);
+
+    // Instrumentation totals.
+    INSTRUMENT_DUMP();
+
+    // Finish trajectory.
+    if (trajectory != NULL)
+    {
+        trajectory->close();
+        delete trajectory;
+        trajectory = NULL;
+    }
+
+    // Finish census stream.
+    if (census != NULL)
+    {
+        delete census;
+        census = NULL;
+    }
+
+    // Write timeline trace.
+    if (trace != NULL)
+    {
+        if (automaton != NULL) automaton->setProfiler(NULL);
+        if (!trace->write(TraceFileName))
+        {
+            sprintf(Log::messageBuf, "Cannot write trace file %s", TraceFileName);
+            Log::logError();
+        }
+        delete trace;
+        trace = NULL;
+    }
+
+    // Release memory.
+    if (automaton != NULL)
+    {
+        delete automaton;
+        automaton = NULL;
+    }
+
+    #ifdef WIN32
+    #if ( CHECK_MEMORY == 1 )
+    // Check for memory leaks.
+    HANDLE hFile = CreateFile(                    // Dump to temp log.
+        TEMP_LOG_FILE_NAME,
+        GENERIC_WRITE,
+        FILE_SHARE_WRITE,
+        NULL,
+        OPEN_ALWAYS,
+        0,
+        NULL
+        );
+    if (hFile == INVALID_HANDLE_VALUE)
+    {
+        sprintf(Log::messageBuf, "Cannot open memory check temporary file %s",
+            TEMP_LOG_FILE_NAME);
+        Log::logError();
+        exit(1);
+    }
+    Log::logInformation("\nMemory leak check output:");
+    _CrtSetReportMode(_CRT_WARN, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_WARN, hFile);
+    _CrtSetReportMode(_CRT_ERROR, _CRTDBG_MODE_FILE);
+    _CrtSetReportFile(_CRT_ERROR, hFile );
+    if (!_CrtDumpMemoryLeaks())
+    {
+        Log::logInformation("No memory leaks");
+        CloseHandle(hFile);
+    }
+    else
+    {
+        CloseHandle(hFile);
+        Log::appendTempLog();
+    }
+    Log::removeTempLog();
+    #endif
+    #endif
+
+    Log::logInformation("End reactions");
+    Log::close();
+    exit(code);
+}
+
+
+#if ( INSTRUMENT == 1 )
+#ifdef UNIX
+// Request instrumentation dump at the end of the current cycle.
+void requestDump(int sig)
+{
+    DumpInstrument = true;
+}
+#endif
+#endif
@@ -0,0 +1,334 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Ensemble of independent replicas.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <assert.h>
+#include <thread>
+#include "Ensemble.hpp"
+#include "Log.hpp"
+
+// Maximum sweep line length and pairs per line.
+#define MAX_SWEEP_LINE 1024
+#define MAX_SWEEP_PAIRS 32
+
+// Constructor.
+Ensemble::Ensemble(int numReplicas, int numThreads)
+{
+    this->numReplicas = numReplicas;
+    this->numThreads = numThreads;
+    numRuns = 0;
+    templateAutomaton = NULL;
+    cycles = 0;
+    seed = 0;
+    init = NULL;
+    census = NULL;
+    numCensus = 0;
+    trace = NULL;
+}
+
+
+// Add a physics parameter set.
+void Ensemble::addParameters(PhysicsParameters &parameters)
+{
+    parameterSets.push_back(parameters);
+}
+
+
+// Load parameter sets from a sweep file.
+bool Ensemble::loadSweep(char *fileName)
+{
+    int count;
+    char line[MAX_SWEEP_LINE + 1];
+    char *names[MAX_SWEEP_PAIRS],*values[MAX_SWEEP_PAIRS];
+    char *token,*value;
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "r")) == NULL)
+    {
+        sprintf(Log::messageBuf, "Cannot open sweep file %s", fileName);
+        Log::logError();
+        return false;
+    }
+    while (fgets(line, MAX_SWEEP_LINE, fp) != NULL)
+    {
+        if ((token = strchr(line, '#')) != NULL) *token = '\0';
+        count = 0;
+        for (token = strtok(line, " \t\r\n"); token != NULL;
+            token = strtok(NULL, " \t\r\n"))
+        {
+            if ((value = strchr(token, '=')) == NULL || count == MAX_SWEEP_PAIRS)
+            {
+                sprintf(Log::messageBuf, "Invalid sweep entry %s", token);
+                Log::logError();
+                fclose(fp);
+                return false;
+            }
+            *value = '\0';
+            names[count] = token;
+            values[count] = value + 1;
+            count++;
+        }
+        if (count == 0) continue;
+        if (!expandSweep(names, values, count, PhysicsParameters()))
+        {
+            fclose(fp);
+            return false;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+
+// Expand sweep line into parameter sets:
+// set the first name to each of its values, then expand the rest.
+bool Ensemble::expandSweep(char **names, char **values, int count,
+PhysicsParameters parameters)
+{
+    char list[MAX_SWEEP_LINE + 1];
+    char *value,*next;
+
+    if (count == 0)
+    {
+        parameterSets.push_back(parameters);
+        return true;
+    }
+    strncpy(list, values[0], MAX_SWEEP_LINE);
+    list[MAX_SWEEP_LINE] = '\0';
+    for (value = list; value != NULL; value = next)
+    {
+        if ((next = strchr(value, ',')) != NULL) *next++ = '\0';
+        if (!parameters.set(names[0], (float)atof(value)))
+        {
+            sprintf(Log::messageBuf, "Unknown physics parameter %s", names[0]);
+            Log::logError();
+            return false;
+        }
+        if (!expandSweep(names + 1, values + 1, count - 1, parameters)) return false;
+    }
+    return true;
+}
+
+
+// Run replicas.
+void Ensemble::run(Automaton *templateAutomaton, int cycles, long seed,
+ReplicaInit init, ReplicaCensus census)
+{
+    int i,threads;
+    std::vector<std::thread *> workers;
+
+    this->templateAutomaton = templateAutomaton;
+    this->cycles = cycles;
+    this->seed = seed;
+    this->init = init;
+    this->census = census;
+    if (parameterSets.size() == 0)
+    {
+        parameterSets.push_back(templateAutomaton->physics.parameters);
+    }
+    numRuns = (int)parameterSets.size() * numReplicas;
+    numCensus = 0;
+    censusValues.assign(numRuns * MAX_CENSUS, 0);
+    nextRun = 0;
+
+    threads = numThreads;
+    if (threads < 1)
+    {
+        threads = (int)std::thread::hardware_concurrency();
+        if (threads < 1) threads = 1;
+    }
+    if (threads > numRuns) threads = numRuns;
+    numThreads = threads;
+    for (i = 0; i < threads; i++)
+    {
+        workers.push_back(new std::thread(&Ensemble::work, this, i));
+        assert(workers[i] != NULL);
+    }
+    for (i = 0; i < threads; i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+}
+
+
+// Worker thread: run replicas until none remain.
+void Ensemble::work(int worker)
+{
+    int index;
+    char name[TRACE_NAME_SIZE];
+
+    if (trace != NULL)
+    {
+        sprintf(name, "ensemble worker %d", worker);
+        trace->setThreadName(name);
+    }
+    while ((index = nextRun++) < numRuns)
+    {
+        runReplica(index);
+    }
+}
+
+
+// Run replica.
+void Ensemble::runReplica(int index)
+{
+    int i,n;
+    const char *names[MAX_CENSUS];
+    Automaton *automaton;
+
+    automaton = new Automaton();
+    assert(automaton != NULL);
+    automaton->chemistry.shareReactions(&templateAutomaton->chemistry);
+    automaton->physics.setSize(templateAutomaton->physics.width,
+        templateAutomaton->physics.height);
+    automaton->physics.maxParticles = templateAutomaton->physics.maxParticles;
+    automaton->physics.setSleep(templateAutomaton->physics.isSleepEnabled(),
+        templateAutomaton->physics.getQuiescentState());
+    automaton->physics.setParticleSleep(templateAutomaton->physics.isParticleSleepEnabled());
+    automaton->physics.setPeriodic(templateAutomaton->physics.isPeriodic());
+    automaton->physics.setVerlet(templateAutomaton->physics.getVerletSkin(),
+        templateAutomaton->physics.getChargeCutoff());
+    automaton->physics.setVectorKernels(templateAutomaton->physics.isVectorKernels());
+    automaton->physics.parameters = parameterSets[index / numReplicas];
+    automaton->physics.random.setRand(seed + (index % numReplicas));
+    if (trace != NULL) trace->beginEvent("replica");
+    init(automaton);
+    automaton->setProfiler(trace);
+    for (i = 0; i < cycles; i++)
+    {
+        automaton->step();
+    }
+    automaton->setProfiler(NULL);
+    if (trace != NULL) trace->endEvent("replica");
+
+    // Take census; names are the same for every replica.
+    n = census(automaton, names, &censusValues[index * MAX_CENSUS]);
+    if (index == 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            censusNames[i] = names[i];
+        }
+        numCensus = n;
+    }
+    delete automaton;
+}
+
+
+// Log per replica census and summary.
+void Ensemble::report()
+{
+    int i,j,k,run,value,minimum,maximum;
+    double sum,sum2,mean;
+    char buf[100];
+
+    sprintf(Log::messageBuf, "Ensemble: parameter sets=%d replicas=%d threads=%d cycles=%d",
+        (int)parameterSets.size(), numReplicas, numThreads, cycles);
+    Log::logInformation();
+    for (k = 0; k < (int)parameterSets.size(); k++)
+    {
+        if (parameterSets.size() > 1)
+        {
+            sprintf(Log::messageBuf, "Parameter set %d:", k);
+            for (j = 0; j < PhysicsParameters::getCount(); j++)
+            {
+                sprintf(buf, " %s=%g", PhysicsParameters::getName(j),
+                    parameterSets[k].get(j));
+                strcat(Log::messageBuf, buf);
+            }
+            Log::logInformation();
+        }
+        for (i = 0; i < numReplicas; i++)
+        {
+            run = (k * numReplicas) + i;
+            sprintf(Log::messageBuf, "  replica %d (seed %ld):", i, seed + i);
+            for (j = 0; j < numCensus; j++)
+            {
+                sprintf(buf, " %s=%d", censusNames[j],
+                    censusValues[(run * MAX_CENSUS) + j]);
+                strcat(Log::messageBuf, buf);
+            }
+            Log::logInformation();
+        }
+        for (j = 0; j < numCensus; j++)
+        {
+            sum = sum2 = 0.0;
+            minimum = maximum = censusValues[(k * numReplicas * MAX_CENSUS) + j];
+            for (i = 0; i < numReplicas; i++)
+            {
+                run = (k * numReplicas) + i;
+                value = censusValues[(run * MAX_CENSUS) + j];
+                sum += (double)value;
+                sum2 += (double)value * (double)value;
+                if (value < minimum) minimum = value;
+                if (value > maximum) maximum = value;
+            }
+            mean = sum / (double)numReplicas;
+            sprintf(Log::messageBuf, "  %s: mean=%f stddev=%f min=%d max=%d",
+                censusNames[j], mean,
+                sqrt(fabs((sum2 / (double)numReplicas) - (mean * mean))),
+                minimum, maximum);
+            Log::logInformation();
+        }
+    }
+}
+
+
+// Write result table: one row per run.
+bool Ensemble::write(char *fileName)
+{
+    int i,j,k,run;
+    FILE *fp;
+
+    if ((fp = fopen(fileName, "w")) == NULL) return false;
+    fprintf(fp, "set,replica,seed");
+    for (j = 0; j < PhysicsParameters::getCount(); j++)
+    {
+        fprintf(fp, ",%s", PhysicsParameters::getName(j));
+    }
+    for (j = 0; j < numCensus; j++)
+    {
+        fprintf(fp, ",%s", censusNames[j]);
+    }
+    fprintf(fp, "\n");
+    for (k = 0; k < (int)parameterSets.size(); k++)
+    {
+        for (i = 0; i < numReplicas; i++)
+        {
+            run = (k * numReplicas) + i;
+            fprintf(fp, "%d,%d,%ld", k, i, seed + i);
+            for (j = 0; j < PhysicsParameters::getCount(); j++)
+            {
+                fprintf(fp, ",%g", parameterSets[k].get(j));
+            }
+            for (j = 0; j < numCensus; j++)
+            {
+                fprintf(fp, ",%d", censusValues[(run * MAX_CENSUS) + j]);
+            }
+            fprintf(fp, "\n");
+        }
+    }
+    fclose(fp);
+    return true;
+}
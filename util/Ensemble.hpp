@@ -0,0 +1,112 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Ensemble of independent replicas.
+ * Each replica is an automaton with its own particles and random
+ * numbers that shares the read-only reaction table of a template
+ * automaton. Replicas are run to completion on a pool of threads,
+ * and the census of each is collected and summarized.
+ * For a parameter sweep, each parameter set is run with the given
+ * number of replicas, and the results are written as a table.
+ * With a timeline trace, each pool thread records the steps and
+ * phases of its replicas into its own trace buffer.
+ */
+
+#ifndef __ENSEMBLE__
+#define __ENSEMBLE__
+
+#include <vector>
+#include <atomic>
+#include "../base/Automaton.hpp"
+#include "Trace.hpp"
+
+// Maximum census values.
+#define MAX_CENSUS 16
+
+// Replica initialization: create the particles of a new automaton.
+typedef void (*ReplicaInit)(Automaton *automaton);
+
+// Replica census: set value names and values, return number of values.
+typedef int (*ReplicaCensus)(Automaton *automaton,
+    const char **names, int *values);
+
+class Ensemble
+{
+    public:
+
+        // Timeline trace (NULL for none).
+        Trace *trace;
+
+        // Constructor.
+        Ensemble(int numReplicas, int numThreads);
+
+        // Add a physics parameter set.
+        // Without any, replicas use the template's parameters.
+        void addParameters(PhysicsParameters &parameters);
+
+        // Load parameter sets from a sweep file.
+        // Each line holds name=value pairs; comma separated value
+        // lists expand a line into the grid of their combinations.
+        bool loadSweep(char *fileName);
+
+        // Run replicas of each parameter set for given cycles.
+        // Replica r of every parameter set is seeded with seed + r,
+        // so the sets are compared on common random numbers.
+        void run(Automaton *templateAutomaton, int cycles, long seed,
+            ReplicaInit init, ReplicaCensus census);
+
+        // Log per replica census and summary.
+        void report();
+
+        // Write result table (CSV).
+        bool write(char *fileName);
+
+    private:
+
+        int numReplicas;
+        int numThreads;
+        int numRuns;
+
+        // Parameter sets.
+        std::vector<PhysicsParameters> parameterSets;
+
+        // Run parameters.
+        Automaton *templateAutomaton;
+        int cycles;
+        long seed;
+        ReplicaInit init;
+        ReplicaCensus census;
+
+        // Next run.
+        std::atomic<int> nextRun;
+
+        // Census results: numRuns x MAX_CENSUS.
+        int numCensus;
+        const char *censusNames[MAX_CENSUS];
+        std::vector<int> censusValues;
+
+        // Worker thread.
+        void work(int worker);
+
+        // Run replica.
+        void runReplica(int index);
+
+        // Expand sweep line into parameter sets.
+        bool expandSweep(char **names, char **values, int count,
+            PhysicsParameters parameters);
+};
+#endif
@@ -0,0 +1,31 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/**
+ * Headless front end: stands in for Display.cpp in builds
+ * without GL. Display mode is not available.
+ */
+
+#include "Driver.h"
+
+// Display driver.
+int displayDriver(int argc, char *argv[], char *appName)
+{
+    sprintf(Log::messageBuf, "Display not available in headless build");
+    Log::logError();
+    exit(1);
+    return 1;
+}
@@ -0,0 +1,314 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Lockstep comparison of physics paths.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include "Lockstep.hpp"
+#include "Log.hpp"
+
+// FNV-1a hash constants.
+#define HASH_OFFSET 0xCBF29CE484222325ULL
+#define HASH_PRIME 0x100000001B3ULL
+
+// Add bytes to hash.
+static inline unsigned long long hashBytes(unsigned long long hash,
+const void *bytes, int n)
+{
+    const unsigned char *b = (const unsigned char *)bytes;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        hash ^= (unsigned long long)b[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+
+// Particle id order.
+static bool idLess(Particle *particle1, Particle *particle2)
+{
+    return particle1->id < particle2->id;
+}
+
+
+// Constructor.
+Lockstep::Lockstep()
+{
+    candidate = reference = NULL;
+    resumeCycle = -1;
+    divergentCycle = -1;
+    divergentParticle = -1;
+    divergentField = NULL;
+    cycles = 0;
+}
+
+
+// Destructor.
+Lockstep::~Lockstep()
+{
+    if (candidate != NULL) delete candidate;
+    if (reference != NULL) delete reference;
+}
+
+
+// Run candidate and reference in step.
+bool Lockstep::run(Automaton *templateAutomaton, int cycles, long seed,
+ReplicaInit init)
+{
+    // Candidate takes all physics options, the reference only those
+    // of the model unless it is to be resumed.
+    candidate = create(templateAutomaton, true);
+    reference = create(templateAutomaton, resumeCycle >= 0);
+    candidate->physics.random.setRand(seed);
+    reference->physics.random.setRand(seed);
+    init(candidate);
+    init(reference);
+
+    // Step until divergence.
+    divergentCycle = -1;
+    divergentParticle = -1;
+    divergentField = NULL;
+    for (this->cycles = 0; ; this->cycles++)
+    {
+        if (this->cycles == resumeCycle && !resume(templateAutomaton)) return false;
+        if (hash(&candidate->physics) != hash(&reference->physics))
+        {
+            divergentCycle = this->cycles;
+            locate();
+            return false;
+        }
+        if (this->cycles == cycles) break;
+        candidate->step();
+        reference->step();
+    }
+    return true;
+}
+
+
+// Create automaton for the template: with all its physics options,
+// or only those of the model.
+Automaton *Lockstep::create(Automaton *templateAutomaton, bool options)
+{
+    Physics *physics = &templateAutomaton->physics;
+    Automaton *automaton;
+
+    automaton = new Automaton();
+    assert(automaton != NULL);
+    automaton->chemistry.shareReactions(&templateAutomaton->chemistry);
+    automaton->physics.setSize(physics->width, physics->height);
+    automaton->physics.maxParticles = physics->maxParticles;
+    automaton->physics.setPeriodic(physics->isPeriodic());
+    automaton->physics.parameters = physics->parameters;
+    if (options)
+    {
+        automaton->physics.setSleep(physics->isSleepEnabled(),
+            physics->getQuiescentState());
+        automaton->physics.setParticleSleep(physics->isParticleSleepEnabled());
+        automaton->physics.setVerlet(physics->getVerletSkin(),
+            physics->getChargeCutoff());
+        automaton->physics.setVectorKernels(physics->isVectorKernels());
+    }
+    return automaton;
+}
+
+
+// Save the reference and load it into a new automaton.
+bool Lockstep::resume(Automaton *templateAutomaton)
+{
+    FILE *fp;
+
+    if ((fp = tmpfile()) == NULL)
+    {
+        sprintf(Log::messageBuf, "Cannot open temporary file to resume run");
+        Log::logError();
+        return false;
+    }
+    reference->save(fp);
+    rewind(fp);
+    delete reference;
+    reference = create(templateAutomaton, true);
+    reference->load(fp);
+    fclose(fp);
+    return true;
+}
+
+
+// Log result.
+void Lockstep::report()
+{
+    char other[50];
+
+    if (resumeCycle >= 0)
+    {
+        sprintf(other, "run resumed at cycle %d", resumeCycle);
+    }
+    else
+    {
+        sprintf(other, "reference");
+    }
+    if (divergentCycle < 0)
+    {
+        sprintf(Log::messageBuf, "Lockstep: identical to %s for %d cycles",
+            other, cycles);
+        Log::logInformation();
+    }
+    else if (divergentParticle < 0)
+    {
+        sprintf(Log::messageBuf, "Lockstep: diverged from %s at cycle %d: particles differ",
+            other, divergentCycle);
+        Log::logInformation();
+    }
+    else
+    {
+        sprintf(Log::messageBuf, "Lockstep: diverged from %s at cycle %d: particle %d %s",
+            other, divergentCycle, divergentParticle, divergentField);
+        Log::logInformation();
+    }
+}
+
+
+// Hash of the particle states of physics.
+unsigned long long Lockstep::hash(Physics *physics)
+{
+    std::vector<Particle *> particles;
+    unsigned long long hash;
+    int i;
+
+    getParticles(physics, particles);
+    hash = HASH_OFFSET;
+    for (i = 0; i < (int)particles.size(); i++)
+    {
+        hash = hashParticle(particles[i], hash);
+    }
+    return hash;
+}
+
+
+// Get particles sorted by id.
+void Lockstep::getParticles(Physics *physics, std::vector<Particle *> &result)
+{
+    Particle *particle;
+
+    result.clear();
+    for (particle = physics->particles; particle != NULL; particle = particle->next)
+    {
+        result.push_back(particle);
+    }
+    std::sort(result.begin(), result.end(), idLess);
+}
+
+
+// Add particle state to hash.
+unsigned long long Lockstep::hashParticle(Particle *particle,
+unsigned long long hash)
+{
+    int i,id;
+    float strength;
+
+    hash = hashBytes(hash, &particle->id, sizeof(int));
+    hash = hashBytes(hash, &particle->type, sizeof(int));
+    hash = hashBytes(hash, &particle->state, sizeof(int));
+    hash = hashBytes(hash, &particle->orientation.direction, sizeof(int));
+    hash = hashBytes(hash, &particle->orientation.mirrored, sizeof(bool));
+    hash = hashBytes(hash, &particle->vPosition, sizeof(Vector));
+    hash = hashBytes(hash, &particle->vVelocity, sizeof(Vector));
+    hash = hashBytes(hash, &particle->vForces, sizeof(Vector));
+    for (i = 0; i < 8; i++)
+    {
+        if (particle->bonds[i] == NULL)
+        {
+            id = -1;
+            strength = 0.0f;
+        }
+        else
+        {
+            id = particle->bonds[i]->id;
+            strength = particle->bondProperties[i]->getStrength();
+        }
+        hash = hashBytes(hash, &id, sizeof(int));
+        hash = hashBytes(hash, &strength, sizeof(float));
+    }
+    return hash;
+}
+
+
+// First differing field of particles.
+const char *Lockstep::compare(Particle *particle1, Particle *particle2)
+{
+    int i;
+
+    if (particle1->type != particle2->type) return "type";
+    if (particle1->state != particle2->state) return "state";
+    if (particle1->orientation.direction != particle2->orientation.direction ||
+        particle1->orientation.mirrored != particle2->orientation.mirrored)
+    {
+        return "orientation";
+    }
+    if (memcmp(&particle1->vPosition, &particle2->vPosition, sizeof(Vector)) != 0)
+    {
+        return "position";
+    }
+    if (memcmp(&particle1->vVelocity, &particle2->vVelocity, sizeof(Vector)) != 0)
+    {
+        return "velocity";
+    }
+    if (memcmp(&particle1->vForces, &particle2->vForces, sizeof(Vector)) != 0)
+    {
+        return "force";
+    }
+    for (i = 0; i < 8; i++)
+    {
+        if ((particle1->bonds[i] == NULL) != (particle2->bonds[i] == NULL)) return "bonds";
+        if (particle1->bonds[i] == NULL) continue;
+        if (particle1->bonds[i]->id != particle2->bonds[i]->id ||
+            particle1->bondProperties[i]->getStrength() !=
+            particle2->bondProperties[i]->getStrength())
+        {
+            return "bonds";
+        }
+    }
+    return NULL;
+}
+
+
+// Locate the first divergent particle.
+void Lockstep::locate()
+{
+    int i;
+
+    getParticles(&candidate->physics, candidateParticles);
+    getParticles(&reference->physics, referenceParticles);
+    for (i = 0; i < (int)candidateParticles.size() &&
+        i < (int)referenceParticles.size(); i++)
+    {
+        if (candidateParticles[i]->id != referenceParticles[i]->id) return;
+        divergentField = compare(candidateParticles[i], referenceParticles[i]);
+        if (divergentField != NULL)
+        {
+            divergentParticle = candidateParticles[i]->id;
+            return;
+        }
+    }
+}
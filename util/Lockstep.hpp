@@ -0,0 +1,102 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+
+/*
+ * Lockstep comparison of physics paths.
+ * A candidate automaton with the template's physics options and a
+ * reference automaton with the default physics paths (no Verlet lists,
+ * vector kernels or tile sleeping) are created from the same seed and
+ * stepped together. After each cycle the full particle state of each
+ * is hashed: id, type, state, orientation, position, velocity, force
+ * and bonds, in id order, compared bit for bit. The run stops at the
+ * first cycle whose hashes differ, and the first differing particle
+ * is located.
+ *
+ * To check run continuation, the reference instead takes the same
+ * options as the candidate and is saved and loaded into a new
+ * automaton at a given cycle.
+ */
+
+#ifndef __LOCKSTEP__
+#define __LOCKSTEP__
+
+#include <vector>
+#include "../base/Automaton.hpp"
+#include "Ensemble.hpp"
+
+class Lockstep
+{
+    public:
+
+        // Constructor.
+        Lockstep();
+
+        // Destructor.
+        ~Lockstep();
+
+        // Run candidate and reference copies of the template automaton
+        // for given cycles; init creates their particles.
+        // Returns true if they did not diverge.
+        bool run(Automaton *templateAutomaton, int cycles, long seed,
+            ReplicaInit init);
+
+        // Log result.
+        void report();
+
+        // Cycle at which the reference is saved and resumed (-1 = none).
+        int resumeCycle;
+
+        // First divergent cycle (-1 = none), particle id (-1 = a
+        // particle exists in one automaton only) and field.
+        int divergentCycle;
+        int divergentParticle;
+        const char *divergentField;
+
+        // Cycles run in step.
+        int cycles;
+
+        // Hash of the particle states of physics.
+        static unsigned long long hash(Physics *physics);
+
+    private:
+
+        Automaton *candidate;
+        Automaton *reference;
+        std::vector<Particle *> candidateParticles;
+        std::vector<Particle *> referenceParticles;
+
+        // Create automaton for the template: with all its physics
+        // options, or only those of the model.
+        static Automaton *create(Automaton *templateAutomaton, bool options);
+
+        // Save the reference and load it into a new automaton.
+        bool resume(Automaton *templateAutomaton);
+
+        // Get particles sorted by id.
+        static void getParticles(Physics *physics, std::vector<Particle *> &result);
+
+        // Add particle state to hash.
+        static unsigned long long hashParticle(Particle *particle,
+            unsigned long long hash);
+
+        // First differing field of particles (NULL = same).
+        static const char *compare(Particle *particle1, Particle *particle2);
+
+        // Locate the first divergent particle.
+        void locate();
+};
+#endif
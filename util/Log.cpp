@@ -12,6 +12,7 @@
  * Basic logging.
  */
 
+#include <mutex>
 #include "Log.hpp"
 
 // Logging flag.
@@ -22,7 +23,10 @@ char Log::logFileNameBuf[LOG_FILE_NAMESZ + 1];
 char *Log::logFileName = DEFAULT_LOG_FILE_NAME;
 
 // Message composition buffer.
-char Log::messageBuf[MESSAGE_SIZE + 1];
+thread_local char Log::messageBuf[MESSAGE_SIZE + 1];
+
+// Serializes output from multiple threads.
+static std::mutex LogLock;
 
 FILE *Log::logfp = NULL;
 bool Log::logOpened = false;
@@ -128,6 +132,7 @@ void Log::removeTempLog()
 void Log::log(char *prefix, char *message)
 {
     if (LOGGING_FLAG == NO_LOG) return;
+    std::lock_guard<std::mutex> guard(LogLock);
 
     // Open log file?
     if (LOGGING_FLAG == LOG_TO_FILE || LOGGING_FLAG == LOG_TO_BOTH)
@@ -44,8 +44,8 @@ class Log
         static char *logFileName;
         static void setLogFileName(char *name);
 
-        // Message composition buffer.
-        static char messageBuf[MESSAGE_SIZE + 1];
+        // Message composition buffer (one per thread).
+        static thread_local char messageBuf[MESSAGE_SIZE + 1];
 
         // Log error message.
         static void logError(char *message);
@@ -262,6 +262,232 @@ inline  float TripleScalarProduct(Vector3D u, Vector3D v, Vector3D w)
 }
 
 
+//------------------------------------------------------------------------//
+// 2D Vector2D Class and vector functions
+// Same interface as Vector3D for planar motion: operations are on two
+// components only. The cross product is the z component of the 3D one.
+//------------------------------------------------------------------------//
+class Vector2D
+{
+    public:
+        float x;
+        float y;
+
+        Vector2D(void);
+        Vector2D(float xi, float yi);
+
+        float Magnitude(void);
+        void  Normalize(void);
+        void  Normalize(float);
+        void  Reverse(void);
+        float Distance(Vector2D);
+        float SquareDistance(Vector2D);
+        void  Zero(void);
+
+        Vector2D& operator+=(Vector2D u);         // vector addition
+        Vector2D& operator-=(Vector2D u);         // vector subtraction
+        Vector2D& operator*=(float s);            // scalar multiply
+        Vector2D& operator/=(float s);            // scalar divide
+
+        Vector2D operator-(void);
+
+};
+
+inline  Vector2D operator+(Vector2D u, Vector2D v);
+inline  Vector2D operator-(Vector2D u, Vector2D v);
+inline  float operator^(Vector2D u, Vector2D v);
+inline  float operator*(Vector2D u, Vector2D v);
+inline  Vector2D operator*(float s, Vector2D u);
+inline  Vector2D operator*(Vector2D u, float s);
+inline  Vector2D operator/(Vector2D u, float s);
+
+inline Vector2D::Vector2D(void)
+{
+    x = 0;
+    y = 0;
+}
+
+
+inline Vector2D::Vector2D(float xi, float yi)
+{
+    x = xi;
+    y = yi;
+}
+
+
+inline  float Vector2D::Magnitude(void)
+{
+    return (float) sqrt(x*x + y*y);
+}
+
+
+inline  void  Vector2D::Normalize(void)
+{
+    float m = (float) sqrt(x*x + y*y);
+    if(m <= tol) m = 1;
+    x /= m;
+    y /= m;
+
+    if (fabs(x) < tol) x = 0.0f;
+    if (fabs(y) < tol) y = 0.0f;
+}
+
+
+inline  void  Vector2D::Normalize(float n)
+{
+    float m = (float) sqrt(x*x + y*y);
+    if(m <= tol) m = 1;
+    m = n / m;
+    x *= m;
+    y *= m;
+
+    if (fabs(x) < tol) x = 0.0f;
+    if (fabs(y) < tol) y = 0.0f;
+}
+
+
+inline  void  Vector2D::Reverse(void)
+{
+    x = -x;
+    y = -y;
+}
+
+
+inline  float Vector2D::Distance(Vector2D v)
+{
+    float dx,dy;
+
+    dx = x - v.x;
+    dy = y - v.y;
+    return (float) sqrt(dx*dx + dy*dy);
+}
+
+
+inline  float Vector2D::SquareDistance(Vector2D v)
+{
+    float dx,dy;
+
+    dx = x - v.x;
+    dy = y - v.y;
+    return (float) (dx*dx + dy*dy);
+}
+
+
+inline  void  Vector2D::Zero(void)
+{
+    x = 0.0;
+    y = 0.0;
+}
+
+
+inline Vector2D& Vector2D::operator+=(Vector2D u)
+{
+    x += u.x;
+    y += u.y;
+    return *this;
+}
+
+
+inline  Vector2D& Vector2D::operator-=(Vector2D u)
+{
+    x -= u.x;
+    y -= u.y;
+    return *this;
+}
+
+
+inline  Vector2D& Vector2D::operator*=(float s)
+{
+    x *= s;
+    y *= s;
+    return *this;
+}
+
+
+inline  Vector2D& Vector2D::operator/=(float s)
+{
+    x /= s;
+    y /= s;
+    return *this;
+}
+
+
+inline  Vector2D Vector2D::operator-(void)
+{
+    return Vector2D(-x, -y);
+}
+
+
+inline  Vector2D operator+(Vector2D u, Vector2D v)
+{
+    return Vector2D(u.x + v.x, u.y + v.y);
+}
+
+
+inline  Vector2D operator-(Vector2D u, Vector2D v)
+{
+    return Vector2D(u.x - v.x, u.y - v.y);
+}
+
+
+// Vector2D cross product (z component of u cross v)
+inline  float operator^(Vector2D u, Vector2D v)
+{
+    return u.x*v.y - u.y*v.x;
+}
+
+
+// Vector2D dot product
+inline  float operator*(Vector2D u, Vector2D v)
+{
+    return (u.x*v.x + u.y*v.y);
+}
+
+
+inline  Vector2D operator*(float s, Vector2D u)
+{
+    return Vector2D(u.x*s, u.y*s);
+}
+
+
+inline  Vector2D operator*(Vector2D u, float s)
+{
+    return Vector2D(u.x*s, u.y*s);
+}
+
+
+inline  Vector2D operator/(Vector2D u, float s)
+{
+    return Vector2D(u.x/s, u.y/s);
+}
+
+
+// Vector in 3D: planar vectors lie in the z = 0 plane.
+inline  Vector3D ToVector3D(Vector2D u)
+{
+    return Vector3D(u.x, u.y, 0.0f);
+}
+
+
+inline  Vector3D ToVector3D(Vector3D u)
+{
+    return u;
+}
+
+
+// z component.
+inline  float GetZ(Vector2D u)
+{
+    return 0.0f;
+}
+
+
+inline  float GetZ(Vector3D u)
+{
+    return u.z;
+}
+
+
 //------------------------------------------------------------------------//
 // Matrix Class and matrix functions
 //------------------------------------------------------------------------//
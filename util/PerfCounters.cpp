@@ -0,0 +1,111 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Hardware performance counters.
+ */
+
+#include <string.h>
+#include "PerfCounters.hpp"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+// Event configurations.
+static const unsigned long long CounterConfigs[NUM_COUNTERS] =
+{
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+#endif
+
+// Constructor.
+PerfCounters::PerfCounters()
+{
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        fds[i] = -1;
+    }
+}
+
+
+// Destructor.
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+
+// Open and start counters for calling thread.
+bool PerfCounters::open()
+{
+    bool available = false;
+
+    close();
+    #ifdef __linux__
+    struct perf_event_attr attr;
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = CounterConfigs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fds[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fds[i] == -1) continue;
+        ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        available = true;
+    }
+    #endif
+    return available;
+}
+
+
+// Close counters.
+void PerfCounters::close()
+{
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        #ifdef __linux__
+        if (fds[i] != -1) ::close(fds[i]);
+        #endif
+        fds[i] = -1;
+    }
+}
+
+
+// Read current counts.
+void PerfCounters::read(long long counts[NUM_COUNTERS])
+{
+    for (int i = 0; i < NUM_COUNTERS; i++)
+    {
+        counts[i] = 0;
+        #ifdef __linux__
+        if (fds[i] != -1 &&
+            ::read(fds[i], &counts[i], sizeof(long long)) != sizeof(long long))
+        {
+            counts[i] = 0;
+        }
+        #endif
+    }
+}
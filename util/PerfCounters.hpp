@@ -0,0 +1,70 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Hardware performance counters.
+ * Counts CPU cycles, instructions, cache misses and branch misses for
+ * the calling thread using Linux perf_event_open. Counters that the
+ * kernel or CPU does not provide are reported as unavailable.
+ */
+
+#ifndef __PERF_COUNTERS__
+#define __PERF_COUNTERS__
+
+// Counters.
+#define COUNTER_CYCLES 0
+#define COUNTER_INSTRUCTIONS 1
+#define COUNTER_CACHE_MISSES 2
+#define COUNTER_BRANCH_MISSES 3
+#define NUM_COUNTERS 4
+
+// Counter names.
+static const char *CounterNames[NUM_COUNTERS] =
+{
+    "cycles",
+    "instructions",
+    "cache_misses",
+    "branch_misses"
+};
+
+class PerfCounters
+{
+    public:
+
+        // Constructor.
+        PerfCounters();
+
+        // Destructor.
+        ~PerfCounters();
+
+        // Open and start counters for calling thread.
+        // Returns true if any counter is available.
+        bool open();
+
+        // Close counters.
+        void close();
+
+        // Counter available?
+        bool isAvailable(int counter) { return fds[counter] != -1; }
+
+        // Read current counts (unavailable counters read 0).
+        void read(long long counts[NUM_COUNTERS]);
+
+    private:
+
+        int fds[NUM_COUNTERS];
+};
+#endif
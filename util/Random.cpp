@@ -20,77 +20,163 @@
 
 #include "Random.hpp"
 
-#ifdef UNIX
-#include <stdlib.h>
-#endif
-#ifdef WIN32
-#include <windows.h>
-#endif
+// splitmix64 seeding increment.
+#define RANDOM_SEED_INCREMENT 0x9E3779B97F4A7C15ULL
+
+// Jump polynomial for 2^128 draws.
+static const unsigned long long JumpPolynomial[4] =
+{
+    0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+    0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL
+};
+
+// Float and double scaling of the high bits.
+#define RANDOM_FLOAT_SCALE (1.0f / 16777216.0f)
+#define RANDOM_DOUBLE_SCALE (1.0 / 9007199254740992.0)
+
+// Constructor.
+Random::Random()
+{
+    setRand(0);
+}
+
+
+Random::Random(long seed)
+{
+    setRand(seed);
+}
+
 
 // Set random seed.
 void Random::setRand(long seed)
 {
-    #ifdef UNIX
-    srand48(seed);
-    #endif
-    #ifdef WIN32
-    srand(seed);
-    #endif
+    unsigned long long x,z;
+    int i;
+
+    this->seed = seed;
+    x = (unsigned long long)seed;
+    for (i = 0; i < 4; i++)
+    {
+        x += RANDOM_SEED_INCREMENT;
+        z = x;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        state[i] = z ^ (z >> 31);
+    }
+}
+
+
+// Advance by 2^128 draws.
+void Random::jump()
+{
+    unsigned long long s[4];
+    int i,b;
+
+    s[0] = s[1] = s[2] = s[3] = 0;
+    for (i = 0; i < 4; i++)
+    {
+        for (b = 0; b < 64; b++)
+        {
+            if (JumpPolynomial[i] & (1ULL << b))
+            {
+                s[0] ^= state[0];
+                s[1] ^= state[1];
+                s[2] ^= state[2];
+                s[3] ^= state[3];
+            }
+            next();
+        }
+    }
+    state[0] = s[0];
+    state[1] = s[1];
+    state[2] = s[2];
+    state[3] = s[3];
 }
 
 
 // Random boolean.
 bool Random::nextBoolean()
 {
-    int r;
-    #ifdef UNIX
-    r = lrand48() % 2;
-    #endif
-    #ifdef WIN32
-    r = rand() % 2;
-    #endif
-    if (r == 1) return true; else return false;
+    return((next() >> 63) == 1ULL);
 }
 
 
 // Random float >= 0.0f&& < 1.0f
 float Random::nextFloat()
 {
-    return((float)nextDouble());
+    return((float)(next() >> 40) * RANDOM_FLOAT_SCALE);
 }
 
 
 // Random double >= 0.0 && < 1.0
 double Random::nextDouble()
 {
-    #ifdef UNIX
-    return(drand48());
-    #endif
-    #ifdef WIN32
-    return((double)rand() / (double)RAND_MAX);
-    #endif
+    return((double)(next() >> 11) * RANDOM_DOUBLE_SCALE);
 }
 
 
 // Random integer.
 long Random::nextInt()
 {
-    #ifdef UNIX
-    return(lrand48());
-    #endif
-    #ifdef WIN32
-    return(rand());
-    #endif
+    return((long)(next() >> 33));
 }
 
 
 // Random integer modulus given value.
 long Random::nextInt(int modulus)
 {
-    #ifdef UNIX
-    return(lrand48() % modulus);
-    #endif
-    #ifdef WIN32
-    return(rand() % modulus);
-    #endif
+    return(nextInt() % modulus);
+}
+
+
+// Fill with random floats.
+void Random::fill(float *values, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        values[i] = (float)(next() >> 40) * RANDOM_FLOAT_SCALE;
+    }
+}
+
+
+// Fill with random doubles.
+void Random::fill(double *values, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        values[i] = (double)(next() >> 11) * RANDOM_DOUBLE_SCALE;
+    }
+}
+
+
+// Load seed and state.
+bool Random::load(FILE *fp)
+{
+    long n;
+    unsigned long long s[4];
+
+    if (fscanf(fp, "%ld %llx %llx %llx %llx", &n, &s[0], &s[1], &s[2], &s[3]) != 5)
+    {
+        return false;
+    }
+    if ((s[0] | s[1] | s[2] | s[3]) == 0ULL) return false;
+    seed = n;
+    state[0] = s[0];
+    state[1] = s[1];
+    state[2] = s[2];
+    state[3] = s[3];
+    return true;
+}
+
+
+// Save seed and state.
+void Random::save(FILE *fp)
+{
+    fprintf(fp, "%ld %llx %llx %llx %llx\n", seed, state[0], state[1],
+        state[2], state[3]);
+    fflush(fp);
 }
@@ -16,31 +16,88 @@
 
 /*
  * Random numbers.
+ * Each generator has its own state, so independent simulations can
+ * draw random numbers concurrently. The generator is xoshiro256**,
+ * seeded through splitmix64. A jump advances a generator by 2^128
+ * draws, so jumping a copy of a generator yields a stream that does
+ * not overlap the original. The state can be saved and loaded so that
+ * a resumed run continues the same sequence. The seed is saved with
+ * the state, so a saved run records how it was started.
  */
 
 #ifndef __RANDOM__
 #define __RANDOM__
 
+#include <stdio.h>
+
 class Random
 {
     public:
 
+        // Constructor: seed 0.
+        Random();
+
+        // Constructor: seeded.
+        Random(long seed);
+
         // Set random seed.
-        static void setRand(long seed);
+        void setRand(long seed);
+
+        // Get random seed.
+        long getSeed() { return seed; }
+
+        // Advance by 2^128 draws to an independent stream.
+        void jump();
 
         // Random boolean.
-        static bool nextBoolean();
+        bool nextBoolean();
 
         // Random float >= 0.0f && < 1.0f
-        static float nextFloat();
+        float nextFloat();
 
         // Random double >= 0.0 && < 1.0
-        static double nextDouble();
+        double nextDouble();
 
         // Random integer.
-        static long nextInt();
+        long nextInt();
 
         // Random integer modulus given value.
-        static long nextInt(int modulus);
+        long nextInt(int modulus);
+
+        // Fill with n random floats (doubles) >= 0 && < 1,
+        // the same values as n calls to nextFloat (nextDouble).
+        void fill(float *values, int n);
+        void fill(double *values, int n);
+
+        // Load and save seed and state.
+        bool load(FILE *fp);
+        void save(FILE *fp);
+
+    private:
+
+        // Seed and generator state.
+        long seed;
+        unsigned long long state[4];
+
+        // Next 64 random bits.
+        inline unsigned long long next()
+        {
+            unsigned long long result,t;
+
+            result = rotate(state[1] * 5ULL, 7) * 9ULL;
+            t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = rotate(state[3], 45);
+            return result;
+        }
+
+        static inline unsigned long long rotate(unsigned long long x, int k)
+        {
+            return (x << k) | (x >> (64 - k));
+        }
 };
 #endif
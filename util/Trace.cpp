@@ -0,0 +1,174 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Timeline trace.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <chrono>
+#include "Trace.hpp"
+
+// Calling thread's buffer.
+thread_local Trace *Trace::owner = NULL;
+thread_local TraceBuffer *Trace::buffer = NULL;
+
+// Buffer constructor.
+TraceBuffer::TraceBuffer(int threadId, int capacity) : head(0)
+{
+    this->threadId = threadId;
+    name[0] = '\0';
+    events.resize(capacity);
+}
+
+
+// Constructor.
+Trace::Trace(int capacity)
+{
+    profiler = NULL;
+    for (this->capacity = 1; this->capacity < capacity; this->capacity <<= 1) {}
+    startTime = 0;
+    startTime = getTime();
+}
+
+
+// Destructor.
+Trace::~Trace()
+{
+    for (int i = 0; i < (int)buffers.size(); i++)
+    {
+        delete buffers[i];
+    }
+    buffers.clear();
+}
+
+
+// Current time in nanoseconds since start.
+long long Trace::getTime()
+{
+    return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count() - startTime;
+}
+
+
+// Register a buffer for the calling thread.
+void Trace::addBuffer()
+{
+    std::lock_guard<std::mutex> guard(buffersLock);
+    buffer = new TraceBuffer((int)buffers.size() + 1, capacity);
+    assert(buffer != NULL);
+    buffers.push_back(buffer);
+    owner = this;
+}
+
+
+// Begin phase.
+void Trace::beginPhase(int phase)
+{
+    getBuffer()->push(PhaseNames[phase], 'B', getTime());
+    if (profiler != NULL) profiler->beginPhase(phase);
+}
+
+
+// End phase.
+void Trace::endPhase(int phase)
+{
+    if (profiler != NULL) profiler->endPhase(phase);
+    getBuffer()->push(PhaseNames[phase], 'E', getTime());
+}
+
+
+// Begin named event.
+void Trace::beginEvent(const char *name)
+{
+    getBuffer()->push(name, 'B', getTime());
+    if (profiler != NULL) profiler->beginEvent(name);
+}
+
+
+// End named event.
+void Trace::endEvent(const char *name)
+{
+    if (profiler != NULL) profiler->endEvent(name);
+    getBuffer()->push(name, 'E', getTime());
+}
+
+
+// Name the calling thread.
+void Trace::setThreadName(const char *name)
+{
+    TraceBuffer *b = getBuffer();
+
+    strncpy(b->name, name, TRACE_NAME_SIZE - 1);
+    b->name[TRACE_NAME_SIZE - 1] = '\0';
+}
+
+
+// Write trace-event JSON file.
+bool Trace::write(char *fileName)
+{
+    int i,depth;
+    unsigned long long h,e;
+    bool first;
+    TraceBuffer *b;
+    FILE *fp;
+    char name[TRACE_NAME_SIZE];
+
+    if ((fp = fopen(fileName, "w")) == NULL) return false;
+    std::lock_guard<std::mutex> guard(buffersLock);
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    first = true;
+    for (i = 0; i < (int)buffers.size(); i++)
+    {
+        b = buffers[i];
+        if (b->name[0] != '\0')
+        {
+            strcpy(name, b->name);
+        }
+        else
+        {
+            sprintf(name, "thread %d", b->threadId);
+        }
+        fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n",
+            b->threadId, name);
+        first = false;
+
+        // Oldest retained event first; skip ends whose begins were overwritten.
+        h = b->head.load(std::memory_order_acquire);
+        e = (h > b->events.size()) ? h - b->events.size() : 0;
+        for (depth = 0; e < h; e++)
+        {
+            TraceEvent &event = b->events[e & (b->events.size() - 1)];
+            if (event.type == 'E')
+            {
+                if (depth == 0) continue;
+                depth--;
+            }
+            else
+            {
+                depth++;
+            }
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                event.name, event.type, b->threadId, (double)event.time * 1.0e-3);
+        }
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
@@ -0,0 +1,127 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Timeline trace.
+ * Records begin/end events for simulation phases and named events
+ * (steps, checkpoints, display frames, trajectory writes) and writes
+ * them as a Chrome/Perfetto trace-event JSON file.
+ * Each thread records into its own ring buffer without locking; when
+ * a buffer fills, its oldest events are overwritten. Threads may be
+ * named, e.g. the workers of an ensemble.
+ */
+
+#ifndef __TRACE__
+#define __TRACE__
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "../base/Profiler.hpp"
+
+// Default events per thread buffer.
+#define TRACE_BUFFER_EVENTS (1 << 20)
+
+// Maximum thread name length.
+#define TRACE_NAME_SIZE 32
+
+// Trace event.
+struct TraceEvent
+{
+    const char *name;
+    long long time;                               // nanoseconds since start
+    char type;                                    // 'B' or 'E'
+};
+
+// Per-thread event ring buffer.
+class TraceBuffer
+{
+    public:
+
+        int threadId;
+        char name[TRACE_NAME_SIZE];               // empty = unnamed
+        std::vector<TraceEvent> events;
+        std::atomic<unsigned long long> head;     // events recorded
+
+        // Constructor.
+        TraceBuffer(int threadId, int capacity);
+
+        // Record event: single producer.
+        void push(const char *name, char type, long long time)
+        {
+            unsigned long long h = head.load(std::memory_order_relaxed);
+            TraceEvent &event = events[h & (events.size() - 1)];
+            event.name = name;
+            event.time = time;
+            event.type = type;
+            head.store(h + 1, std::memory_order_release);
+        }
+};
+
+class Trace : public Profiler
+{
+    public:
+
+        // Constructor: capacity is events per thread (rounded up to a power of 2).
+        Trace(int capacity = TRACE_BUFFER_EVENTS);
+
+        // Destructor.
+        ~Trace();
+
+        // Pass phases and events on to another profiler (NULL for none).
+        void setProfiler(Profiler *profiler) { this->profiler = profiler; }
+
+        // Phases.
+        void beginPhase(int phase);
+        void endPhase(int phase);
+
+        // Named events.
+        void beginEvent(const char *name);
+        void endEvent(const char *name);
+
+        // Name the calling thread.
+        void setThreadName(const char *name);
+
+        // Write trace-event JSON file.
+        // Recording threads should be idle.
+        bool write(char *fileName);
+
+    private:
+
+        Profiler *profiler;
+        int capacity;
+        long long startTime;
+
+        // Thread buffers.
+        std::vector<TraceBuffer *> buffers;
+        std::mutex buffersLock;
+
+        // Calling thread's buffer.
+        static thread_local Trace *owner;
+        static thread_local TraceBuffer *buffer;
+        TraceBuffer *getBuffer()
+        {
+            if (owner != this) addBuffer();
+            return buffer;
+        }
+
+        // Register a buffer for the calling thread.
+        void addBuffer();
+
+        // Current time in nanoseconds since start.
+        long long getTime();
+};
+#endif
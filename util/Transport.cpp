@@ -0,0 +1,334 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Message transport between the processes of a decomposed run.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "Transport.hpp"
+#ifdef UNIX
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+
+// Put integer.
+void Message::putInt(int value)
+{
+    unsigned char *bytes = (unsigned char *)&value;
+
+    data.insert(data.end(), bytes, bytes + sizeof(int));
+}
+
+
+// Put float.
+void Message::putFloat(float value)
+{
+    unsigned char *bytes = (unsigned char *)&value;
+
+    data.insert(data.end(), bytes, bytes + sizeof(float));
+}
+
+
+// Get integer.
+int Message::getInt()
+{
+    int value = 0;
+
+    if (position + (int)sizeof(int) > (int)data.size()) return 0;
+    memcpy(&value, &data[position], sizeof(int));
+    position += sizeof(int);
+    return value;
+}
+
+
+// Get float.
+float Message::getFloat()
+{
+    float value = 0.0f;
+
+    if (position + (int)sizeof(float) > (int)data.size()) return 0.0f;
+    memcpy(&value, &data[position], sizeof(float));
+    position += sizeof(float);
+    return value;
+}
+
+
+#ifdef UNIX
+// Constructor.
+SocketTransport::SocketTransport(int rank, int size)
+{
+    this->rank = rank;
+    this->size = size;
+    sockets.resize(size + 1, -1);
+}
+
+
+// Destructor.
+SocketTransport::~SocketTransport()
+{
+    for (int i = 0; i < (int)sockets.size(); i++)
+    {
+        if (sockets[i] != -1) close(sockets[i]);
+    }
+}
+
+
+// Fork workers.
+SocketTransport *SocketTransport::start(int size)
+{
+    int i,j;
+    pid_t pid;
+    SocketTransport *transport;
+
+    // Socket pairs: coordinator[i] connects worker i to the coordinator,
+    // neighbor[i] connects worker i to worker i + 1.
+    std::vector<int> coordinator(2 * size, -1), neighbor(2 * size, -1);
+    for (i = 0; i < size; i++)
+    {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, &coordinator[2 * i]) == -1 ||
+            (i < size - 1 && socketpair(AF_UNIX, SOCK_STREAM, 0, &neighbor[2 * i]) == -1))
+        {
+            for (j = 0; j < 2 * size; j++)
+            {
+                if (coordinator[j] != -1) close(coordinator[j]);
+                if (neighbor[j] != -1) close(neighbor[j]);
+            }
+            return NULL;
+        }
+    }
+
+    // Buffered output must not be written by every process.
+    fflush(stdout);
+    fflush(stderr);
+
+    transport = new SocketTransport(size, size);
+    assert(transport != NULL);
+    for (i = 0; i < size; i++)
+    {
+        if ((pid = fork()) == -1)
+        {
+            // Workers already started exit when the coordinator closes.
+            delete transport;
+            return NULL;
+        }
+        if (pid == 0)
+        {
+            // Worker: keep own ends, close the rest.
+            delete transport;
+            transport = new SocketTransport(i, size);
+            assert(transport != NULL);
+            for (j = 0; j < size; j++)
+            {
+                if (j == i)
+                {
+                    transport->sockets[size] = coordinator[2 * j + 1];
+                    close(coordinator[2 * j]);
+                }
+                else
+                {
+                    close(coordinator[2 * j]);
+                    close(coordinator[2 * j + 1]);
+                }
+                if (j == size - 1) continue;
+                if (j == i)
+                {
+                    transport->sockets[i + 1] = neighbor[2 * j];
+                    close(neighbor[2 * j + 1]);
+                }
+                else if (j == i - 1)
+                {
+                    transport->sockets[i - 1] = neighbor[2 * j + 1];
+                    close(neighbor[2 * j]);
+                }
+                else
+                {
+                    close(neighbor[2 * j]);
+                    close(neighbor[2 * j + 1]);
+                }
+            }
+            return transport;
+        }
+        transport->workers.push_back(pid);
+    }
+
+    // Coordinator.
+    for (i = 0; i < size; i++)
+    {
+        transport->sockets[i] = coordinator[2 * i];
+        close(coordinator[2 * i + 1]);
+        if (i < size - 1)
+        {
+            close(neighbor[2 * i]);
+            close(neighbor[2 * i + 1]);
+        }
+    }
+    return transport;
+}
+
+
+// Write all bytes.
+static bool writeAll(int fd, unsigned char *bytes, int length)
+{
+    int n;
+
+    while (length > 0)
+    {
+        if ((n = (int)write(fd, bytes, length)) == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+
+// Read all bytes.
+static bool readAll(int fd, unsigned char *bytes, int length)
+{
+    int n;
+
+    while (length > 0)
+    {
+        if ((n = (int)read(fd, bytes, length)) == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) return false;
+        bytes += n;
+        length -= n;
+    }
+    return true;
+}
+
+
+// Send message: length then bytes.
+bool SocketTransport::send(int rank, Message &message)
+{
+    int length = (int)message.data.size();
+
+    if (sockets[rank] == -1) return false;
+    if (!writeAll(sockets[rank], (unsigned char *)&length, sizeof(int))) return false;
+    if (length == 0) return true;
+    return writeAll(sockets[rank], &message.data[0], length);
+}
+
+
+// Receive message.
+bool SocketTransport::receive(int rank, Message &message)
+{
+    int length;
+
+    message.clear();
+    if (sockets[rank] == -1) return false;
+    if (!readAll(sockets[rank], (unsigned char *)&length, sizeof(int))) return false;
+    if (length < 0) return false;
+    message.data.resize(length);
+    if (length == 0) return true;
+    return readAll(sockets[rank], &message.data[0], length);
+}
+
+
+// Exchange messages: interleave sending and receiving so that
+// both sides can exchange large messages at once.
+bool SocketTransport::exchange(int rank, Message &output, Message &input)
+{
+    int fd,n,outLength,inLength,sent,received;
+    struct pollfd poller;
+    std::vector<unsigned char> out;
+
+    input.clear();
+    if ((fd = sockets[rank]) == -1) return false;
+    outLength = (int)output.data.size();
+    out.resize(sizeof(int) + outLength);
+    memcpy(&out[0], &outLength, sizeof(int));
+    if (outLength > 0) memcpy(&out[sizeof(int)], &output.data[0], outLength);
+    sent = received = 0;
+    inLength = -1;
+    while (sent < (int)out.size() || inLength == -1 || received < inLength)
+    {
+        poller.fd = fd;
+        poller.events = 0;
+        if (sent < (int)out.size()) poller.events |= POLLOUT;
+        if (inLength == -1 || received < inLength) poller.events |= POLLIN;
+        poller.revents = 0;
+        if (poll(&poller, 1, -1) == -1)
+        {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (poller.revents & POLLOUT)
+        {
+            n = (int)::send(fd, &out[sent], out.size() - sent,
+                MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (n == -1 && errno != EAGAIN && errno != EINTR) return false;
+            if (n > 0) sent += n;
+        }
+        if (poller.revents & POLLIN)
+        {
+            if (inLength == -1)
+            {
+                // Length is read whole: it is written first and is small.
+                if (!readAll(fd, (unsigned char *)&inLength, sizeof(int)) ||
+                    inLength < 0)
+                {
+                    return false;
+                }
+                input.data.resize(inLength);
+                continue;
+            }
+            n = (int)recv(fd, &input.data[received], inLength - received,
+                MSG_DONTWAIT);
+            if (n == 0) return false;
+            if (n == -1 && errno != EAGAIN && errno != EINTR) return false;
+            if (n > 0) received += n;
+        }
+        else if (poller.revents & (POLLERR | POLLHUP))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Wait for workers.
+bool SocketTransport::wait()
+{
+    int status;
+    bool ok = true;
+
+    for (int i = 0; i < (int)workers.size(); i++)
+    {
+        if (waitpid(workers[i], &status, 0) == -1 ||
+            !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ok = false;
+        }
+    }
+    workers.clear();
+    return ok;
+}
+#endif
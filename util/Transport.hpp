@@ -0,0 +1,123 @@
+/*
+ * This software is provided under the terms of the GNU General
+ * Public License as published by the Free Software Foundation.
+ *
+ * Copyright (c) 2004 Tom Portegys, All Rights Reserved.
+ * Permission to use, copy, modify, and distribute this software
+ * and its documentation for NON-COMMERCIAL purposes and without
+ * fee is hereby granted provided that this copyright notice
+ * appears in all copies.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESSED OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.
+ */
+
+/*
+ * Message transport between the processes of a decomposed run.
+ * Workers have ranks 0 to size - 1, and the coordinator that started
+ * them has rank size. The socket transport forks the workers on the
+ * local machine and connects them with Unix socket pairs: each worker
+ * to its neighbors and to the coordinator.
+ */
+
+#ifndef __TRANSPORT__
+#define __TRANSPORT__
+
+#include <vector>
+#ifdef UNIX
+#include <sys/types.h>
+#endif
+
+// Message: a byte buffer with typed put and get.
+class Message
+{
+    public:
+
+        std::vector<unsigned char> data;
+        int position;                             // get position
+
+        // Constructor.
+        Message() { position = 0; }
+
+        // Clear.
+        void clear() { data.clear(); position = 0; }
+
+        // Put values.
+        void putInt(int value);
+        void putFloat(float value);
+
+        // Get values.
+        int getInt();
+        float getFloat();
+
+        // All values read?
+        bool atEnd() { return position >= (int)data.size(); }
+};
+
+// Transport interface.
+class Transport
+{
+    public:
+
+        // Destructor.
+        virtual ~Transport() {}
+
+        // Rank of this process and number of workers.
+        int getRank() { return rank; }
+        int getSize() { return size; }
+        bool isCoordinator() { return rank == size; }
+
+        // Send message to rank.
+        virtual bool send(int rank, Message &message) = 0;
+
+        // Receive message from rank.
+        virtual bool receive(int rank, Message &message) = 0;
+
+        // Send message to and receive message from rank.
+        // Both ranks may exchange at once without deadlock.
+        virtual bool exchange(int rank, Message &output, Message &input) = 0;
+
+    protected:
+
+        int rank;
+        int size;
+};
+
+#ifdef UNIX
+// Unix socket transport for forked workers.
+class SocketTransport : public Transport
+{
+    public:
+
+        // Fork size workers. Returns the transport of the calling
+        // process: a worker's in each child, the coordinator's in
+        // the parent. Returns NULL on failure.
+        static SocketTransport *start(int size);
+
+        // Destructor: close sockets.
+        ~SocketTransport();
+
+        // Transport.
+        bool send(int rank, Message &message);
+        bool receive(int rank, Message &message);
+        bool exchange(int rank, Message &output, Message &input);
+
+        // Wait for workers to exit (coordinator): returns false
+        // if any failed.
+        bool wait();
+
+    private:
+
+        // Constructor.
+        SocketTransport(int rank, int size);
+
+        // Socket to each rank (-1 = not connected).
+        std::vector<int> sockets;
+
+        // Worker processes (coordinator).
+        std::vector<pid_t> workers;
+};
+#endif
+#endif